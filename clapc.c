@@ -1,205 +1,4921 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include "clapc.h"
+#include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <locale.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * How deeply response files may include other response files. This also stops
+ * response files that include themselves.
+ */
+#define CLAPC_MAX_RESPONSE_FILE_DEPTH 16
+
+/**
+ * Print an error message and exit the program.
+ * @param status The exit status.
+ * @param fmt The format string.
+ */
+__attribute__((format(printf, 2, 3), noreturn)) static void die(
+  int status, const char* fmt, ...)
+{
+  va_list args;
+  va_start(args);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  exit(status);
+}
+
+// Statistics ==================================================================
+
+#ifdef CLAPC_STATS
+
+/**
+ * The statistics of the calling thread. They are per thread so that counting
+ * needs neither atomics nor locks.
+ */
+static thread_local s_clapc_stats stats;
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+#define STATS_ADD(field, n) (stats.field += (n))
+#define STATS_TIMER_START(timer) uint64_t timer = now_ns()
+#define STATS_TIMER_STOP(timer, field) (stats.field += now_ns() - (timer))
+
+bool clapc_stats_get(s_clapc_stats* out)
+{
+  *out = stats;
+  return true;
+}
+
+void clapc_stats_reset(void)
+{
+  stats = (s_clapc_stats) { 0 };
+}
+
+#else
+
+// Without CLAPC_STATS, statistics cost nothing
+#define STATS_ADD(field, n) ((void)0)
+#define STATS_TIMER_START(timer) ((void)0)
+#define STATS_TIMER_STOP(timer, field) ((void)0)
+
+bool clapc_stats_get(s_clapc_stats* out)
+{
+  *out = (s_clapc_stats) { 0 };
+  return false;
+}
+
+void clapc_stats_reset(void) { }
+
+#endif
+
+// Memory ======================================================================
+
+static void* mem_alloc(const s_clapc_allocator* allocator, size_t size)
+{
+  return allocator ? allocator->alloc(allocator->context, size) : malloc(size);
+}
+
+static void* mem_realloc(const s_clapc_allocator* allocator, void* ptr,
+  size_t old_size, size_t size)
+{
+  return allocator
+    ? allocator->realloc(allocator->context, ptr, old_size, size)
+    : realloc(ptr, size);
+}
+
+static void mem_free(const s_clapc_allocator* allocator, void* ptr, size_t size)
+{
+  if (allocator == NULL) {
+    free(ptr);
+  } else if (allocator->free && ptr) {
+    allocator->free(allocator->context, ptr, size);
+  }
+}
+
+/**
+ * Whether memory from `allocator` is only released all at once, so that it
+ * may be gone without having been freed.
+ */
+static bool is_arena(const s_clapc_allocator* allocator)
+{
+  return allocator && allocator->free == NULL;
+}
+
+struct clapc_arena_block {
+  s_clapc_arena_block* next;
+  size_t size;
+  // Makes the memory of the block aligned for any type
+  max_align_t data[];
+};
+
+/**
+ * Round `size` up so that whatever is allocated after it stays aligned.
+ *
+ * @return false if the size is too large to round.
+ */
+static bool arena_round(size_t* size)
+{
+  size_t align = alignof(max_align_t);
+  if (*size > SIZE_MAX - align) {
+    return false;
+  }
+  *size = (*size + align - 1) & ~(align - 1);
+  return true;
+}
+
+/**
+ * Move on to the next block with room for `size` bytes, reusing the blocks
+ * kept by the last reset if they are large enough.
+ */
+static bool arena_next_block(s_clapc_arena* arena, size_t size)
+{
+  s_clapc_arena_block* next
+    = arena->current ? arena->current->next : arena->blocks;
+
+  if (next == NULL || next->size < size) {
+    size_t block_size = size > arena->block_size ? size : arena->block_size;
+    if (block_size > SIZE_MAX - sizeof(s_clapc_arena_block)) {
+      return false;
+    }
+    s_clapc_arena_block* block
+      = malloc(sizeof(s_clapc_arena_block) + block_size);
+    STATS_ADD(allocations, 1);
+    if (block == NULL) {
+      return false;
+    }
+    *block = (s_clapc_arena_block) { .next = next, .size = block_size };
+    if (arena->current) {
+      arena->current->next = block;
+    } else {
+      arena->blocks = block;
+    }
+    next = block;
+  }
+
+  arena->current = next;
+  arena->pos = (char*)next->data;
+  arena->end = arena->pos + next->size;
+  return true;
+}
+
+static void* arena_alloc(void* context, size_t size)
+{
+  s_clapc_arena* arena = context;
+  if (!arena_round(&size)) {
+    return NULL;
+  }
+  size_t room = arena->pos ? (size_t)(arena->end - arena->pos) : 0;
+  if (size > room && !arena_next_block(arena, size)) {
+    return NULL;
+  }
+  void* ptr = arena->pos;
+  arena->pos += size;
+  return ptr;
+}
+
+static void* arena_realloc(
+  void* context, void* ptr, size_t old_size, size_t size)
+{
+  s_clapc_arena* arena = context;
+  size_t old_rounded = old_size;
+  size_t rounded = size;
+  if (!arena_round(&old_rounded) || !arena_round(&rounded)) {
+    return NULL;
+  }
+
+  // The last allocation can be resized in place, as long as it fits
+  if (ptr && (char*)ptr + old_rounded == arena->pos
+    && rounded <= old_rounded + (size_t)(arena->end - arena->pos)) {
+    arena->pos = (char*)ptr + rounded;
+    return ptr;
+  }
+  if (size <= old_size) {
+    return ptr;
+  }
+
+  void* moved = arena_alloc(arena, size);
+  if (moved && ptr) {
+    memcpy(moved, ptr, old_size);
+  }
+  return moved;
+}
+
+void clapc_arena_init(s_clapc_arena* arena, size_t block_size)
+{
+  *arena = (s_clapc_arena) {
+    .allocator = {
+      .alloc = arena_alloc,
+      .realloc = arena_realloc,
+      .context = arena,
+    },
+    .block_size = block_size ? block_size : CLAPC_ARENA_BLOCK_SIZE,
+  };
+}
+
+void clapc_arena_reset(s_clapc_arena* arena)
+{
+  // The next allocation starts over from the first block
+  arena->current = NULL;
+  arena->pos = NULL;
+  arena->end = NULL;
+}
+
+void clapc_arena_free(s_clapc_arena* arena)
+{
+  s_clapc_arena_block* block = arena->blocks;
+  while (block) {
+    s_clapc_arena_block* next = block->next;
+    free(block);
+    block = next;
+  }
+  arena->blocks = NULL;
+  clapc_arena_reset(arena);
+}
+
+// Compiled specs ==============================================================
+
+typedef struct {
+  /**
+   * The hash of the long name stored in this slot.
+   */
+  uint32_t hash;
+  /**
+   * One plus the index of the argument in the spec's `args` array. Zero means
+   * the slot is empty.
+   */
+  uint32_t index;
+} s_long_slot;
+
+/**
+ * A slot of the hash table of the choices of enum arguments.
+ */
+typedef struct {
+  /**
+   * The hash of the choice and of the index of its argument.
+   */
+  uint32_t hash;
+  /**
+   * One plus the index of the argument. Zero means the slot is empty.
+   */
+  uint32_t index;
+  /**
+   * The index of the choice in the `choices` of the argument.
+   */
+  uint32_t choice;
+} s_choice_slot;
+
+struct clapc_spec {
+  s_clap_arg** args;
+  size_t count;
+  /**
+   * Direct lookup table for short names, indexed by the unsigned value of the
+   * short name. Like in `long_index`, entries are one plus the index of the
+   * argument, and zero means there is no such argument.
+   */
+  uint32_t short_index[256];
+  /**
+   * Open-addressing hash table for long names. The capacity is always a power
+   * of two, so `long_mask` is `capacity - 1`.
+   */
+  size_t long_mask;
+  /**
+   * The constraints between arguments, as bitsets of `words` words each, or
+   * NULL if there are none: the required arguments, then what each argument
+   * conflicts with, then what each argument depends on, then the members of
+   * each group.
+   */
+  uint64_t* constraints;
+  size_t words;
+  size_t group_count;
+  /**
+   * The index of near misses of long names, see {@link suggest_long}, or NULL
+   * if no argument has a long name.
+   */
+  struct suggestion_index* suggestions;
+  /**
+   * Open-addressing hash table of the choices of every enum argument, or NULL
+   * if there are none.
+   */
+  s_choice_slot* choices;
+  size_t choice_mask;
+  s_long_slot long_index[];
+};
+
+/**
+ * The number of 64-bit words of the presence bitset of `count` arguments.
+ */
+static size_t present_words(size_t count)
+{
+  return (count + 63) / 64;
+}
+
+static void bit_set(uint64_t* bits, size_t index)
+{
+  bits[index / 64] |= UINT64_C(1) << (index % 64);
+}
+
+static bool bit_get(const uint64_t* bits, size_t index)
+{
+  return (bits[index / 64] >> (index % 64)) & 1;
+}
+
+/**
+ * How an argument is named in error messages: "--name", or "-c" if it has no
+ * long name. Use with OPTION_FORMAT.
+ */
+#define OPTION_FORMAT "%s%.*s"
+#define OPTION_ARGS(arg)                                                       \
+  (arg)->name ? "--" : "-", (arg)->name ? (int)strlen((arg)->name) : 1,        \
+    (arg)->name ? (arg)->name : &(arg)->short_name
+
+#define FNV_OFFSET_BASIS 2166136261u
+
+/**
+ * Continue a 32-bit FNV-1a hash with the first `len` bytes of `str`.
+ */
+static uint32_t hash_update(uint32_t hash, const char* str, size_t len)
+{
+  for (size_t i = 0; i < len; i++) {
+    hash ^= (unsigned char)str[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * 32-bit FNV-1a hash of the first `len` bytes of `str`.
+ */
+static uint32_t hash_name(const char* str, size_t len)
+{
+  return hash_update(FNV_OFFSET_BASIS, str, len);
+}
+
+static bool name_equals(const char* name, const char* str, size_t len)
+{
+  return strncmp(name, str, len) == 0 && name[len] == '\0';
+}
+
+static s_clap_arg* spec_find_long(
+  const s_clapc_spec* spec, const char* name, size_t len, size_t* index_ptr)
+{
+  uint32_t hash = hash_name(name, len);
+
+  for (size_t i = hash & spec->long_mask;; i = (i + 1) & spec->long_mask) {
+    STATS_ADD(lookup_probes, 1);
+    const s_long_slot* slot = &spec->long_index[i];
+    if (slot->index == 0) {
+      return NULL;
+    }
+    s_clap_arg* arg = spec->args[slot->index - 1];
+    if (slot->hash == hash && name_equals(arg->name, name, len)) {
+      *index_ptr = slot->index - 1;
+      return arg;
+    }
+  }
+}
+
+/**
+ * Find the argument whose long name is the first `len` bytes of `name`, and
+ * store its index in `args` in `index_ptr`.
+ */
+static s_clap_arg* find_long(const s_clapc_spec* spec, s_clap_arg* args[],
+  const char* name, size_t len, size_t* index_ptr)
+{
+  if (spec) {
+    return spec_find_long(spec, name, len, index_ptr);
+  }
+  for (size_t i = 0; args[i] != NULL; i++) {
+    STATS_ADD(lookup_probes, 1);
+    if (args[i]->name && name_equals(args[i]->name, name, len)) {
+      *index_ptr = i;
+      return args[i];
+    }
+  }
+  return NULL;
+}
+
+static s_clap_arg* find_short(const s_clapc_spec* spec, s_clap_arg* args[],
+  char short_name, size_t* index_ptr)
+{
+  if (short_name == 0) {
+    return NULL;
+  }
+  if (spec) {
+    STATS_ADD(lookup_probes, 1);
+    uint32_t entry = spec->short_index[(unsigned char)short_name];
+    if (entry == 0) {
+      return NULL;
+    }
+    *index_ptr = entry - 1;
+    return spec->args[entry - 1];
+  }
+  for (size_t i = 0; args[i] != NULL; i++) {
+    STATS_ADD(lookup_probes, 1);
+    if (args[i]->short_name == short_name) {
+      *index_ptr = i;
+      return args[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * The capacity of a hash table for `count` names. This keeps the load factor at
+ * or below 50%.
+ */
+static size_t index_capacity(size_t count)
+{
+  size_t capacity = 8;
+  while (capacity < count * 2) {
+    capacity *= 2;
+  }
+  return capacity;
+}
+
+static void index_insert(
+  s_long_slot* slots, size_t mask, uint32_t hash, size_t index)
+{
+  size_t slot = hash & mask;
+  while (slots[slot].index != 0) {
+    slot = (slot + 1) & mask;
+  }
+  slots[slot] = (s_long_slot) {
+    .hash = hash,
+    .index = (uint32_t)index + 1,
+  };
+}
+
+static bool has_constraints(const s_clap_arg* arg)
+{
+  return arg->required || arg->conflicts_with || arg->depends_on || arg->group;
+}
+
+/**
+ * The index of the first argument of `spec` in the group of argument `index`.
+ */
+static size_t first_in_group(const s_clapc_spec* spec, size_t index)
+{
+  const char* group = spec->args[index]->group;
+  size_t i = 0;
+  while (spec->args[i]->group == NULL
+    || strcmp(spec->args[i]->group, group) != 0) {
+    i++;
+  }
+  return i;
+}
+
+/**
+ * Set the bits of the arguments named in `names` (a NULL-terminated list of
+ * long names, or NULL) in `bits`.
+ */
+static bool names_to_bits(const s_clapc_spec* spec, const s_clap_arg* arg,
+  const char* const* names, uint64_t* bits, char** error)
+{
+  for (; names && *names; names++) {
+    size_t index;
+    if (spec_find_long(spec, *names, strlen(*names), &index) == NULL) {
+      asprintf(error,
+        "Unknown argument '--%s' in constraints of '" OPTION_FORMAT "'\n",
+        *names, OPTION_ARGS(arg));
+      return false;
+    }
+    bit_set(bits, index);
+  }
+  return true;
+}
+
+/**
+ * Compile the constraints of the arguments of `spec` into bitsets, so that
+ * checking them after parsing only takes a few operations per word.
+ */
+static bool compile_constraints(s_clapc_spec* spec, char** error)
+{
+  size_t count = spec->count;
+  size_t groups = 0;
+  bool any = false;
+
+  for (size_t i = 0; i < count; i++) {
+    s_clap_arg* arg = spec->args[i];
+    any |= has_constraints(arg);
+
+    // Only the first argument of each group starts one
+    if (arg->group != NULL) {
+      groups += first_in_group(spec, i) == i;
+    }
+  }
+
+  if (!any) {
+    return true;
+  }
+
+  size_t words = present_words(count);
+  spec->constraints
+    = calloc((1 + 2 * count + groups) * words, sizeof(uint64_t));
+  STATS_ADD(allocations, 1);
+  if (spec->constraints == NULL) {
+    asprintf(error, "Out of memory\n");
+    return false;
+  }
+  spec->words = words;
+
+  uint64_t* required = spec->constraints;
+  uint64_t* conflicts = required + words;
+  uint64_t* depends = conflicts + count * words;
+  uint64_t* group_bits = depends + count * words;
+
+  for (size_t i = 0; i < count; i++) {
+    s_clap_arg* arg = spec->args[i];
+
+    if (arg->required) {
+      bit_set(required, i);
+    }
+    if (!names_to_bits(spec, arg, arg->conflicts_with,
+          conflicts + i * words, error)
+      || !names_to_bits(
+        spec, arg, arg->depends_on, depends + i * words, error)) {
+      return false;
+    }
+
+    if (arg->group == NULL) {
+      continue;
+    }
+    size_t first = first_in_group(spec, i);
+    size_t group = 0;
+    if (first == i) {
+      group = spec->group_count++;
+    } else {
+      while (!bit_get(group_bits + group * words, first)) {
+        group++;
+      }
+    }
+    bit_set(group_bits + group * words, i);
+  }
+
+  return true;
+}
+
+static uint32_t choice_hash(const char* choice, size_t len, size_t index)
+{
+  uint32_t index32 = (uint32_t)index;
+  return hash_update(hash_name(choice, len), (const char*)&index32, 4);
+}
+
+/**
+ * Find `value` among the choices of the enum argument `arg` (at `index` in
+ * `spec`), using the table of choices of `spec` if there is one.
+ *
+ * @return The index of the choice, or -1.
+ */
+static int find_choice(const s_clapc_spec* spec, size_t index,
+  const s_clap_arg* arg, const char* value, size_t len)
+{
+  if (spec == NULL || spec->choices == NULL) {
+    for (int i = 0; arg->choices && arg->choices[i]; i++) {
+      if (name_equals(arg->choices[i], value, len)) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  uint32_t hash = choice_hash(value, len, index);
+  for (size_t i = hash & spec->choice_mask; spec->choices[i].index != 0;
+    i = (i + 1) & spec->choice_mask) {
+    STATS_ADD(lookup_probes, 1);
+    const s_choice_slot* slot = &spec->choices[i];
+    if (slot->hash == hash && slot->index == index + 1
+      && name_equals(arg->choices[slot->choice], value, len)) {
+      return (int)slot->choice;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Compile the choices of every enum argument of `spec` into one hash table, so
+ * that matching a value takes a single lookup however many choices there are.
+ */
+static bool compile_choices(s_clapc_spec* spec, char** error)
+{
+  size_t total = 0;
+
+  for (size_t i = 0; i < spec->count; i++) {
+    s_clap_arg* arg = spec->args[i];
+    if (arg->type != CLAP_ARG_TYPE_ENUM) {
+      continue;
+    }
+    if (arg->choices == NULL || arg->choices[0] == NULL) {
+      asprintf(error, "Argument '" OPTION_FORMAT "' has no choices\n",
+        OPTION_ARGS(arg));
+      return false;
+    }
+    for (size_t j = 0; arg->choices[j]; j++) {
+      total++;
+    }
+  }
+
+  if (total == 0) {
+    return true;
+  }
+
+  size_t capacity = index_capacity(total);
+  spec->choices = calloc(capacity, sizeof(s_choice_slot));
+  STATS_ADD(allocations, 1);
+  if (spec->choices == NULL) {
+    asprintf(error, "Out of memory\n");
+    return false;
+  }
+  spec->choice_mask = capacity - 1;
+
+  for (size_t i = 0; i < spec->count; i++) {
+    s_clap_arg* arg = spec->args[i];
+    if (arg->type != CLAP_ARG_TYPE_ENUM) {
+      continue;
+    }
+
+    for (size_t j = 0; arg->choices[j]; j++) {
+      size_t len = strlen(arg->choices[j]);
+      if (find_choice(spec, i, arg, arg->choices[j], len) >= 0) {
+        asprintf(error,
+          "Duplicate choice '%s' for argument '" OPTION_FORMAT "'\n",
+          arg->choices[j], OPTION_ARGS(arg));
+        return false;
+      }
+
+      uint32_t hash = choice_hash(arg->choices[j], len, i);
+      size_t slot = hash & spec->choice_mask;
+      while (spec->choices[slot].index != 0) {
+        slot = (slot + 1) & spec->choice_mask;
+      }
+      spec->choices[slot] = (s_choice_slot) {
+        .hash = hash,
+        .index = (uint32_t)i + 1,
+        .choice = (uint32_t)j,
+      };
+    }
+  }
+
+  return true;
+}
+
+static s_clapc_spec* compile_spec(s_clap_arg* args[], char** error);
+static bool compile_suggestions(s_clapc_spec* spec, char** error);
+
+s_clapc_spec* clapc_spec_compile(s_clap_arg* args[], char** error)
+{
+  STATS_TIMER_START(timer);
+  s_clapc_spec* spec = compile_spec(args, error);
+  STATS_TIMER_STOP(timer, validate_ns);
+  return spec;
+}
+
+static s_clapc_spec* compile_spec(s_clap_arg* args[], char** error)
+{
+  *error = NULL;
+
+  size_t count = 0;
+  while (args[count] != NULL) {
+    count++;
+  }
+
+  if (count >= UINT32_MAX) {
+    asprintf(error, "Too many arguments\n");
+    return NULL;
+  }
+
+  size_t capacity = index_capacity(count);
+  s_clapc_spec* spec
+    = calloc(1, sizeof(*spec) + capacity * sizeof(spec->long_index[0]));
+  STATS_ADD(allocations, 1);
+  if (spec == NULL) {
+    asprintf(error, "Out of memory\n");
+    return NULL;
+  }
+
+  spec->args = args;
+  spec->count = count;
+  spec->long_mask = capacity - 1;
+
+  for (size_t i = 0; i < count; i++) {
+    s_clap_arg* arg = args[i];
+
+    if (arg->short_name != 0) {
+      uint32_t* entry = &spec->short_index[(unsigned char)arg->short_name];
+      if (*entry != 0) {
+        asprintf(error, "Duplicate argument '-%c'\n", arg->short_name);
+        clapc_spec_free(spec);
+        return NULL;
+      }
+      *entry = (uint32_t)i + 1;
+    }
+
+    // Custom values are only stored in their destination, so without one a
+    // given argument couldn't be told apart from a missing one
+    if (arg->type == CLAP_ARG_TYPE_CUSTOM
+      && (arg->parse == NULL || arg->dest == NULL)) {
+      asprintf(error, "Argument '" OPTION_FORMAT "' has no %s\n",
+        OPTION_ARGS(arg), arg->parse ? "destination" : "parse function");
+      clapc_spec_free(spec);
+      return NULL;
+    }
+
+    if (arg->name == NULL) {
+      continue;
+    }
+
+    size_t len = strlen(arg->name);
+    size_t index;
+    if (spec_find_long(spec, arg->name, len, &index) != NULL) {
+      asprintf(error, "Duplicate argument '--%s'\n", arg->name);
+      clapc_spec_free(spec);
+      return NULL;
+    }
+
+    index_insert(
+      spec->long_index, spec->long_mask, hash_name(arg->name, len), i);
+  }
+
+  if (!compile_constraints(spec, error) || !compile_choices(spec, error)
+    || !compile_suggestions(spec, error)) {
+    clapc_spec_free(spec);
+    return NULL;
+  }
+
+  return spec;
+}
+
+void clapc_spec_free(s_clapc_spec* spec)
+{
+  if (spec) {
+    free(spec->constraints);
+    free(spec->suggestions);
+    free(spec->choices);
+  }
+  free(spec);
+}
+
+// Suggestions =================================================================
+
+/**
+ * Whether `a` and `b` are exactly one edit apart: one character inserted,
+ * removed or replaced, or two neighboring characters swapped. This is an edit
+ * distance check bounded at one, so it stops at the first difference that a
+ * single edit can't explain.
+ */
+static bool one_edit_apart(
+  const char* a, size_t a_len, const char* b, size_t b_len)
+{
+  if (a_len < b_len) {
+    return one_edit_apart(b, b_len, a, a_len);
+  }
+  if (a_len - b_len > 1) {
+    return false;
+  }
+
+  size_t i = 0;
+  while (i < b_len && a[i] == b[i]) {
+    i++;
+  }
+
+  if (a_len != b_len) {
+    return memcmp(a + i + 1, b + i, b_len - i) == 0;
+  }
+  if (i == a_len) {
+    return false;
+  }
+  if (memcmp(a + i + 1, b + i + 1, a_len - i - 1) == 0) {
+    return true;
+  }
+  return i + 1 < a_len && a[i] == b[i + 1] && a[i + 1] == b[i]
+    && memcmp(a + i + 2, b + i + 2, a_len - i - 2) == 0;
+}
+
+/**
+ * The base of the polynomials of {@link s_deletions}, the FNV prime.
+ */
+#define DELETION_BASE 16777619u
+
+/**
+ * Hashes a string and every way of removing one character from it, each in
+ * constant time. The hash of a string `t` is `B p(t)`, where `p(t)` is the
+ * polynomial `t[0] + t[1] B + t[2] B^2 + ...`. Removing character `k` of `s`
+ * moves every character after it down one power, so the hash of what is left
+ * is `B p(s[0..k)) + p(s) - p(s[0..k])`: only prefixes are needed.
+ */
+typedef struct {
+  const char* str;
+  size_t len;
+  size_t skip;
+  uint32_t all;
+  uint32_t prefix;
+  uint32_t power;
+} s_deletions;
+
+static void deletions_init(s_deletions* deletions, const char* str, size_t len)
+{
+  uint32_t all = 0;
+  for (size_t i = len; i > 0; i--) {
+    all = all * DELETION_BASE + (unsigned char)str[i - 1];
+  }
+  *deletions = (s_deletions) {
+    .str = str,
+    .len = len,
+    .all = all,
+    .power = 1,
+  };
+}
+
+/**
+ * Get the hash of the string without its next character, or of all of it once
+ * every character has been removed once.
+ *
+ * @return false once there are no more hashes
+ */
+static bool deletions_next(s_deletions* deletions, uint32_t* hash_ptr)
+{
+  if (deletions->skip > deletions->len) {
+    return false;
+  }
+
+  uint32_t hash = deletions->all * DELETION_BASE;
+  if (deletions->skip < deletions->len) {
+    uint32_t next = deletions->prefix
+      + (unsigned char)deletions->str[deletions->skip] * deletions->power;
+    hash = deletions->prefix * DELETION_BASE + deletions->all - next;
+    deletions->prefix = next;
+    deletions->power *= DELETION_BASE;
+  }
+  deletions->skip++;
+
+  // Mix the high bits into the low ones, which pick the slot
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bu;
+  hash ^= hash >> 13;
+  *hash_ptr = hash;
+  return true;
+}
+
+/**
+ * A hash table of every long name of a spec, and of every way to remove one
+ * character from each of them. Two names are one edit apart only if removing
+ * (at most) one character from each makes them equal, so the names one edit
+ * away from a string are all found by looking up the string and each of its
+ * own deletions: a few dozen probes, no matter how many names there are.
+ */
+typedef struct suggestion_index {
+  size_t mask;
+  size_t max_len;
+  s_long_slot slots[];
+} s_suggestion_index;
+
+/**
+ * Build the suggestion index of `spec`, unless no argument has a long name.
+ */
+static bool compile_suggestions(s_clapc_spec* spec, char** error)
+{
+  size_t entries = 0;
+  size_t max_len = 0;
+  for (size_t i = 0; i < spec->count; i++) {
+    if (spec->args[i]->name) {
+      size_t len = strlen(spec->args[i]->name);
+      entries += len + 1;
+      max_len = len > max_len ? len : max_len;
+    }
+  }
+  if (entries == 0) {
+    return true;
+  }
+
+  size_t capacity = index_capacity(entries);
+  s_suggestion_index* index
+    = calloc(1, sizeof(*index) + capacity * sizeof(index->slots[0]));
+  STATS_ADD(allocations, 1);
+  if (index == NULL) {
+    asprintf(error, "Out of memory\n");
+    return false;
+  }
+  index->mask = capacity - 1;
+  index->max_len = max_len;
+
+  for (size_t i = 0; i < spec->count; i++) {
+    const char* name = spec->args[i]->name;
+    if (name == NULL) {
+      continue;
+    }
+    s_deletions deletions;
+    deletions_init(&deletions, name, strlen(name));
+    uint32_t hash;
+    while (deletions_next(&deletions, &hash)) {
+      index_insert(index->slots, index->mask, hash, i);
+    }
+  }
+
+  spec->suggestions = index;
+  return true;
+}
+
+/**
+ * Find a long name that is one edit away from `name`, to suggest when `name`
+ * isn't an argument. If several are, the first one in `args` wins.
+ */
+static s_clap_arg* suggest_long(
+  const s_clapc_spec* spec, s_clap_arg* args[], const char* name, size_t len)
+{
+  size_t best = SIZE_MAX;
+
+  if (spec == NULL) {
+    for (size_t i = 0; args[i] != NULL && best == SIZE_MAX; i++) {
+      const char* other = args[i]->name;
+      if (other && one_edit_apart(name, len, other, strlen(other))) {
+        best = i;
+      }
+    }
+    return best == SIZE_MAX ? NULL : args[best];
+  }
+
+  const s_suggestion_index* index = spec->suggestions;
+  if (index == NULL || len > index->max_len + 1) {
+    return NULL;
+  }
+
+  s_deletions deletions;
+  deletions_init(&deletions, name, len);
+  uint32_t hash;
+  while (deletions_next(&deletions, &hash)) {
+    for (size_t i = hash & index->mask; index->slots[i].index != 0;
+      i = (i + 1) & index->mask) {
+      size_t candidate = index->slots[i].index - 1;
+      if (index->slots[i].hash != hash || candidate >= best) {
+        continue;
+      }
+      const char* other = spec->args[candidate]->name;
+      if (one_edit_apart(name, len, other, strlen(other))) {
+        best = candidate;
+      }
+    }
+  }
+
+  return best == SIZE_MAX ? NULL : spec->args[best];
+}
+
+// Numbers =====================================================================
+
+/**
+ * Powers of ten that are exactly representable as doubles.
+ */
+static const double exact_powers_of_ten[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5,
+  1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18,
+  1e19, 1e20, 1e21, 1e22 };
+
+/**
+ * Powers of ten that are exactly representable as floats.
+ */
+static const float exact_powers_of_ten_f[]
+  = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+static bool is_digit(char c)
+{
+  return (unsigned char)(c - '0') < 10;
+}
+
+static bool matches_ignore_case(
+  const char* str, size_t len, const char* lowercase)
+{
+  size_t i = 0;
+  for (; i < len && lowercase[i]; i++) {
+    if ((str[i] | 0x20) != lowercase[i]) {
+      return false;
+    }
+  }
+  return i == len && lowercase[i] == '\0';
+}
+
+/**
+ * Parse an optionally signed decimal integer that spans all of `str`. The
+ * magnitude is returned in `magnitude`, which saturates at UINT64_MAX.
+ */
+static e_clapc_number_status parse_integer(
+  const char* str, size_t len, bool* negative, uint64_t* magnitude)
+{
+  size_t i = 0;
+  *negative = false;
+  if (i < len && (str[i] == '-' || str[i] == '+')) {
+    *negative = str[i] == '-';
+    i++;
+  }
+  if (i == len) {
+    return CLAPC_NUMBER_INVALID;
+  }
+
+  uint64_t value = 0;
+  bool overflow = false;
+  for (; i < len; i++) {
+    unsigned digit = (unsigned char)(str[i] - '0');
+    if (digit >= 10) {
+      return CLAPC_NUMBER_INVALID;
+    }
+    if (value > (UINT64_MAX - digit) / 10) {
+      overflow = true;
+    }
+    value = value * 10 + digit;
+  }
+
+  *magnitude = overflow ? UINT64_MAX : value;
+  return overflow ? CLAPC_NUMBER_OUT_OF_RANGE : CLAPC_NUMBER_OK;
+}
+
+/**
+ * The "C" locale, used when we have to fall back to libc to convert a decimal
+ * number. It's created once and never freed.
+ */
+static locale_t c_locale(void)
+{
+  static locale_t locale = (locale_t)0;
+
+  locale_t current = __atomic_load_n(&locale, __ATOMIC_ACQUIRE);
+  if (current != (locale_t)0) {
+    return current;
+  }
+
+  locale_t created = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+  if (created == (locale_t)0) {
+    return (locale_t)0;
+  }
+  if (!__atomic_compare_exchange_n(&locale, &current, created, false,
+        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    // Another thread won the race
+    freelocale(created);
+    return current;
+  }
+  return created;
+}
+
+/**
+ * Convert an already validated decimal number with libc in the "C" locale,
+ * which rounds correctly for any number of digits.
+ */
+static e_clapc_number_status convert_decimal_slow(
+  const char* str, size_t len, bool single, void* out)
+{
+  char stack_buffer[128];
+  char* buffer = stack_buffer;
+
+  if (len >= sizeof(stack_buffer)) {
+    buffer = malloc(len + 1);
+    STATS_ADD(allocations, 1);
+    if (buffer == NULL) {
+      return CLAPC_NUMBER_INVALID;
+    }
+  }
+  memcpy(buffer, str, len);
+  buffer[len] = '\0';
+
+  locale_t locale = c_locale();
+  bool is_inf;
+  if (single) {
+    float value
+      = locale ? strtof_l(buffer, NULL, locale) : strtof(buffer, NULL);
+    is_inf = isinf(value);
+    if (!is_inf) {
+      *(float*)out = value;
+    }
+  } else {
+    double value
+      = locale ? strtod_l(buffer, NULL, locale) : strtod(buffer, NULL);
+    is_inf = isinf(value);
+    if (!is_inf) {
+      *(double*)out = value;
+    }
+  }
+
+  if (buffer != stack_buffer) {
+    free(buffer);
+  }
+
+  // The input is finite, so an infinite result means it overflowed
+  return is_inf ? CLAPC_NUMBER_OUT_OF_RANGE : CLAPC_NUMBER_OK;
+}
+
+/**
+ * Parse a decimal floating-point number that spans all of `str`. Numbers with
+ * up to 19 significant digits and small exponents (which is what people type
+ * on a command line) are converted exactly without calling into libc.
+ */
+static e_clapc_number_status parse_decimal(
+  const char* str, size_t len, bool single, void* out)
+{
+  size_t i = 0;
+  bool negative = false;
+  if (i < len && (str[i] == '-' || str[i] == '+')) {
+    negative = str[i] == '-';
+    i++;
+  }
+
+  if (matches_ignore_case(str + i, len - i, "inf")
+    || matches_ignore_case(str + i, len - i, "infinity")) {
+    if (single) {
+      *(float*)out = negative ? -INFINITY : INFINITY;
+    } else {
+      *(double*)out = negative ? -(double)INFINITY : (double)INFINITY;
+    }
+    return CLAPC_NUMBER_OK;
+  }
+  if (matches_ignore_case(str + i, len - i, "nan")) {
+    if (single) {
+      *(float*)out = NAN;
+    } else {
+      *(double*)out = (double)NAN;
+    }
+    return CLAPC_NUMBER_OK;
+  }
+
+  uint64_t mantissa = 0;
+  int significant_digits = 0;
+  int64_t exponent = 0;
+  size_t digits = 0;
+  bool truncated = false;
+
+  for (; i < len && is_digit(str[i]); i++, digits++) {
+    if (significant_digits < 19) {
+      mantissa = mantissa * 10 + (str[i] - '0');
+      significant_digits += mantissa != 0;
+    } else {
+      truncated |= str[i] != '0';
+      exponent++;
+    }
+  }
+  if (i < len && str[i] == '.') {
+    for (i++; i < len && is_digit(str[i]); i++, digits++) {
+      if (significant_digits < 19) {
+        mantissa = mantissa * 10 + (str[i] - '0');
+        significant_digits += mantissa != 0;
+        exponent--;
+      } else {
+        truncated |= str[i] != '0';
+      }
+    }
+  }
+  if (digits == 0) {
+    return CLAPC_NUMBER_INVALID;
+  }
+
+  if (i < len && (str[i] == 'e' || str[i] == 'E')) {
+    i++;
+    bool negative_exponent = false;
+    if (i < len && (str[i] == '-' || str[i] == '+')) {
+      negative_exponent = str[i] == '-';
+      i++;
+    }
+    if (i == len) {
+      return CLAPC_NUMBER_INVALID;
+    }
+    int64_t explicit_exponent = 0;
+    for (; i < len && is_digit(str[i]); i++) {
+      // Anything past this is zero or infinity anyway
+      if (explicit_exponent < 100000) {
+        explicit_exponent = explicit_exponent * 10 + (str[i] - '0');
+      }
+    }
+    exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+  }
+  if (i != len) {
+    return CLAPC_NUMBER_INVALID;
+  }
+
+  // Clinger's fast path: both the mantissa and the power of ten are exact, so
+  // a single IEEE multiplication or division rounds correctly.
+  if (!truncated && single && mantissa <= (1u << 24) && exponent >= -10
+    && exponent <= 10) {
+    float value = (float)mantissa;
+    value = exponent < 0 ? value / exact_powers_of_ten_f[-exponent]
+                         : value * exact_powers_of_ten_f[exponent];
+    *(float*)out = negative ? -value : value;
+    return CLAPC_NUMBER_OK;
+  }
+  if (!truncated && !single && mantissa <= (1ull << 53) && exponent >= -22
+    && exponent <= 22) {
+    double value = (double)mantissa;
+    value = exponent < 0 ? value / exact_powers_of_ten[-exponent]
+                         : value * exact_powers_of_ten[exponent];
+    *(double*)out = negative ? -value : value;
+    return CLAPC_NUMBER_OK;
+  }
+  if (mantissa == 0 && !truncated) {
+    if (single) {
+      *(float*)out = negative ? -0.0f : 0.0f;
+    } else {
+      *(double*)out = negative ? -0.0 : 0.0;
+    }
+    return CLAPC_NUMBER_OK;
+  }
+
+  return convert_decimal_slow(str, len, single, out);
+}
+
+e_clapc_number_status clapc_parse_number(
+  const char* str, size_t len, e_clapc_number_type type, void* out)
+{
+  switch (type) {
+  case CLAPC_NUMBER_INT32:
+  case CLAPC_NUMBER_INT64: {
+    bool negative;
+    uint64_t magnitude;
+    auto status = parse_integer(str, len, &negative, &magnitude);
+    if (status != CLAPC_NUMBER_OK) {
+      return status;
+    }
+
+    uint64_t limit = type == CLAPC_NUMBER_INT32 ? (uint64_t)INT32_MAX
+                                                : (uint64_t)INT64_MAX;
+    if (magnitude > limit + negative) {
+      return CLAPC_NUMBER_OUT_OF_RANGE;
+    }
+    // Negate in unsigned arithmetic so that the minimum value doesn't overflow
+    int64_t value = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+    if (type == CLAPC_NUMBER_INT32) {
+      *(int32_t*)out = (int32_t)value;
+    } else {
+      *(int64_t*)out = value;
+    }
+    return CLAPC_NUMBER_OK;
+  }
+  case CLAPC_NUMBER_UINT64: {
+    bool negative;
+    uint64_t magnitude;
+    auto status = parse_integer(str, len, &negative, &magnitude);
+    if (status != CLAPC_NUMBER_OK) {
+      return status;
+    }
+    if (negative && magnitude != 0) {
+      return CLAPC_NUMBER_OUT_OF_RANGE;
+    }
+    *(uint64_t*)out = magnitude;
+    return CLAPC_NUMBER_OK;
+  }
+  case CLAPC_NUMBER_FLOAT:
+    return parse_decimal(str, len, true, out);
+  case CLAPC_NUMBER_DOUBLE:
+    return parse_decimal(str, len, false, out);
+  }
+  return CLAPC_NUMBER_INVALID;
+}
+
+/**
+ * A non-negative decimal number that is about to be multiplied by a unit. The
+ * fraction is kept as the first (up to) 19 digits over a power of ten, so that
+ * scaling it is exact.
+ */
+typedef struct {
+  uint64_t whole;
+  uint64_t numerator;
+  uint64_t denominator;
+  bool overflow;
+} s_scaled_decimal;
+
+/**
+ * Parse a number like "1" or "1.5" from the start of `*str_ptr` (up to `end`),
+ * and move `*str_ptr` past it.
+ *
+ * @return false if there is no number there.
+ */
+static bool parse_scaled_decimal(
+  const char** str_ptr, const char* end, s_scaled_decimal* out)
+{
+  const char* str = *str_ptr;
+  *out = (s_scaled_decimal) { .denominator = 1 };
+  bool digits = false;
+
+  for (; str < end && is_digit(*str); str++) {
+    unsigned digit = (unsigned)(*str - '0');
+    out->overflow |= out->whole > (UINT64_MAX - digit) / 10;
+    out->whole = out->whole * 10 + digit;
+    digits = true;
+  }
+
+  if (str < end && *str == '.') {
+    for (str++; str < end && is_digit(*str); str++) {
+      // Digits past the 19th can only change the result by less than a unit
+      if (out->denominator <= UINT64_MAX / 10 / 10) {
+        out->numerator = out->numerator * 10 + (uint64_t)(*str - '0');
+        out->denominator *= 10;
+      }
+      digits = true;
+    }
+  }
+
+  *str_ptr = str;
+  return digits;
+}
+
+/**
+ * Multiply `number` by `unit`, rounding down.
+ */
+static e_clapc_number_status scale_decimal(
+  const s_scaled_decimal* number, uint64_t unit, uint64_t* out)
+{
+  if (number->overflow) {
+    return CLAPC_NUMBER_OUT_OF_RANGE;
+  }
+  unsigned __int128 value = (unsigned __int128)number->whole * unit
+    + (unsigned __int128)number->numerator * unit / number->denominator;
+  if (value > UINT64_MAX) {
+    return CLAPC_NUMBER_OUT_OF_RANGE;
+  }
+  *out = (uint64_t)value;
+  return CLAPC_NUMBER_OK;
+}
+
+e_clapc_number_status clapc_parse_size(
+  const char* str, size_t len, uint64_t* out)
+{
+  static const char prefixes[] = "KMGTPE";
+  const char* end = str + len;
+
+  s_scaled_decimal number;
+  if (!parse_scaled_decimal(&str, end, &number)) {
+    return CLAPC_NUMBER_INVALID;
+  }
+
+  unsigned shift = 0;
+  const char* prefix
+    = str < end && *str != '\0' ? strchr(prefixes, *str == 'k' ? 'K' : *str)
+                                : NULL;
+  if (prefix) {
+    shift = 10 * (unsigned)(prefix - prefixes + 1);
+    str++;
+    if (end - str >= 2 && str[0] == 'i' && str[1] == 'B') {
+      str += 2;
+    } else if (str < end && *str == 'B') {
+      str++;
+    }
+  } else if (str < end && *str == 'B') {
+    str++;
+  }
+
+  if (str != end) {
+    return CLAPC_NUMBER_INVALID;
+  }
+  return scale_decimal(&number, UINT64_C(1) << shift, out);
+}
+
+/**
+ * The units of durations. Units that start with another unit come first.
+ */
+static const struct {
+  const char* name;
+  size_t len;
+  uint64_t ns;
+} duration_units[] = {
+  { "ns", 2, 1 },
+  { "us", 2, 1000 },
+  { "\xc2\xb5s", 3, 1000 },
+  { "ms", 2, 1000000 },
+  { "s", 1, 1000000000 },
+  { "m", 1, UINT64_C(60) * 1000000000 },
+  { "h", 1, UINT64_C(3600) * 1000000000 },
+  { "d", 1, UINT64_C(86400) * 1000000000 },
+};
+
+e_clapc_number_status clapc_parse_duration(
+  const char* str, size_t len, uint64_t* out)
+{
+  if (len == 1 && str[0] == '0') {
+    *out = 0;
+    return CLAPC_NUMBER_OK;
+  }
+
+  const char* end = str + len;
+  uint64_t total = 0;
+  e_clapc_number_status status = CLAPC_NUMBER_INVALID;
+
+  while (str < end) {
+    s_scaled_decimal number;
+    if (!parse_scaled_decimal(&str, end, &number)) {
+      return CLAPC_NUMBER_INVALID;
+    }
+
+    size_t unit = 0;
+    size_t unit_count = sizeof(duration_units) / sizeof(duration_units[0]);
+    while (unit < unit_count
+      && ((size_t)(end - str) < duration_units[unit].len
+        || memcmp(str, duration_units[unit].name, duration_units[unit].len)
+          != 0)) {
+      unit++;
+    }
+    if (unit == unit_count) {
+      return CLAPC_NUMBER_INVALID;
+    }
+    str += duration_units[unit].len;
+
+    // Keep going after an overflow, since the rest may not be a duration
+    uint64_t part;
+    if (status != CLAPC_NUMBER_OUT_OF_RANGE) {
+      status = scale_decimal(&number, duration_units[unit].ns, &part);
+    }
+    if (status == CLAPC_NUMBER_OK && total > UINT64_MAX - part) {
+      status = CLAPC_NUMBER_OUT_OF_RANGE;
+    }
+    if (status == CLAPC_NUMBER_OK) {
+      total += part;
+    }
+  }
+
+  if (status == CLAPC_NUMBER_OK) {
+    *out = total;
+  }
+  return status;
+}
+
+/**
+ * Turn the status of parsing the value of an argument into an error.
+ */
+static bool check_number_status(e_clapc_number_status status,
+  const char* value, size_t len, const char* name, s_clapc_error* error)
+{
+  if (status == CLAPC_NUMBER_OK) {
+    return true;
+  }
+
+  *error = (s_clapc_error) {
+    .code = status == CLAPC_NUMBER_OUT_OF_RANGE ? CLAPC_ERROR_OUT_OF_RANGE
+                                                : CLAPC_ERROR_INVALID_VALUE,
+    .option = name,
+    .value = value,
+    .value_len = len,
+  };
+  return false;
+}
+
+/**
+ * Parse the value of a numeric argument, setting `error` if it fails.
+ */
+static bool parse_number_value(const char* value, size_t len,
+  e_clapc_number_type type, void* out, const char* name, s_clapc_error* error)
+{
+  return check_number_status(
+    clapc_parse_number(value, len, type, out), value, len, name, error);
+}
+
+// Response files ==============================================================
+
+/**
+ * A response file that was loaded while parsing. Response files stay mapped
+ * until whatever they were loaded for is freed, since both the values borrowed
+ * from them and the arguments left after parsing point into them.
+ */
+typedef struct clapc_response_file {
+  struct clapc_response_file* next;
+  /**
+   * The private, writable mapping of the file. This is NULL for token tables
+   * that don't own a mapping.
+   */
+  void* map;
+  size_t map_len;
+  /**
+   * The null-terminated table of tokens in the file.
+   */
+  char** tokens;
+} s_response_file;
+
+/**
+ * Add `file` to the response files of whatever it was loaded for.
+ */
+static void keep_response_file(s_response_file** files, s_response_file* file)
+{
+  file->next = *files;
+  *files = file;
+}
+
+/**
+ * Release `file` and every response file kept after it.
+ */
+static void free_response_files(s_response_file* file)
+{
+  while (file) {
+    s_response_file* next = file->next;
+    if (file->map) {
+      munmap(file->map, file->map_len);
+    }
+    free(file->tokens);
+    free(file);
+    file = next;
+  }
+}
+
+typedef enum {
+  CHAR_PLAIN = 0,
+  CHAR_SPACE,
+  CHAR_SPECIAL,
+} e_char_class;
+
+static const unsigned char char_classes[256] = {
+  [' '] = CHAR_SPACE,
+  ['\t'] = CHAR_SPACE,
+  ['\n'] = CHAR_SPACE,
+  ['\v'] = CHAR_SPACE,
+  ['\f'] = CHAR_SPACE,
+  ['\r'] = CHAR_SPACE,
+  ['\''] = CHAR_SPECIAL,
+  ['"'] = CHAR_SPECIAL,
+  ['\\'] = CHAR_SPECIAL,
+};
+
+/**
+ * Find the first character from `read` (up to `end`) that isn't plain, i.e. the
+ * end of an unquoted run of a token. With SSE2, 16 characters are classified
+ * at once.
+ */
+static char* scan_plain(char* read, char* end)
+{
+#ifdef __SSE2__
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i single_quote = _mm_set1_epi8('\'');
+  const __m128i double_quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  // '\t' to '\r' are the other whitespace characters
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i control_range = _mm_set1_epi8('\r' - '\t');
+
+  while (end - read >= 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i*)read);
+    __m128i offset = _mm_sub_epi8(chunk, tab);
+    __m128i special = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(chunk, space),
+        _mm_cmpeq_epi8(chunk, single_quote)),
+      _mm_or_si128(_mm_cmpeq_epi8(chunk, double_quote),
+        _mm_cmpeq_epi8(chunk, backslash)));
+    special = _mm_or_si128(special,
+      _mm_cmpeq_epi8(_mm_min_epu8(offset, control_range), offset));
+
+    int mask = _mm_movemask_epi8(special);
+    if (mask != 0) {
+      return read + __builtin_ctz((unsigned)mask);
+    }
+    read += 16;
+  }
+#endif
+
+  while (read < end && char_classes[(unsigned char)*read] == CHAR_PLAIN) {
+    read++;
+  }
+  return read;
+}
+
+/**
+ * Read the next token from `*read_ptr` (up to `end`) in place. Tokens are
+ * separated by whitespace. A backslash escapes the next character, single
+ * quotes keep everything up to the next single quote, and double quotes do the
+ * same but still let a backslash escape a double quote or a backslash. Quotes
+ * and escapes are removed by shifting the rest of the token back, and the token
+ * is null-terminated where it ends, so `*end` must be writable.
+ *
+ * @param token_ptr Set to the token, or NULL if there are no tokens left
+ * @return false if a quote is not terminated, true otherwise
+ */
+static bool next_token(char** read_ptr, char* end, char** token_ptr)
+{
+  const unsigned char* classes = char_classes;
+  char* read = *read_ptr;
+
+  while (read < end && classes[(unsigned char)*read] == CHAR_SPACE) {
+    read++;
+  }
+  if (read == end) {
+    *read_ptr = read;
+    *token_ptr = NULL;
+    return true;
+  }
+
+  char* token = read;
+
+  // Most tokens have no quotes or escapes, and are left where they are
+  read = scan_plain(read, end);
+
+  char* write = read;
+#ifdef CLAPC_STATS
+  char* shifted = write;
+#endif
+  while (read < end && classes[(unsigned char)*read] != CHAR_SPACE) {
+    char c = *read++;
+
+    if (c == '\\') {
+      if (read < end) {
+        *write++ = *read++;
+      }
+    } else if (c == '\'' || c == '"') {
+      while (read < end && *read != c) {
+        if (c == '"' && *read == '\\' && read + 1 < end
+          && (read[1] == '"' || read[1] == '\\')) {
+          read++;
+        }
+        *write++ = *read++;
+      }
+      if (read == end) {
+        return false;
+      }
+      read++;
+    } else {
+      *write++ = c;
+    }
+  }
+  STATS_ADD(bytes_copied, (size_t)(write - shifted));
+
+  // This either overwrites the separator or is at most `*end`
+  *write = '\0';
+  if (read < end) {
+    read++;
+  }
+
+  *read_ptr = read;
+  *token_ptr = token;
+  return true;
+}
+
+/**
+ * Split `buffer` into tokens in place, see {@link next_token}. `buffer[len]`
+ * must be writable.
+ *
+ * @return The null-terminated table of tokens, or NULL if a quote is not
+ * terminated or the table couldn't be allocated (`error` tells which).
+ */
+static char** tokenize_in_place(
+  char* buffer, size_t len, const char* path, s_clapc_error* error)
+{
+  size_t count = 0;
+  size_t capacity = 64;
+  char** tokens = malloc(capacity * sizeof(char*));
+  STATS_ADD(allocations, 1);
+  if (tokens == NULL) {
+    *error = (s_clapc_error) { .code = CLAPC_ERROR_OUT_OF_MEMORY };
+    return NULL;
+  }
+
+  char* read = buffer;
+  char* end = buffer + len;
+
+  for (;;) {
+    char* token;
+    if (!next_token(&read, end, &token)) {
+      *error = (s_clapc_error) {
+        .code = CLAPC_ERROR_RESPONSE_FILE_QUOTE,
+        .value = path,
+        .value_len = strlen(path),
+      };
+      free(tokens);
+      return NULL;
+    }
+    if (token == NULL) {
+      break;
+    }
+
+    // Always leave room for the null-terminator
+    if (count + 1 == capacity) {
+      capacity *= 2;
+      char** grown = realloc(tokens, capacity * sizeof(char*));
+      STATS_ADD(allocations, 1);
+      if (grown == NULL) {
+        *error = (s_clapc_error) { .code = CLAPC_ERROR_OUT_OF_MEMORY };
+        free(tokens);
+        return NULL;
+      }
+      tokens = grown;
+    }
+    tokens[count++] = token;
+  }
+
+  tokens[count] = NULL;
+  return tokens;
+}
+
+bool clapc_tokenize(char* buffer, size_t len, char** argv, size_t capacity,
+  size_t* count_ptr, char** error)
+{
+  assert(capacity > 0);
+  *error = NULL;
+
+  char* read = buffer;
+  char* end = buffer + len;
+  size_t count = 0;
+
+  for (;;) {
+    char* token;
+    if (!next_token(&read, end, &token)) {
+      asprintf(error, "Unterminated quote\n");
+      return false;
+    }
+    if (token == NULL) {
+      break;
+    }
+
+    // Always leave room for the null-terminator
+    if (count + 1 >= capacity) {
+      asprintf(error, "Too many tokens\n");
+      return false;
+    }
+    argv[count++] = token;
+  }
+
+  argv[count] = NULL;
+  *count_ptr = count;
+  return true;
+}
+
+/**
+ * Map a file privately and writably, followed by at least one zero byte, so
+ * that it can be modified in place without touching the file and the last byte
+ * can always be null-terminated.
+ *
+ * @return The mapping, or NULL. `opened` tells whether the file could be opened
+ * at all.
+ */
+static char* map_file(
+  const char* path, size_t* size_ptr, size_t* map_len_ptr, bool* opened)
+{
+  *opened = false;
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return NULL;
+  }
+  *opened = true;
+
+  size_t size = (size_t)st.st_size;
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  // Reserve one more byte than the file has. Whatever isn't backed by the file
+  // is zeros.
+  size_t map_len = (size + 1 + page_size - 1) & ~(page_size - 1);
+
+  char* map = mmap(NULL, map_len, PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED) {
+    close(fd);
+    return NULL;
+  }
+  if (size > 0
+    && mmap(map, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0)
+      == MAP_FAILED) {
+    munmap(map, map_len);
+    close(fd);
+    return NULL;
+  }
+  close(fd);
+
+  madvise(map, map_len, MADV_SEQUENTIAL);
+
+  *size_ptr = size;
+  *map_len_ptr = map_len;
+  return map;
+}
+
+/**
+ * Map a response file and tokenize it.
+ *
+ * @return The loaded file, or NULL. If the file couldn't be opened, the code of
+ * `error` is CLAPC_ERROR_NONE.
+ */
+static s_response_file* load_response_file(
+  const char* path, s_clapc_error* error)
+{
+  size_t size;
+  size_t map_len;
+  bool opened;
+  char* map = map_file(path, &size, &map_len, &opened);
+  if (map == NULL) {
+    *error = (s_clapc_error) {
+      .code = opened ? CLAPC_ERROR_RESPONSE_FILE : CLAPC_ERROR_NONE,
+      .value = path,
+      .value_len = strlen(path),
+    };
+    return NULL;
+  }
+
+  s_response_file* file = calloc(1, sizeof(*file));
+  STATS_ADD(allocations, 1);
+  char** tokens = file ? tokenize_in_place(map, size, path, error) : NULL;
+  if (tokens == NULL) {
+    if (file == NULL) {
+      *error = (s_clapc_error) { .code = CLAPC_ERROR_OUT_OF_MEMORY };
+    }
+    free(file);
+    munmap(map, map_len);
+    return NULL;
+  }
+
+  file->map = map;
+  file->map_len = map_len;
+  file->tokens = tokens;
+  return file;
+}
+
+// Errors ======================================================================
+
+size_t clapc_error_format(
+  const s_clapc_error* error, char* buffer, size_t size)
+{
+  int value_len = (int)error->value_len;
+  int len;
+
+  switch (error->code) {
+  case CLAPC_ERROR_NONE:
+    len = snprintf(buffer, size, "%s", "");
+    break;
+  case CLAPC_ERROR_OUT_OF_MEMORY:
+    len = snprintf(buffer, size, "Out of memory\n");
+    break;
+  case CLAPC_ERROR_UNKNOWN_ARGUMENT:
+    if (error->other) {
+      len = snprintf(buffer, size,
+        "Invalid argument '%.*s', did you mean '--%s'?\n", value_len,
+        error->value, error->other->name);
+    } else {
+      len = snprintf(
+        buffer, size, "Invalid argument '%.*s'\n", value_len, error->value);
+    }
+    break;
+  case CLAPC_ERROR_REPEATED_ARGUMENT:
+    len = snprintf(buffer, size,
+      "Argument '" OPTION_FORMAT "' given more than once\n",
+      OPTION_ARGS(error->arg));
+    break;
+  case CLAPC_ERROR_MISSING_VALUE:
+    len = snprintf(
+      buffer, size, "Missing positional argument for '%s'\n", error->option);
+    break;
+  case CLAPC_ERROR_INVALID_VALUE:
+    if (error->reason) {
+      len = snprintf(buffer, size,
+        "Invalid value '%.*s' for argument '%s': %s\n", value_len,
+        error->value, error->option, error->reason);
+    } else {
+      len = snprintf(buffer, size, "Invalid value '%.*s' for argument '%s'\n",
+        value_len, error->value, error->option);
+    }
+    break;
+  case CLAPC_ERROR_OUT_OF_RANGE:
+    len = snprintf(buffer, size, "Value out of range for argument '%s'\n",
+      error->option);
+    break;
+  case CLAPC_ERROR_MISSING_REQUIRED:
+    len = snprintf(buffer, size,
+      "Missing required argument '" OPTION_FORMAT "'\n",
+      OPTION_ARGS(error->arg));
+    break;
+  case CLAPC_ERROR_CONFLICT:
+    len = snprintf(buffer, size,
+      "Arguments '" OPTION_FORMAT "' and '" OPTION_FORMAT
+      "' can't be used together\n",
+      OPTION_ARGS(error->arg), OPTION_ARGS(error->other));
+    break;
+  case CLAPC_ERROR_MISSING_DEPENDENCY:
+    len = snprintf(buffer, size,
+      "Argument '" OPTION_FORMAT "' requires '" OPTION_FORMAT "'\n",
+      OPTION_ARGS(error->arg), OPTION_ARGS(error->other));
+    break;
+  case CLAPC_ERROR_UNKNOWN_CONSTRAINT:
+    len = snprintf(buffer, size,
+      "Unknown argument '--%.*s' in constraints of '" OPTION_FORMAT "'\n",
+      value_len, error->value, OPTION_ARGS(error->arg));
+    break;
+  case CLAPC_ERROR_NO_PARSE_FUNCTION:
+    len = snprintf(buffer, size, "Argument '%s' has no parse function\n",
+      error->option);
+    break;
+  case CLAPC_ERROR_NO_DESTINATION:
+    len = snprintf(
+      buffer, size, "Argument '%s' has no destination\n", error->option);
+    break;
+  case CLAPC_ERROR_RESPONSE_FILE:
+    len = snprintf(buffer, size, "Unable to map response file '%.*s'\n",
+      value_len, error->value);
+    break;
+  case CLAPC_ERROR_RESPONSE_FILE_QUOTE:
+    len = snprintf(buffer, size,
+      "Unterminated quote in response file '%.*s'\n", value_len,
+      error->value);
+    break;
+  case CLAPC_ERROR_RESPONSE_FILE_DEPTH:
+    len = snprintf(buffer, size, "Response files nested too deeply at '%s'\n",
+      error->option);
+    break;
+  case CLAPC_ERROR_INVALID_TYPE:
+  default:
+    len = snprintf(buffer, size, "Invalid argument type\n");
+    break;
+  }
+
+  return len < 0 ? 0 : (size_t)len;
+}
+
+/**
+ * Format `error` into a new string, for the functions that report errors as
+ * strings.
+ *
+ * @return The message, or NULL if it couldn't be allocated.
+ */
+static char* error_string(const s_clapc_error* error)
+{
+  size_t len = clapc_error_format(error, NULL, 0);
+  char* message = malloc(len + 1);
+  if (message) {
+    clapc_error_format(error, message, len + 1);
+  }
+  return message;
+}
+
+// Parsing =====================================================================
+
+/**
+ * Get the memory a scalar value of `size` bytes should be written to. This is
+ * the caller-owned `dest` if there is one. Otherwise, the value is allocated
+ * from the allocator of the argument once, and reused if the argument is given
+ * more than once.
+ *
+ * @return The storage, or NULL if the allocation failed.
+ */
+static void* value_storage(s_clap_arg* arg, size_t size)
+{
+  if (arg->dest) {
+    arg->value = arg->dest;
+  } else if (arg->value == NULL) {
+    arg->value = mem_alloc(arg->allocator, size);
+    STATS_ADD(allocations, 1);
+    if (arg->value) {
+      memset(arg->value, 0, size);
+    }
+  }
+  return arg->value;
+}
+
+static bool is_list_type(e_clap_arg_type type)
+{
+  return type == CLAP_ARG_TYPE_INT_LIST || type == CLAP_ARG_TYPE_FLOAT_LIST
+    || type == CLAP_ARG_TYPE_STRING_LIST;
+}
+
+static size_t list_item_size(e_clap_arg_type type)
+{
+  switch (type) {
+  case CLAP_ARG_TYPE_INT_LIST:
+    return sizeof(int);
+  case CLAP_ARG_TYPE_FLOAT_LIST:
+    return sizeof(float);
+  default:
+    return sizeof(s_clap_str);
+  }
+}
+
+/**
+ * Make room for one more item at the end of `list`, growing its buffer
+ * geometrically so that appending is amortized O(1).
+ *
+ * @return A pointer to the new item, or NULL if the buffer couldn't be grown.
+ */
+static void* list_push(
+  s_clap_list* list, size_t item_size, const s_clapc_allocator* allocator)
+{
+  if (list->count == list->capacity) {
+    size_t capacity = list->capacity ? list->capacity * 2 : 8;
+    if (capacity > SIZE_MAX / item_size) {
+      return NULL;
+    }
+    void* items = mem_realloc(allocator, list->items,
+      list->capacity * item_size, capacity * item_size);
+    STATS_ADD(allocations, 1);
+    if (items == NULL) {
+      return NULL;
+    }
+    list->items = items;
+    list->capacity = capacity;
+  }
+  return (char*)list->items + list->count++ * item_size;
+}
+
+/**
+ * Append every comma-separated item in `value` to `list`, whose items are of
+ * the list type `type` and come from `allocator`. String items are views of
+ * `value`, so nothing is copied.
+ */
+static bool append_list(s_clap_list* list, e_clap_arg_type type, char* value,
+  const s_clapc_allocator* allocator, const char* option, s_clapc_error* error)
+{
+  size_t item_size = list_item_size(type);
+  char* item = value;
+
+  for (;;) {
+    char* comma = strchr(item, ',');
+    size_t len = comma ? (size_t)(comma - item) : strlen(item);
+
+    void* slot = list_push(list, item_size, allocator);
+    if (slot == NULL) {
+      *error = (s_clapc_error) { .code = CLAPC_ERROR_OUT_OF_MEMORY };
+      return false;
+    }
+
+    bool ok = true;
+    switch (type) {
+    case CLAP_ARG_TYPE_INT_LIST: {
+      int32_t number;
+      ok = parse_number_value(
+        item, len, CLAPC_NUMBER_INT32, &number, option, error);
+      if (ok) {
+        *(int*)slot = number;
+      }
+      break;
+    }
+    case CLAP_ARG_TYPE_FLOAT_LIST:
+      ok = parse_number_value(
+        item, len, CLAPC_NUMBER_FLOAT, slot, option, error);
+      break;
+    default:
+      *(s_clap_str*)slot = (s_clap_str) { .data = item, .len = len };
+      break;
+    }
+
+    if (!ok) {
+      list->count--;
+      return false;
+    }
+    if (comma == NULL) {
+      return true;
+    }
+    item = comma + 1;
+  }
+}
+
+static bool store_list(
+  s_clap_arg* arg, char* value, const char* option, s_clapc_error* error)
+{
+  s_clap_list* list = value_storage(arg, sizeof(s_clap_list));
+  if (list == NULL) {
+    *error = (s_clapc_error) { .code = CLAPC_ERROR_OUT_OF_MEMORY };
+    return false;
+  }
+  return append_list(list, arg->type, value, arg->allocator, option, error);
+}
+
+/**
+ * Whether `arg->value` was allocated by clapc and must be freed by it.
+ */
+static bool owns_value(const s_clap_arg* arg)
+{
+  return arg->dest == NULL
+    && !(arg->borrow && arg->type == CLAP_ARG_TYPE_STRING);
+}
+
+/**
+ * Whether `arg` holds memory from its allocator, which more values must come
+ * from as well.
+ */
+static bool holds_memory(const s_clap_arg* arg)
+{
+  if (arg->value == NULL) {
+    return false;
+  }
+  return owns_value(arg)
+    || (is_list_type(arg->type) && ((s_clap_list*)arg->value)->items);
+}
+
+/**
+ * Have the next values of `arg` allocated from `allocator`, unless it already
+ * holds memory from another one.
+ */
+static void use_allocator(s_clap_arg* arg, const s_clapc_allocator* allocator)
+{
+  if (!holds_memory(arg)) {
+    arg->allocator = allocator;
+  }
+}
+
+/**
+ * Forget the value of `arg` if it came from an arena, without reading it: the
+ * arena may have been reset since. Its response files are kept, as other
+ * arguments may still borrow from them.
+ */
+static void forget_arena_value(s_clap_arg* arg)
+{
+  if (!is_arena(arg->allocator)) {
+    return;
+  }
+  if (is_list_type(arg->type) && arg->dest) {
+    *(s_clap_list*)arg->dest = (s_clap_list) { 0 };
+  }
+  arg->value = NULL;
+  arg->value_len = 0;
+  arg->allocator = NULL;
+}
+
+/**
+ * Store a string value of `len` bytes. The string is only copied if the
+ * argument has neither a `dest` nor borrows its values.
+ *
+ * @return false if copying the string failed.
+ */
+static bool store_string(s_clap_arg* arg, char* str, size_t len)
+{
+  if (owns_value(arg)) {
+    mem_free(arg->allocator, arg->value, arg->value_len + 1);
+    char* copy = mem_alloc(arg->allocator, len + 1);
+    STATS_ADD(allocations, 1);
+    STATS_ADD(bytes_copied, len);
+    arg->value = copy;
+    if (copy == NULL) {
+      return false;
+    }
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+  } else {
+    arg->value = str;
+  }
+  if (arg->dest) {
+    *(const char**)arg->dest = str;
+  }
+  arg->value_len = len;
+  return true;
+}
+
+static bool parse_bool(const char* str, bool* out)
+{
+  if (strcmp(str, "true") == 0) {
+    *out = true;
+    return true;
+  }
+  if (strcmp(str, "false") == 0) {
+    *out = false;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * Hand `value` to the parse function of a custom argument, which writes it to
+ * `dest` (if it isn't NULL). `option` is the token that named the argument,
+ * used for error messages.
+ */
+static bool parse_custom(const s_clap_arg* arg, char* value, size_t len,
+  void* dest, const char* option, s_clapc_error* error)
+{
+  if (arg->parse == NULL) {
+    *error = (s_clapc_error) {
+      .code = CLAPC_ERROR_NO_PARSE_FUNCTION,
+      .option = option,
+      .arg = arg,
+    };
+    return false;
+  }
+
+  s_clap_str view = { .data = value, .len = len };
+  const char* reason = NULL;
+  if (arg->parse(view, dest, arg->parse_data, &reason)) {
+    return true;
+  }
+
+  *error = (s_clapc_error) {
+    .code = CLAPC_ERROR_INVALID_VALUE,
+    .option = option,
+    .value = value,
+    .value_len = len,
+    .arg = arg,
+    .reason = reason,
+  };
+  return false;
+}
+
+/**
+ * Parse `value` according to the type of `arg` (which is at `index` in `spec`,
+ * if there is one) into `out`. Strings are borrowed, and lists are not scalars
+ * and aren't converted here. `option` is the token that named the argument,
+ * used for error messages.
+ */
+static bool convert_value(const s_clapc_spec* spec, size_t index,
+  const s_clap_arg* arg, char* value, const char* option, s_clap_value* out,
+  s_clapc_error* error)
+{
+  size_t len = strlen(value);
+  s_clapc_error invalid = {
+    .code = CLAPC_ERROR_INVALID_VALUE,
+    .option = option,
+    .value = value,
+    .value_len = len,
+    .arg = arg,
+  };
+
+  switch (arg->type) {
+  case CLAP_ARG_TYPE_BOOL:
+    if (!parse_bool(value, &out->boolean)) {
+      *error = invalid;
+      return false;
+    }
+    return true;
+  case CLAP_ARG_TYPE_INT: {
+    int32_t number;
+    if (!parse_number_value(
+          value, len, CLAPC_NUMBER_INT32, &number, option, error)) {
+      return false;
+    }
+    out->integer = number;
+    return true;
+  }
+  case CLAP_ARG_TYPE_FLOAT:
+    return parse_number_value(
+      value, len, CLAPC_NUMBER_FLOAT, &out->number, option, error);
+  case CLAP_ARG_TYPE_STRING:
+    out->string = (s_clap_str) { .data = value, .len = len };
+    return true;
+  case CLAP_ARG_TYPE_INT64:
+    return parse_number_value(
+      value, len, CLAPC_NUMBER_INT64, &out->integer64, option, error);
+  case CLAP_ARG_TYPE_UINT64:
+    return parse_number_value(
+      value, len, CLAPC_NUMBER_UINT64, &out->unsigned64, option, error);
+  case CLAP_ARG_TYPE_DOUBLE:
+    return parse_number_value(
+      value, len, CLAPC_NUMBER_DOUBLE, &out->real, option, error);
+  case CLAP_ARG_TYPE_SIZE:
+    return check_number_status(
+      clapc_parse_size(value, len, &out->unsigned64), value, len, option,
+      error);
+  case CLAP_ARG_TYPE_DURATION:
+    return check_number_status(
+      clapc_parse_duration(value, len, &out->unsigned64), value, len, option,
+      error);
+  case CLAP_ARG_TYPE_ENUM:
+    out->integer = find_choice(spec, index, arg, value, len);
+    if (out->integer < 0) {
+      *error = invalid;
+      return false;
+    }
+    return true;
+  case CLAP_ARG_TYPE_CUSTOM:
+    // There is nowhere to parse the value into, so only validate it
+    out->string = (s_clap_str) { .data = value, .len = len };
+    return parse_custom(arg, value, len, NULL, option, error);
+  default:
+    *error = (s_clapc_error) { .code = CLAPC_ERROR_INVALID_TYPE, .arg = arg };
+    return false;
+  }
+}
+
+/**
+ * The size of the storage of a scalar value of `type`, see {@link
+ * s_clap_arg.dest}.
+ */
+static size_t value_size(e_clap_arg_type type)
+{
+  switch (type) {
+  case CLAP_ARG_TYPE_BOOL:
+    return sizeof(bool);
+  case CLAP_ARG_TYPE_INT:
+  case CLAP_ARG_TYPE_ENUM:
+    return sizeof(int);
+  case CLAP_ARG_TYPE_FLOAT:
+    return sizeof(float);
+  case CLAP_ARG_TYPE_DOUBLE:
+    return sizeof(double);
+  default:
+    return sizeof(uint64_t);
+  }
+}
+
+/**
+ * Parse `value` according to the type of `arg` and store it. Memory for it
+ * comes from `allocator`, unless the argument already holds memory from
+ * another one. `option` is the token that named the argument, used for error
+ * messages.
+ */
+static bool store_value(const s_clapc_spec* spec, size_t index,
+  s_clap_arg* arg, char* value, const s_clapc_allocator* allocator,
+  const char* option, s_clapc_error* error)
+{
+  use_allocator(arg, allocator);
+
+  if (is_list_type(arg->type)) {
+    return store_list(arg, value, option, error);
+  }
+
+  if (arg->type == CLAP_ARG_TYPE_CUSTOM) {
+    if (arg->dest == NULL) {
+      *error = (s_clapc_error) {
+        .code = CLAPC_ERROR_NO_DESTINATION,
+        .option = option,
+        .arg = arg,
+      };
+      return false;
+    }
+    if (!parse_custom(arg, value, strlen(value), arg->dest, option, error)) {
+      return false;
+    }
+    arg->value = arg->dest;
+    return true;
+  }
+
+  s_clap_value converted;
+  if (!convert_value(spec, index, arg, value, option, &converted, error)) {
+    return false;
+  }
+
+  if (arg->type == CLAP_ARG_TYPE_STRING) {
+    if (!store_string(arg, value, converted.string.len)) {
+      *error = (s_clapc_error) { .code = CLAPC_ERROR_OUT_OF_MEMORY };
+      return false;
+    }
+    return true;
+  }
+
+  // Every member of the value is at its start, so it can be copied as is
+  void* storage = value_storage(arg, value_size(arg->type));
+  if (storage == NULL) {
+    *error = (s_clapc_error) { .code = CLAPC_ERROR_OUT_OF_MEMORY };
+    return false;
+  }
+  memcpy(storage, &converted, value_size(arg->type));
+  return true;
+}
+
+/**
+ * Like {@link store_value}, but into the value of a result instead of the
+ * argument itself. Strings are always borrowed.
+ */
+static bool store_result_value(const s_clapc_spec* spec, size_t index,
+  s_clap_value* slot, char* value, const s_clapc_allocator* allocator,
+  const char* option, s_clapc_error* error)
+{
+  const s_clap_arg* arg = spec->args[index];
+  if (is_list_type(arg->type)) {
+    return append_list(&slot->list, arg->type, value, allocator, option, error);
+  }
+  return convert_value(spec, index, arg, value, option, slot, error);
+}
+
+/**
+ * Walks the tokens of argv, transparently descending into response files.
+ */
+typedef struct {
+  /**
+   * The current token. This points either into argv or into the token table of
+   * a response file.
+   */
+  char** pos;
+  /**
+   * How many response files we are currently inside of.
+   */
+  int depth;
+  /**
+   * Where to continue once the token table of each response file we are inside
+   * of runs out.
+   */
+  char** resume[CLAPC_MAX_RESPONSE_FILE_DEPTH];
+  /**
+   * Where the response files that are loaded are kept, or NULL if "@path"
+   * tokens are not expanded.
+   */
+  s_response_file** files;
+} s_cursor;
+
+/**
+ * Move the cursor to the next token the parser should read: leave exhausted
+ * response files and expand "@path" tokens.
+ */
+static bool cursor_settle(s_cursor* cursor, s_clapc_error* error)
+{
+  for (;;) {
+    char* token = *cursor->pos;
+
+    if (token == NULL) {
+      if (cursor->depth == 0) {
+        return true;
+      }
+      cursor->pos = cursor->resume[--cursor->depth];
+      continue;
+    }
+
+    if (cursor->files == NULL || token[0] != '@' || token[1] == '\0') {
+      return true;
+    }
+
+    if (cursor->depth == CLAPC_MAX_RESPONSE_FILE_DEPTH) {
+      *error = (s_clapc_error) {
+        .code = CLAPC_ERROR_RESPONSE_FILE_DEPTH,
+        .option = token,
+      };
+      return false;
+    }
+
+    STATS_TIMER_START(timer);
+    s_response_file* file = load_response_file(token + 1, error);
+    STATS_TIMER_STOP(timer, tokenize_ns);
+    if (file == NULL) {
+      // Just like in GCC, a file that can't be read is a regular argument
+      error->option = token;
+      return error->code == CLAPC_ERROR_NONE;
+    }
+    keep_response_file(cursor->files, file);
+
+    cursor->resume[cursor->depth++] = cursor->pos + 1;
+    cursor->pos = file->tokens;
+  }
+}
+
+static bool cursor_advance(s_cursor* cursor, s_clapc_error* error)
+{
+  STATS_ADD(tokens, 1);
+  cursor->pos++;
+  return cursor_settle(cursor, error);
+}
+
+/**
+ * The index in `argv` of the token the cursor is at. Inside response files,
+ * this is the "@path" token of argv that included them.
+ */
+static size_t cursor_index(const s_cursor* cursor, char** argv)
+{
+  char** token = cursor->depth > 0 ? cursor->resume[0] - 1 : cursor->pos;
+  return (size_t)(token - argv);
+}
+
+/**
+ * Get the tokens left after parsing stopped. If the cursor is inside response
+ * files, the rest of each of them is followed by the rest of argv.
+ */
+static char** cursor_remaining(s_cursor* cursor, s_clapc_error* error)
+{
+  if (cursor->depth == 0) {
+    return cursor->pos;
+  }
+
+  size_t count = 0;
+  for (char** token = cursor->pos; *token; token++) {
+    count++;
+  }
+  for (int i = cursor->depth - 1; i >= 0; i--) {
+    for (char** token = cursor->resume[i]; *token; token++) {
+      count++;
+    }
+  }
+
+  // The table must stay around as long as the response files do
+  s_response_file* remaining = calloc(1, sizeof(*remaining));
+  char** tokens = remaining ? malloc((count + 1) * sizeof(char*)) : NULL;
+  STATS_ADD(allocations, 2);
+  STATS_ADD(bytes_copied, count * sizeof(char*));
+  if (tokens == NULL) {
+    free(remaining);
+    *error = (s_clapc_error) { .code = CLAPC_ERROR_OUT_OF_MEMORY };
+    return NULL;
+  }
+
+  remaining->tokens = tokens;
+  for (char** token = cursor->pos; *token; token++) {
+    *tokens++ = *token;
+  }
+  for (int i = cursor->depth - 1; i >= 0; i--) {
+    for (char** token = cursor->resume[i]; *token; token++) {
+      *tokens++ = *token;
+    }
+  }
+  *tokens = NULL;
+
+  keep_response_file(cursor->files, remaining);
+  return remaining->tokens;
+}
+
+/**
+ * Where the response files loaded while parsing into `args` are kept. They
+ * belong to the whole array, so they are kept on its first argument. Without
+ * arguments, there is nowhere to keep them.
+ */
+static s_response_file** args_files(s_clap_arg* args[])
+{
+  return args[0] ? &args[0]->files : NULL;
+}
+
+/**
+ * Parse the tokens of `argv_ptr` against `args`, see {@link parse_args}. Every
+ * argument that is given is marked in `present`.
+ */
+static bool parse_tokens(const s_clapc_spec* spec, s_clap_arg* args[],
+  s_clapc_result* result, const s_clapc_allocator* allocator,
+  uint64_t* present, char*** argv_ptr, s_response_file** files, bool* dashes,
+  s_clapc_error* error)
+{
+  if (dashes) {
+    *dashes = false;
+  }
+
+  char** argv = *argv_ptr;
+  s_cursor cursor = {
+    // Skip first argument (it's always the executable name)
+    .pos = argv + 1,
+    .files = files,
+  };
+  if (!cursor_settle(&cursor, error)) {
+    error->index = cursor_index(&cursor, argv);
+    return false;
+  }
+  char* arg = *cursor.pos;
+
+  while (arg && *arg) {
+    // NOTE: right now we don't support out of order arguments. This means that
+    // no flags can be parsed after the first positional agurment. In the future
+    // we may want to put all positional arguments in a separate array and keep
+    // parsing flags.
+    //
+    // Left-over positional argument.
+    if (*arg != '-') {
+      break;
+    }
+
+    bool is_long = false;
+
+    if (arg[1] == '-') {
+      // Found "--", skip parsing. Whatever follows is not expanded.
+      if (arg[2] == '\0') {
+        cursor.pos++;
+        if (dashes) {
+          *dashes = true;
+        }
+        break;
+      }
+      is_long = true;
+    }
+
+    // The token that named the argument, for error messages
+    char* option = arg;
+    size_t option_index = cursor_index(&cursor, argv);
+
+    // This is the name of the arg
+    arg = arg + (is_long ? 2 : 1);
+
+    // Long arguments may carry their value inline, as in "--name=value". The
+    // name is looked up by length, so the token doesn't have to be split.
+    char* inline_value = is_long ? strchr(arg, '=') : NULL;
+    size_t name_len = inline_value ? (size_t)(inline_value - arg) : 0;
+    if (inline_value) {
+      inline_value++;
+    }
+
+    STATS_TIMER_START(lookup_timer);
+    size_t index;
+    auto clap_arg = is_long
+      ? find_long(
+          spec, args, arg, inline_value ? name_len : strlen(arg), &index)
+      : find_short(spec, args, *arg, &index);
+    STATS_TIMER_STOP(lookup_timer, lookup_ns);
+
+    if (clap_arg == NULL) {
+      size_t len = inline_value ? name_len : strlen(arg);
+      *error = (s_clapc_error) {
+        .code = CLAPC_ERROR_UNKNOWN_ARGUMENT,
+        .index = option_index,
+        .offset = (size_t)(arg - option),
+        .option = option,
+        .value = arg,
+        .value_len = len,
+        .other = is_long ? suggest_long(spec, args, arg, len) : NULL,
+      };
+      return false;
+    }
+
+    if (clap_arg->unique && bit_get(present, index)) {
+      *error = (s_clapc_error) {
+        .code = CLAPC_ERROR_REPEATED_ARGUMENT,
+        .index = option_index,
+        .option = option,
+        .arg = clap_arg,
+      };
+      return false;
+    }
+    bit_set(present, index);
+
+    if (!cursor_advance(&cursor, error)) {
+      error->index = cursor_index(&cursor, argv);
+      return false;
+    }
+
+    if (clap_arg->type != CLAP_ARG_TYPE_BOOL) {
+      // We need to consume the next arg, unless the value was inline
+      char* value = inline_value ? inline_value : *cursor.pos;
+      if (!value) {
+        *error = (s_clapc_error) {
+          .code = CLAPC_ERROR_MISSING_VALUE,
+          .index = option_index,
+          .offset = strlen(option),
+          .option = option,
+          .arg = clap_arg,
+        };
+        return false;
+      }
+
+      STATS_TIMER_START(convert_timer);
+      bool stored = result
+        ? store_result_value(spec, index, &result->values[index], value,
+            result->allocator, option, error)
+        : store_value(spec, index, clap_arg, value, allocator, option, error);
+      STATS_TIMER_STOP(convert_timer, convert_ns);
+      if (!stored) {
+        // Blame the token the value is in, at the item that was rejected
+        char* token = inline_value ? option : value;
+        error->index
+          = inline_value ? option_index : cursor_index(&cursor, argv);
+        error->offset = error->value ? (size_t)(error->value - token) : 0;
+        error->arg = clap_arg;
+        return false;
+      }
+
+      if (!inline_value && !cursor_advance(&cursor, error)) {
+        error->index = cursor_index(&cursor, argv);
+        return false;
+      }
+    } else {
+      bool* storage;
+      if (result) {
+        storage = &result->values[index].boolean;
+      } else {
+        use_allocator(clap_arg, allocator);
+        storage = value_storage(clap_arg, sizeof(bool));
+      }
+      if (storage == NULL) {
+        *error = (s_clapc_error) { .code = CLAPC_ERROR_OUT_OF_MEMORY };
+        return false;
+      }
+
+      if (inline_value) {
+        if (!parse_bool(inline_value, storage)) {
+          *error = (s_clapc_error) {
+            .code = CLAPC_ERROR_INVALID_VALUE,
+            .index = option_index,
+            .offset = (size_t)(inline_value - option),
+            .option = option,
+            .value = inline_value,
+            .value_len = strlen(inline_value),
+            .arg = clap_arg,
+          };
+          return false;
+        }
+      } else if (*cursor.pos && parse_bool(*cursor.pos, storage)) {
+        // If we are parsing a boolean argument, consume the next arg if it is
+        // either "true" or "false"
+        if (!cursor_advance(&cursor, error)) {
+          error->index = cursor_index(&cursor, argv);
+          return false;
+        }
+      } else {
+        *storage = true;
+      }
+    }
+
+    arg = *cursor.pos;
+  }
+
+  char** remaining = cursor_remaining(&cursor, error);
+  if (remaining == NULL) {
+    return false;
+  }
+
+  *argv_ptr = remaining;
+  return true;
+}
+
+/**
+ * Whether parsing reports `arg` as missing if it wasn't given. If `env` is
+ * true, the arguments may still be set from the environment by {@link
+ * clapc_parse_env}, which checks the required arguments with a variable itself.
+ */
+static bool checks_required(const s_clap_arg* arg, bool env)
+{
+  return arg->required && !(env && arg->env != NULL);
+}
+
+/**
+ * Check the compiled constraints of `spec` against the arguments that were
+ * given. Each check is a few operations per word of the bitsets. See {@link
+ * checks_required} for `env`.
+ */
+static bool check_constraints(
+  const s_clapc_spec* spec, const uint64_t* present, bool env,
+  s_clapc_error* error)
+{
+  if (spec->constraints == NULL) {
+    return true;
+  }
+
+  size_t words = spec->words;
+  const uint64_t* required = spec->constraints;
+  const uint64_t* conflicts = required + words;
+  const uint64_t* depends = conflicts + spec->count * words;
+  const uint64_t* groups = depends + spec->count * words;
+
+  for (size_t w = 0; w < words; w++) {
+    for (uint64_t missing = required[w] & ~present[w]; missing != 0;
+      missing &= missing - 1) {
+      s_clap_arg* arg = spec->args[w * 64 + (size_t)__builtin_ctzll(missing)];
+      if (checks_required(arg, env)) {
+        *error = (s_clapc_error) {
+          .code = CLAPC_ERROR_MISSING_REQUIRED,
+          .arg = arg,
+        };
+        return false;
+      }
+    }
+  }
+
+  // Only the arguments that were given can conflict or depend on others
+  for (size_t w = 0; w < words; w++) {
+    for (uint64_t bits = present[w]; bits != 0; bits &= bits - 1) {
+      size_t i = w * 64 + (size_t)__builtin_ctzll(bits);
+      s_clap_arg* arg = spec->args[i];
+
+      for (size_t v = 0; v < words; v++) {
+        uint64_t clash = conflicts[i * words + v] & present[v];
+        uint64_t needed = depends[i * words + v] & ~present[v];
+        if (clash != 0) {
+          *error = (s_clapc_error) {
+            .code = CLAPC_ERROR_CONFLICT,
+            .arg = arg,
+            .other = spec->args[v * 64 + (size_t)__builtin_ctzll(clash)],
+          };
+          return false;
+        }
+        if (needed != 0) {
+          *error = (s_clapc_error) {
+            .code = CLAPC_ERROR_MISSING_DEPENDENCY,
+            .arg = arg,
+            .other = spec->args[v * 64 + (size_t)__builtin_ctzll(needed)],
+          };
+          return false;
+        }
+      }
+    }
+  }
+
+  for (size_t g = 0; g < spec->group_count; g++) {
+    s_clap_arg* first = NULL;
+    for (size_t v = 0; v < words; v++) {
+      uint64_t given = groups[g * words + v] & present[v];
+      for (; given != 0; given &= given - 1) {
+        s_clap_arg* arg = spec->args[v * 64 + (size_t)__builtin_ctzll(given)];
+        if (first == NULL) {
+          first = arg;
+          continue;
+        }
+        *error = (s_clapc_error) {
+          .code = CLAPC_ERROR_CONFLICT,
+          .arg = first,
+          .other = arg,
+        };
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Check the constraints of `args` against the arguments that were given,
+ * without a compiled spec. Like looking up arguments without a spec, this scans
+ * `args` for every name. See {@link checks_required} for `env`.
+ */
+static bool check_args(
+  s_clap_arg* args[], const uint64_t* present, bool env, s_clapc_error* error)
+{
+  for (size_t i = 0; args[i] != NULL; i++) {
+    s_clap_arg* arg = args[i];
+
+    if (!bit_get(present, i)) {
+      if (checks_required(arg, env)) {
+        *error = (s_clapc_error) {
+          .code = CLAPC_ERROR_MISSING_REQUIRED,
+          .arg = arg,
+        };
+        return false;
+      }
+      continue;
+    }
+
+    for (int kind = 0; kind < 2; kind++) {
+      const char* const* names
+        = kind == 0 ? arg->conflicts_with : arg->depends_on;
+      for (; names && *names; names++) {
+        size_t index;
+        s_clap_arg* other
+          = find_long(NULL, args, *names, strlen(*names), &index);
+        if (other == NULL) {
+          *error = (s_clapc_error) {
+            .code = CLAPC_ERROR_UNKNOWN_CONSTRAINT,
+            .value = *names,
+            .value_len = strlen(*names),
+            .arg = arg,
+          };
+          return false;
+        }
+        if (kind == 0 ? bit_get(present, index) : !bit_get(present, index)) {
+          *error = (s_clapc_error) {
+            .code = kind == 0 ? CLAPC_ERROR_CONFLICT
+                              : CLAPC_ERROR_MISSING_DEPENDENCY,
+            .arg = arg,
+            .other = other,
+          };
+          return false;
+        }
+      }
+    }
+
+    for (size_t j = i + 1; arg->group && args[j] != NULL; j++) {
+      if (bit_get(present, j) && args[j]->group
+        && strcmp(args[j]->group, arg->group) == 0) {
+        *error = (s_clapc_error) {
+          .code = CLAPC_ERROR_CONFLICT,
+          .arg = arg,
+          .other = args[j],
+        };
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+/**
+ * How many words of presence bits {@link parse_args} keeps on the stack. Specs
+ * with more arguments than this many words can hold use the heap.
+ */
+#define LOCAL_PRESENT_WORDS 4
+
+/**
+ * Parse `argv_ptr` against `args`, then check the constraints between them. If
+ * `spec` is not NULL, its lookup tables and compiled constraints are used
+ * instead of scanning `args`. If `result` is not NULL, values are stored in it
+ * and `args` are left untouched. Otherwise, values are allocated from
+ * `allocator`. Response files are kept in `files`, or not expanded if it is
+ * NULL. If `dashes` is not NULL, it is set to whether parsing stopped because
+ * of "--".
+ */
+static bool parse_args(const s_clapc_spec* spec, s_clap_arg* args[],
+  s_clapc_result* result, const s_clapc_allocator* allocator,
+  char*** argv_ptr, s_response_file** files, bool* dashes,
+  s_clapc_error* error)
+{
+  *error = (s_clapc_error) { 0 };
+
+  size_t count = 0;
+  if (spec) {
+    count = spec->count;
+  } else {
+    while (args[count] != NULL) {
+      count++;
+    }
+  }
+
+  // An arena may have been reset since the last parse, taking its values,
+  // whatever this parse allocates from
+  if (!result) {
+    for (size_t i = 0; i < count; i++) {
+      forget_arena_value(args[i]);
+    }
+  }
+
+  // Which arguments were given, for constraints and duplicates
+  uint64_t local_present[LOCAL_PRESENT_WORDS] = { 0 };
+  uint64_t* present = local_present;
+  size_t present_size = present_words(count) * sizeof(uint64_t);
+  if (result) {
+    present = result->present;
+  } else if (present_words(count) > LOCAL_PRESENT_WORDS) {
+    present = mem_alloc(allocator, present_size);
+    STATS_ADD(allocations, 1);
+    if (present == NULL) {
+      *error = (s_clapc_error) { .code = CLAPC_ERROR_OUT_OF_MEMORY };
+      return false;
+    }
+    memset(present, 0, present_size);
+  }
+
+  bool ok = parse_tokens(spec, args, result, allocator, present, argv_ptr,
+    files, dashes, error);
+  if (ok) {
+    STATS_TIMER_START(timer);
+    // Values parsed into the arguments may still come from the environment,
+    // but those parsed into a result can't
+    bool env = result == NULL;
+    ok = spec ? check_constraints(spec, present, env, error)
+              : check_args(args, present, env, error);
+    STATS_TIMER_STOP(timer, validate_ns);
+  }
+
+  if (present != local_present && !result) {
+    mem_free(allocator, present, present_size);
+  }
+  return ok;
+}
+
+bool clapc_parse_checked(
+  s_clap_arg* args[], char*** argv_ptr, s_clapc_error* error)
+{
+  return clapc_parse_with_allocator(args, argv_ptr, NULL, error);
+}
+
+bool clapc_parse_with_allocator(s_clap_arg* args[], char*** argv_ptr,
+  const s_clapc_allocator* allocator, s_clapc_error* error)
+{
+  STATS_ADD(parses, 1);
+  bool ok = parse_args(
+    NULL, args, NULL, allocator, argv_ptr, args_files(args), NULL, error);
+  STATS_ADD(failures, !ok);
+  return ok;
+}
+
+bool clapc_parse_safe(s_clap_arg* args[], char*** argv_ptr, char** error)
+{
+  s_clapc_error failure;
+  bool ok = clapc_parse_checked(args, argv_ptr, &failure);
+  *error = ok ? NULL : error_string(&failure);
+  return ok;
+}
+
+bool clapc_spec_parse_checked(
+  const s_clapc_spec* spec, char*** argv_ptr, s_clapc_error* error)
+{
+  return clapc_spec_parse_with_allocator(spec, argv_ptr, NULL, error);
+}
+
+bool clapc_spec_parse_with_allocator(const s_clapc_spec* spec,
+  char*** argv_ptr, const s_clapc_allocator* allocator, s_clapc_error* error)
+{
+  STATS_ADD(parses, 1);
+  bool ok = parse_args(spec, spec->args, NULL, allocator, argv_ptr,
+    args_files(spec->args), NULL, error);
+  STATS_ADD(failures, !ok);
+  return ok;
+}
+
+bool clapc_spec_parse(
+  const s_clapc_spec* spec, char*** argv_ptr, char** error)
+{
+  s_clapc_error failure;
+  bool ok = clapc_spec_parse_checked(spec, argv_ptr, &failure);
+  *error = ok ? NULL : error_string(&failure);
+  return ok;
+}
+
+// Results =====================================================================
+
+/**
+ * The program name in front of the tokens of {@link clapc_spec_parse_string}.
+ */
+static char string_program_name[] = "";
+
+size_t clapc_result_size(const s_clapc_spec* spec)
+{
+  size_t size = spec->count * sizeof(s_clap_value)
+    + present_words(spec->count) * sizeof(uint64_t);
+  // Round up to whole cache lines, so that results laid out next to each other
+  // never share one
+  return (size + CLAPC_CACHE_LINE - 1) & ~(size_t)(CLAPC_CACHE_LINE - 1);
+}
+
+void clapc_result_init(
+  s_clapc_result* result, const s_clapc_spec* spec, void* memory)
+{
+  memset(memory, 0, clapc_result_size(spec));
+  *result = (s_clapc_result) {
+    .spec = spec,
+    .count = spec->count,
+    .values = memory,
+    .present = (uint64_t*)((s_clap_value*)memory + spec->count),
+  };
+}
+
+/**
+ * Forget the values of `result`, but keep the buffers of its lists, so that
+ * parsing into the same result again doesn't allocate. Buffers from an arena
+ * are dropped, since it may have been reset since. The response files it
+ * loaded are released.
+ */
+static void reset_result(s_clapc_result* result)
+{
+  bool keep_lists = !is_arena(result->allocator);
+  for (size_t i = 0; i < result->count; i++) {
+    if (is_list_type(result->spec->args[i]->type) && keep_lists) {
+      result->values[i].list.count = 0;
+    } else {
+      result->values[i] = (s_clap_value) { 0 };
+    }
+  }
+  memset(result->present, 0, present_words(result->count) * sizeof(uint64_t));
+  free_response_files(result->files);
+  result->files = NULL;
+}
+
+/**
+ * Parse `argv_ptr` into `result`. "@path" tokens are only expanded if
+ * `response_files` is true.
+ */
+static bool parse_result(const s_clapc_spec* spec, s_clapc_result* result,
+  char*** argv_ptr, bool response_files, s_clapc_error* error)
+{
+  assert(result->spec == spec);
+  reset_result(result);
+
+  STATS_ADD(parses, 1);
+  bool ok = parse_args(spec, spec->args, result, NULL, argv_ptr,
+    response_files ? &result->files : NULL, NULL, error);
+  STATS_ADD(failures, !ok);
+  return ok;
+}
+
+bool clapc_spec_parse_result_checked(const s_clapc_spec* spec,
+  s_clapc_result* result, char*** argv_ptr, s_clapc_error* error)
+{
+  return parse_result(spec, result, argv_ptr, true, error);
+}
+
+bool clapc_spec_parse_result(const s_clapc_spec* spec, s_clapc_result* result,
+  char*** argv_ptr, char** error)
+{
+  s_clapc_error failure;
+  bool ok = clapc_spec_parse_result_checked(spec, result, argv_ptr, &failure);
+  *error = ok ? NULL : error_string(&failure);
+  return ok;
+}
+
+bool clapc_spec_parse_string(const s_clapc_spec* spec, s_clapc_result* result,
+  char* buffer, size_t len, char*** argv_ptr, size_t capacity, char** error)
+{
+  assert(result->spec == spec);
+  assert(capacity > 0);
+  reset_result(result);
+
+  char** argv = *argv_ptr;
+  size_t count;
+  argv[0] = string_program_name;
+  if (!clapc_tokenize(buffer, len, argv + 1, capacity - 1, &count, error)) {
+    return false;
+  }
+
+  STATS_ADD(parses, 1);
+  // Strings usually come from elsewhere than the command line, so they can't
+  // name response files
+  s_clapc_error failure;
+  bool ok = parse_args(
+    spec, spec->args, result, NULL, argv_ptr, NULL, NULL, &failure);
+  STATS_ADD(failures, !ok);
+  *error = ok ? NULL : error_string(&failure);
+  return ok;
+}
+
+void clapc_result_free(s_clapc_result* result)
+{
+  for (size_t i = 0; i < result->count; i++) {
+    e_clap_arg_type type = result->spec->args[i]->type;
+    if (is_list_type(type)) {
+      s_clap_list* list = &result->values[i].list;
+      mem_free(result->allocator, list->items,
+        list->capacity * list_item_size(type));
+      *list = (s_clap_list) { 0 };
+    }
+  }
+  free_response_files(result->files);
+  result->files = NULL;
+}
+
+// Batches =====================================================================
+
+/**
+ * How many lines a batch hands out at once. This matches the words of the
+ * presence bitsets, so that no two threads ever write to the same word.
+ */
+#define BATCH_BLOCK 64
+
+/**
+ * A range of blocks packed in one word, so that it can be shrunk from either
+ * end with a single compare-and-swap.
+ */
+#define BATCH_RANGE(begin, end) (((uint64_t)(begin) << 32) | (uint32_t)(end))
+
+/**
+ * What the threads of a batch share.
+ */
+typedef struct {
+  const s_clapc_spec* spec;
+  s_clapc_batch* batch;
+  struct batch_worker* workers;
+  size_t worker_count;
+  /**
+   * The command lines of {@link clapc_parse_batch}, or NULL.
+   */
+  char*** argvs;
+  /**
+   * The buffer of {@link clapc_parse_batch_lines}, and where each of its lines
+   * starts (plus where a line after the last one would).
+   */
+  char* buffer;
+  size_t* starts;
+} s_batch_job;
+
+/**
+ * A thread of a batch. Each is on its own cache line, since the ranges are
+ * written to all the time.
+ */
+typedef struct batch_worker {
+  alignas(CLAPC_CACHE_LINE) uint64_t range;
+  s_batch_job* job;
+  size_t id;
+  s_clapc_result result;
+  size_t error_count;
+  pthread_t thread;
+  bool started;
+} s_batch_worker;
+
+/**
+ * Take the first block of `range`.
+ */
+static bool range_pop(uint64_t* range, size_t* block)
+{
+  uint64_t old = __atomic_load_n(range, __ATOMIC_RELAXED);
+  for (;;) {
+    uint32_t begin = (uint32_t)(old >> 32);
+    uint32_t end = (uint32_t)old;
+    if (begin == end) {
+      return false;
+    }
+    if (__atomic_compare_exchange_n(range, &old, BATCH_RANGE(begin + 1, end),
+          true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      *block = begin;
+      return true;
+    }
+  }
+}
+
+/**
+ * Move the second half of `victim` (rounded up) to `range`, which is empty.
+ */
+static bool range_steal(uint64_t* victim, uint64_t* range)
+{
+  uint64_t old = __atomic_load_n(victim, __ATOMIC_RELAXED);
+  for (;;) {
+    uint32_t begin = (uint32_t)(old >> 32);
+    uint32_t end = (uint32_t)old;
+    if (begin == end) {
+      return false;
+    }
+    uint32_t middle = end - (end - begin + 1) / 2;
+    if (__atomic_compare_exchange_n(victim, &old, BATCH_RANGE(begin, middle),
+          true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      __atomic_store_n(range, BATCH_RANGE(middle, end), __ATOMIC_RELEASE);
+      return true;
+    }
+  }
+}
+
+static char batch_program_name[] = "";
+
+/**
+ * Split line `line` of the buffer of `job` into its slots of the token table.
+ * These are sized for the most tokens a line of its length can have, plus the
+ * program name and the null-terminator.
+ */
+static char** tokenize_line(s_batch_job* job, size_t line, char** error)
+{
+  size_t start = job->starts[line];
+  char* read = job->buffer + start;
+  // Lines end at the newline, which is replaced by a null-terminator
+  char* end = job->buffer + job->starts[line + 1] - 1;
+
+  char** argv = job->batch->tokens + start / 2 + 3 * line;
+  size_t count = 0;
+  argv[count++] = batch_program_name;
+
+  for (;;) {
+    char* token;
+    if (!next_token(&read, end, &token)) {
+      asprintf(error, "Unterminated quote in line %zu\n", line + 1);
+      return NULL;
+    }
+    if (token == NULL) {
+      break;
+    }
+    argv[count++] = token;
+  }
+
+  argv[count] = NULL;
+  return argv;
+}
+
+static void parse_batch_line(s_batch_worker* worker, size_t line)
+{
+  s_batch_job* job = worker->job;
+  s_clapc_batch* batch = job->batch;
+  s_clapc_result* result = &worker->result;
+  char* error = NULL;
+
+  char** argv
+    = job->argvs ? job->argvs[line] : tokenize_line(job, line, &error);
+  // Each thread parses every one of its lines into the same result, which
+  // would release the response files of a line while its rest still points
+  // into them. Lines of a buffer may also not come from the user running the
+  // program, so "@path" tokens are never expanded in batches.
+  s_clapc_error failure;
+  if (argv != NULL
+    && !parse_result(job->spec, result, &argv, false, &failure)) {
+    error = error_string(&failure);
+    argv = NULL;
+  }
+  if (argv == NULL) {
+    batch->errors[line] = error;
+    worker->error_count++;
+    return;
+  }
+
+  for (size_t i = 0; i < result->count; i++) {
+    if (!clapc_result_has(result, i)) {
+      continue;
+    }
+    batch->columns[i][line] = result->values[i];
+    batch->present[i][line / 64] |= UINT64_C(1) << (line % 64);
+    // The column owns the items of lists now
+    if (is_list_type(job->spec->args[i]->type)) {
+      result->values[i].list = (s_clap_list) { 0 };
+    }
+  }
+  batch->rest[line] = argv;
+}
+
+static void* batch_worker_run(void* data)
+{
+  s_batch_worker* worker = data;
+  s_batch_job* job = worker->job;
+  size_t count = job->batch->count;
+  size_t block;
+
+  for (;;) {
+    while (range_pop(&worker->range, &block)) {
+      size_t end = (block + 1) * BATCH_BLOCK;
+      for (size_t line = block * BATCH_BLOCK; line < end && line < count;
+        line++) {
+        parse_batch_line(worker, line);
+      }
+    }
+
+    // Out of blocks: steal from the others, starting with the next one. Blocks
+    // are never added, so once everyone is out, we are done.
+    bool stole = false;
+    for (size_t i = 1; i < job->worker_count && !stole; i++) {
+      s_batch_worker* victim
+        = &job->workers[(worker->id + i) % job->worker_count];
+      stole = range_steal(&victim->range, &worker->range);
+    }
+    if (!stole) {
+      return NULL;
+    }
+  }
+}
+
+/**
+ * Allocate the columns of `batch` and parse every line of `job` on up to
+ * `threads` threads.
+ */
+static bool run_batch(s_batch_job* job, size_t threads, char** error)
+{
+  s_clapc_batch* batch = job->batch;
+  const s_clapc_spec* spec = job->spec;
+  size_t count = batch->count;
+  size_t blocks = (count + BATCH_BLOCK - 1) / BATCH_BLOCK;
+
+  if (blocks > UINT32_MAX) {
+    asprintf(error, "Too many lines in batch\n");
+    return false;
+  }
+
+  if (threads == 0) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cores > 0 ? (size_t)cores : 1;
+  }
+  if (threads > blocks) {
+    threads = blocks > 0 ? blocks : 1;
+  }
+
+  // The pointers to the columns are followed by the columns themselves, and
+  // the pointers to the bitsets by the bitsets
+  size_t words = present_words(count);
+  batch->columns = calloc(1,
+    sizeof(s_clap_value*)
+      + spec->count * (sizeof(s_clap_value*) + count * sizeof(s_clap_value)));
+  batch->present = calloc(1,
+    sizeof(uint64_t*)
+      + spec->count * (sizeof(uint64_t*) + words * sizeof(uint64_t)));
+  batch->rest = calloc(count + 1, sizeof(char**));
+  batch->errors = calloc(count + 1, sizeof(char*));
+  size_t result_size = clapc_result_size(spec);
+  char* memory = aligned_alloc(CLAPC_CACHE_LINE, threads * result_size);
+  s_batch_worker* workers
+    = aligned_alloc(CLAPC_CACHE_LINE, threads * sizeof(s_batch_worker));
+  STATS_ADD(allocations, 6);
+  if (!batch->columns || !batch->present || !batch->rest || !batch->errors
+    || !memory || !workers) {
+    free(memory);
+    free(workers);
+    asprintf(error, "Out of memory\n");
+    return false;
+  }
+
+  s_clap_value* values = (s_clap_value*)(batch->columns + spec->count);
+  uint64_t* bits = (uint64_t*)(batch->present + spec->count);
+  for (size_t i = 0; i < spec->count; i++) {
+    batch->columns[i] = values + i * count;
+    batch->present[i] = bits + i * words;
+  }
+
+  job->workers = workers;
+  job->worker_count = threads;
+  for (size_t i = 0; i < threads; i++) {
+    workers[i] = (s_batch_worker) {
+      .range = BATCH_RANGE(blocks * i / threads, blocks * (i + 1) / threads),
+      .job = job,
+      .id = i,
+    };
+    clapc_result_init(&workers[i].result, spec, memory + i * result_size);
+  }
+
+  // The calling thread is the first worker. If a thread can't be started, its
+  // blocks are stolen by the others.
+  for (size_t i = 1; i < threads; i++) {
+    int status = pthread_create(
+      &workers[i].thread, NULL, batch_worker_run, &workers[i]);
+    workers[i].started = status == 0;
+  }
+  batch_worker_run(&workers[0]);
+
+  for (size_t i = 0; i < threads; i++) {
+    if (workers[i].started) {
+      pthread_join(workers[i].thread, NULL);
+    }
+    batch->error_count += workers[i].error_count;
+    clapc_result_free(&workers[i].result);
+  }
+
+  free(memory);
+  free(workers);
+  return true;
+}
+
+bool clapc_parse_batch(const s_clapc_spec* spec, char** argvs[], size_t count,
+  size_t threads, s_clapc_batch* batch, char** error)
+{
+  *error = NULL;
+  *batch = (s_clapc_batch) { .spec = spec, .count = count };
+
+  s_batch_job job = {
+    .spec = spec,
+    .batch = batch,
+    .argvs = argvs,
+  };
+  return run_batch(&job, threads, error);
+}
+
+bool clapc_parse_batch_lines(const s_clapc_spec* spec, char* buffer,
+  size_t len, size_t threads, s_clapc_batch* batch, char** error)
+{
+  *error = NULL;
+  *batch = (s_clapc_batch) { .spec = spec };
+
+  // A newline at the very end doesn't start another line
+  size_t count = 0;
+  for (char* line = buffer; line < buffer + len; count++) {
+    char* newline = memchr(line, '\n', (size_t)(buffer + len - line));
+    line = newline ? newline + 1 : buffer + len;
+  }
+  batch->count = count;
+
+  size_t* starts = malloc((count + 1) * sizeof(size_t));
+  // A line of n bytes has at most (n + 1) / 2 tokens
+  batch->tokens = malloc((len / 2 + 3 * count + 1) * sizeof(char*));
+  STATS_ADD(allocations, 2);
+  if (starts == NULL || batch->tokens == NULL) {
+    free(starts);
+    asprintf(error, "Out of memory\n");
+    return false;
+  }
+
+  size_t line = 0;
+  for (char* read = buffer; read < buffer + len; line++) {
+    starts[line] = (size_t)(read - buffer);
+    char* newline = memchr(read, '\n', (size_t)(buffer + len - read));
+    read = newline ? newline + 1 : buffer + len;
+  }
+  // As if the last line ended with a newline, which is `buffer[len]`
+  starts[count] = count > 0 && buffer[len - 1] == '\n' ? len : len + 1;
+
+  s_batch_job job = {
+    .spec = spec,
+    .batch = batch,
+    .buffer = buffer,
+    .starts = starts,
+  };
+  bool ok = run_batch(&job, threads, error);
+  free(starts);
+  return ok;
+}
+
+void clapc_batch_free(s_clapc_batch* batch)
+{
+  for (size_t i = 0; batch->columns && i < batch->spec->count; i++) {
+    if (!is_list_type(batch->spec->args[i]->type)) {
+      continue;
+    }
+    for (size_t line = 0; line < batch->count; line++) {
+      free(batch->columns[i][line].list.items);
+    }
+  }
+  if (batch->errors) {
+    for (size_t line = 0; line < batch->count; line++) {
+      free(batch->errors[line]);
+    }
+  }
+
+  free(batch->columns);
+  free(batch->present);
+  free(batch->rest);
+  free(batch->errors);
+  free(batch->tokens);
+  *batch = (s_clapc_batch) { 0 };
+}
+
+// Environment =================================================================
+
+/**
+ * Index the long names of `args` (or their environment variable names, if
+ * `env` is true) in a temporary hash table. The indices in the slots are one
+ * plus the index of the argument in `args`.
+ *
+ * @return The slots of the table, which should be freed by the caller, or NULL
+ * if the table couldn't be allocated (`error` is set) or there is nothing to
+ * index (`error` is left NULL).
+ */
+static s_long_slot* index_args(
+  s_clap_arg* args[], bool env, size_t* mask_ptr, char** error)
+{
+  size_t count = 0;
+  for (int i = 0; args[i] != NULL; i++) {
+    if (env ? args[i]->env != NULL : args[i]->name != NULL) {
+      count++;
+    }
+  }
+  if (count == 0) {
+    return NULL;
+  }
+
+  size_t capacity = index_capacity(count);
+  s_long_slot* slots = calloc(capacity, sizeof(s_long_slot));
+  STATS_ADD(allocations, 1);
+  if (slots == NULL) {
+    asprintf(error, "Out of memory\n");
+    return NULL;
+  }
+
+  for (size_t i = 0; args[i] != NULL; i++) {
+    const char* name = env ? args[i]->env : args[i]->name;
+    if (name) {
+      index_insert(slots, capacity - 1, hash_name(name, strlen(name)), i);
+    }
+  }
+
+  *mask_ptr = capacity - 1;
+  return slots;
+}
+
+bool clapc_parse_env(s_clap_arg* args[], char** envp, char** error)
+{
+  *error = NULL;
+
+  // Index the declared names, so that each variable is looked up in O(1)
+  size_t mask;
+  s_long_slot* slots = index_args(args, true, &mask, error);
+  if (slots == NULL) {
+    return *error == NULL;
+  }
+
+  bool ok = true;
+
+  for (char** var = envp ? envp : environ; ok && *var != NULL; var++) {
+    char* equals = strchr(*var, '=');
+    if (equals == NULL) {
+      continue;
+    }
+
+    size_t len = (size_t)(equals - *var);
+    uint32_t hash = hash_name(*var, len);
+
+    // Several arguments may share a variable, so every match is set. Arguments
+    // that already have a value were either given on the command line or set
+    // by an earlier variable of the same name, which is what getenv would
+    // return.
+    for (size_t i = hash & mask; slots[i].index != 0; i = (i + 1) & mask) {
+      STATS_ADD(lookup_probes, 1);
+      s_clap_arg* arg = args[slots[i].index - 1];
+      if (slots[i].hash != hash || arg->value != NULL
+        || !name_equals(arg->env, *var, len)) {
+        continue;
+      }
+      s_clapc_error failure;
+      if (!store_value(NULL, slots[i].index - 1, arg, equals + 1, NULL,
+            arg->env, &failure)) {
+        *error = error_string(&failure);
+        ok = false;
+        break;
+      }
+    }
+  }
+
+  // Required arguments with a variable may be given in either place, so they
+  // are only missing now
+  for (size_t i = 0; ok && args[i] != NULL; i++) {
+    s_clap_arg* arg = args[i];
+    if (arg->required && arg->env != NULL && arg->value == NULL) {
+      asprintf(error,
+        "Missing required argument '" OPTION_FORMAT "' (or variable '%s')\n",
+        OPTION_ARGS(arg), arg->env);
+      ok = false;
+    }
+  }
+
+  free(slots);
+  return ok;
+}
+
+// Config files ================================================================
+
+static bool is_blank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+/**
+ * Whether `name` is `section` (if not empty), a dot and `key`.
+ */
+static bool dotted_name_equals(const char* name, const char* section,
+  size_t section_len, const char* key, size_t key_len)
+{
+  if (section_len > 0) {
+    if (strncmp(name, section, section_len) != 0 || name[section_len] != '.') {
+      return false;
+    }
+    name += section_len + 1;
+  }
+  return name_equals(name, key, key_len);
+}
+
+bool clapc_parse_config(s_clap_arg* args[], const char* path, char** error)
+{
+  *error = NULL;
+
+  size_t size;
+  size_t map_len;
+  bool opened;
+  char* map = map_file(path, &size, &map_len, &opened);
+  if (map == NULL) {
+    asprintf(error, "Unable to %s config file '%s'\n", opened ? "map" : "open",
+      path);
+    return false;
+  }
+
+  // Values borrowed from the file point into the mapping, so it's kept with
+  // the response files of the arguments. Without arguments, nothing can
+  // borrow from it.
+  s_response_file* file = calloc(1, sizeof(*file));
+  STATS_ADD(allocations, 1);
+  if (file == NULL) {
+    munmap(map, map_len);
+    asprintf(error, "Out of memory\n");
+    return false;
+  }
+  file->map = map;
+  file->map_len = map_len;
+  s_response_file* unowned = NULL;
+  keep_response_file(args[0] ? &args[0]->files : &unowned, file);
+
+  size_t mask = 0;
+  s_long_slot* slots = index_args(args, false, &mask, error);
+  if (slots == NULL && *error != NULL) {
+    free_response_files(unowned);
+    return false;
+  }
+
+  // Arguments that already have a value (from the command line or the
+  // environment) take precedence over the file
+  size_t count = 0;
+  while (args[count] != NULL) {
+    count++;
+  }
+  bool* given = malloc(count + 1);
+  STATS_ADD(allocations, 1);
+  if (given == NULL) {
+    free(slots);
+    free_response_files(unowned);
+    asprintf(error, "Out of memory\n");
+    return false;
+  }
+  for (size_t i = 0; i < count; i++) {
+    given[i] = args[i]->value != NULL;
+  }
+
+  const char* section = NULL;
+  size_t section_len = 0;
+  size_t line_number = 0;
+  char* line = map;
+  char* end = map + size;
+  bool ok = true;
+
+  for (; ok && line < end; line_number++) {
+    char* eol = memchr(line, '\n', (size_t)(end - line));
+    if (eol == NULL) {
+      eol = end;
+    }
+    char* next = eol + 1;
+
+    while (line < eol && is_blank(*line)) {
+      line++;
+    }
+    while (eol > line && is_blank(eol[-1])) {
+      eol--;
+    }
+
+    if (line == eol || *line == '#' || *line == ';') {
+      line = next;
+      continue;
+    }
+
+    // "[section]" makes "key" in the lines that follow stand for
+    // "section.key"
+    if (*line == '[') {
+      if (eol[-1] != ']') {
+        asprintf(error, "Invalid line %zu in config file '%s'\n",
+          line_number + 1, path);
+        ok = false;
+        break;
+      }
+      section = line + 1;
+      section_len = (size_t)(eol - line - 2);
+      line = next;
+      continue;
+    }
+
+    char* equals = memchr(line, '=', (size_t)(eol - line));
+    char* key_end = equals ? equals : line;
+    while (key_end > line && is_blank(key_end[-1])) {
+      key_end--;
+    }
+    if (key_end == line) {
+      asprintf(error, "Invalid line %zu in config file '%s'\n",
+        line_number + 1, path);
+      ok = false;
+      break;
+    }
+
+    char* value = equals + 1;
+    while (value < eol && is_blank(*value)) {
+      value++;
+    }
+    if (eol - value >= 2 && *value == '"' && eol[-1] == '"') {
+      value++;
+      eol--;
+    }
+
+    // Both of these overwrite bytes that were already looked at: either the
+    // "=", a quote, a blank, the newline or the byte past the end of the file
+    size_t key_len = (size_t)(key_end - line);
+    *key_end = '\0';
+    *eol = '\0';
+
+    uint32_t hash = FNV_OFFSET_BASIS;
+    if (section_len > 0) {
+      hash = hash_update(hash_update(hash, section, section_len), ".", 1);
+    }
+    hash = hash_update(hash, line, key_len);
+
+    s_clap_arg* arg = NULL;
+    size_t index = 0;
+    for (size_t i = hash & mask; slots && slots[i].index != 0;
+      i = (i + 1) & mask) {
+      STATS_ADD(lookup_probes, 1);
+      s_clap_arg* candidate = args[slots[i].index - 1];
+      if (slots[i].hash == hash
+        && dotted_name_equals(
+          candidate->name, section, section_len, line, key_len)) {
+        arg = candidate;
+        index = slots[i].index - 1;
+        break;
+      }
+    }
+
+    if (arg == NULL) {
+      asprintf(error,
+        "Unknown key '%.*s%s%s' on line %zu of config file '%s'\n",
+        (int)section_len, section, section_len > 0 ? "." : "", line,
+        line_number + 1, path);
+      ok = false;
+    } else if (!given[index]) {
+      s_clapc_error failure;
+      ok = store_value(NULL, index, arg, value, NULL, line, &failure);
+      if (!ok) {
+        *error = error_string(&failure);
+      }
+    }
+
+    line = next;
+  }
+
+  free(given);
+  free(slots);
+  free_response_files(unowned);
+  return ok;
+}
+
+// Commands ====================================================================
+
+struct clapc_command_index {
+  size_t mask;
+  s_long_slot slots[];
+};
+
+static s_clap_command* index_find_command(
+  const s_clap_command* command, const char* name, uint32_t hash)
+{
+  const struct clapc_command_index* index = command->index;
+
+  for (size_t i = hash & index->mask;; i = (i + 1) & index->mask) {
+    STATS_ADD(lookup_probes, 1);
+    const s_long_slot* slot = &index->slots[i];
+    if (slot->index == 0) {
+      return NULL;
+    }
+    s_clap_command* candidate = command->commands[slot->index - 1];
+    if (slot->hash == hash && strcmp(candidate->name, name) == 0) {
+      return candidate;
+    }
+  }
+}
+
+/**
+ * Build the lookup table for the names of the subcommands of `command`.
+ */
+static bool build_command_index(s_clap_command* command, char** error)
+{
+  size_t count = 0;
+  while (command->commands[count] != NULL) {
+    count++;
+  }
+
+  if (count >= UINT32_MAX) {
+    asprintf(error, "Too many commands\n");
+    return false;
+  }
+
+  size_t capacity = index_capacity(count);
+  command->index
+    = calloc(1, sizeof(*command->index) + capacity * sizeof(s_long_slot));
+  STATS_ADD(allocations, 1);
+  if (command->index == NULL) {
+    asprintf(error, "Out of memory\n");
+    return false;
+  }
+
+  command->index->mask = capacity - 1;
+
+  for (size_t i = 0; i < count; i++) {
+    const char* name = command->commands[i]->name;
+    uint32_t hash = hash_name(name, strlen(name));
+
+    if (index_find_command(command, name, hash) != NULL) {
+      asprintf(error, "Duplicate command '%s'\n", name);
+      // Don't keep a partially built table around
+      free(command->index);
+      command->index = NULL;
+      return false;
+    }
+
+    index_insert(command->index->slots, command->index->mask, hash, i);
+  }
+
+  return true;
+}
+
+/**
+ * Find the subcommand of `command` called `name`. Returns NULL without setting
+ * `error` if there is no such command.
+ */
+static s_clap_command* find_command(
+  s_clap_command* command, const char* name, char** error)
+{
+  if (command->index == NULL && !build_command_index(command, error)) {
+    return NULL;
+  }
+  return index_find_command(command, name, hash_name(name, strlen(name)));
+}
+
+bool clapc_parse_command(s_clap_command* root, char*** argv_ptr,
+  s_clap_command** command_ptr, char** error)
+{
+  static s_clap_arg* no_args[] = { NULL };
+
+  *error = NULL;
+
+  s_clap_command* command = root;
+  char** argv = *argv_ptr;
+
+  for (;;) {
+    if (command->spec == NULL) {
+      command->spec
+        = clapc_spec_compile(command->args ? command->args : no_args, error);
+      if (command->spec == NULL) {
+        return false;
+      }
+    }
+
+    // The first argument is skipped, whether it's the executable name or the
+    // name of the command. Whatever follows "--" is never a command.
+    bool dashes;
+    s_clapc_error failure;
+    STATS_ADD(parses, 1);
+    bool ok = parse_args(command->spec, command->spec->args, NULL, NULL, &argv,
+      args_files(command->spec->args), &dashes, &failure);
+    STATS_ADD(failures, !ok);
+    if (!ok) {
+      *error = error_string(&failure);
+      return false;
+    }
+
+    if (command->commands == NULL || *argv == NULL || dashes) {
+      break;
+    }
+
+    s_clap_command* subcommand = find_command(command, *argv, error);
+    if (subcommand == NULL) {
+      if (*error == NULL) {
+        asprintf(error, "Unknown command '%s'\n", *argv);
+      }
+      return false;
+    }
+    command = subcommand;
+  }
+
+  *command_ptr = command;
+  *argv_ptr = argv;
+  return true;
+}
+
+void clapc_command_free(s_clap_command* command)
+{
+  if (command->commands) {
+    for (int i = 0; command->commands[i] != NULL; i++) {
+      clapc_command_free(command->commands[i]);
+    }
+  }
+
+  clapc_spec_free(command->spec);
+  free(command->index);
+  command->spec = NULL;
+  command->index = NULL;
+}
+
+void clapc_parse(s_clap_arg* args[], char*** argv_ptr)
+{
+  char* error = NULL;
+  if (!clapc_parse_safe(args, argv_ptr, &error)) {
+    die(1, "%s", error);
+  }
+}
+
+// Unparsing ===================================================================
+
+/**
+ * A command line being written by {@link clapc_unparse}. The text of the
+ * tokens is written from the start of the memory, and the table of tokens
+ * backwards from the end, so that neither has to be measured first. When
+ * `text` is NULL, the command line is only measured.
+ */
+typedef struct {
+  char* text;
+  size_t text_len;
+  /**
+   * Where the table of tokens ends, before its null-terminator.
+   */
+  char** table_end;
+  size_t argc;
+} s_unparse;
+
+static void token_begin(s_unparse* out)
+{
+  out->argc++;
+  if (out->text) {
+    out->table_end[-(ptrdiff_t)out->argc] = out->text + out->text_len;
+  }
+}
+
+static void token_append(s_unparse* out, const char* str, size_t len)
+{
+  if (out->text) {
+    memcpy(out->text + out->text_len, str, len);
+  }
+  out->text_len += len;
+}
+
+static void token_end(s_unparse* out) { token_append(out, "", 1); }
+
+/**
+ * Begin the tokens of an argument that has a value: "--name=" if it has a long
+ * name, or "-n" followed by a new token if it doesn't.
+ */
+static void unparse_option(s_unparse* out, const s_clap_arg* arg)
+{
+  token_begin(out);
+  if (arg->name) {
+    token_append(out, "--", 2);
+    token_append(out, arg->name, strlen(arg->name));
+    token_append(out, "=", 1);
+  } else {
+    token_append(out, (char[]) { '-', arg->short_name }, 2);
+    token_end(out);
+    token_begin(out);
+  }
+}
+
+/**
+ * Write the flag that sets a boolean argument to true.
+ */
+static void unparse_flag(s_unparse* out, const s_clap_arg* arg)
+{
+  token_begin(out);
+  if (arg->name) {
+    token_append(out, "--", 2);
+    token_append(out, arg->name, strlen(arg->name));
+  } else {
+    token_append(out, (char[]) { '-', arg->short_name }, 2);
+  }
+  token_end(out);
+}
+
+/**
+ * Format an integer into `buffer`, which must have room for 21 characters.
+ *
+ * @return The length of the number.
+ */
+static size_t format_integer(char* buffer, bool negative, uint64_t magnitude)
+{
+  char digits[20];
+  size_t count = 0;
+  do {
+    digits[count++] = (char)('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude);
+
+  size_t len = 0;
+  if (negative) {
+    buffer[len++] = '-';
+  }
+  while (count) {
+    buffer[len++] = digits[--count];
+  }
+  return len;
+}
+
+static size_t format_signed(char* buffer, int64_t value)
+{
+  // Negate in unsigned arithmetic so that the minimum value doesn't overflow
+  return format_integer(buffer, value < 0,
+    value < 0 ? 0 - (uint64_t)value : (uint64_t)value);
+}
+
+/**
+ * Format `value` with enough digits to be parsed back to the same float (9) or
+ * double (17), in the "C" locale. `buffer` must have room for 32 characters.
+ *
+ * @return The length of the number.
+ */
+static size_t format_real(char* buffer, double value, int digits)
+{
+  locale_t locale = c_locale();
+  locale_t previous = locale ? uselocale(locale) : (locale_t)0;
+  int len = snprintf(buffer, 32, "%.*g", digits, value);
+  if (locale) {
+    uselocale(previous);
+  }
+  return len > 0 ? (size_t)len : 0;
+}
+
+/**
+ * Write the items of a list value, separated by commas.
+ */
+static void unparse_list(
+  s_unparse* out, e_clap_arg_type type, const s_clap_list* list)
+{
+  char buffer[32];
+  for (size_t i = 0; i < list->count; i++) {
+    if (i > 0) {
+      token_append(out, ",", 1);
+    }
+    switch (type) {
+    case CLAP_ARG_TYPE_INT_LIST:
+      token_append(
+        out, buffer, format_signed(buffer, ((const int*)list->items)[i]));
+      break;
+    case CLAP_ARG_TYPE_FLOAT_LIST:
+      token_append(out, buffer,
+        format_real(buffer, ((const float*)list->items)[i], 9));
+      break;
+    default: {
+      const s_clap_str* item = &((const s_clap_str*)list->items)[i];
+      token_append(out, item->data, item->len);
+      break;
+    }
+    }
+  }
+}
+
+/**
+ * Write the tokens of `arg` and its value, if it has one.
+ *
+ * @return false if the value can't be turned back into text.
+ */
+static bool unparse_arg(s_unparse* out, const s_clap_arg* arg)
+{
+  const void* value = arg->value;
+  if (value == NULL) {
+    return true;
+  }
+
+  char buffer[32];
+  size_t len = 0;
+  switch (arg->type) {
+  case CLAP_ARG_TYPE_BOOL:
+    if (*(const bool*)value) {
+      unparse_flag(out, arg);
+    } else if (arg->name) {
+      // Keep the value, even though it's the same as not giving the argument
+      unparse_option(out, arg);
+      token_append(out, "false", 5);
+      token_end(out);
+    }
+    return true;
+  case CLAP_ARG_TYPE_INT:
+    len = format_signed(buffer, *(const int*)value);
+    break;
+  case CLAP_ARG_TYPE_INT64:
+    len = format_signed(buffer, *(const int64_t*)value);
+    break;
+  case CLAP_ARG_TYPE_UINT64:
+  case CLAP_ARG_TYPE_SIZE:
+    len = format_integer(buffer, false, *(const uint64_t*)value);
+    break;
+  case CLAP_ARG_TYPE_DURATION:
+    len = format_integer(buffer, false, *(const uint64_t*)value);
+    memcpy(buffer + len, "ns", 2);
+    len += 2;
+    break;
+  case CLAP_ARG_TYPE_FLOAT:
+    len = format_real(buffer, *(const float*)value, 9);
+    break;
+  case CLAP_ARG_TYPE_DOUBLE:
+    len = format_real(buffer, *(const double*)value, 17);
+    break;
+  case CLAP_ARG_TYPE_ENUM: {
+    const char* choice = arg->choices[*(const int*)value];
+    unparse_option(out, arg);
+    token_append(out, choice, strlen(choice));
+    token_end(out);
+    return true;
+  }
+  case CLAP_ARG_TYPE_STRING:
+    unparse_option(out, arg);
+    token_append(out, value, arg->value_len);
+    token_end(out);
+    return true;
+  case CLAP_ARG_TYPE_INT_LIST:
+  case CLAP_ARG_TYPE_FLOAT_LIST:
+  case CLAP_ARG_TYPE_STRING_LIST:
+    // An empty list is the same as no list at all
+    if (((const s_clap_list*)value)->count > 0) {
+      unparse_option(out, arg);
+      unparse_list(out, arg->type, value);
+      token_end(out);
+    }
+    return true;
+  case CLAP_ARG_TYPE_CUSTOM:
+    // Only the parse function knows what the value looked like
+    return false;
+  }
+
+  unparse_option(out, arg);
+  token_append(out, buffer, len);
+  token_end(out);
+  return true;
+}
+
+/**
+ * Write the tokens of `args`, with `overrides` applied.
+ *
+ * @return false if the value of an argument can't be turned back into text.
+ */
+static bool unparse(s_unparse* out, const char* program_name,
+  s_clap_arg* args[], const s_clapc_override* overrides,
+  size_t override_count)
+{
+  token_begin(out);
+  token_append(out, program_name, strlen(program_name));
+  token_end(out);
+
+  for (size_t i = 0; args[i] != NULL; i++) {
+    const s_clap_arg* arg = args[i];
+
+    const s_clapc_override* override = NULL;
+    for (size_t j = 0; j < override_count && override == NULL; j++) {
+      if (overrides[j].arg == arg) {
+        override = &overrides[j];
+      }
+    }
+
+    if (override == NULL) {
+      if (!unparse_arg(out, arg)) {
+        return false;
+      }
+    } else if (arg->type == CLAP_ARG_TYPE_BOOL && override->value
+      && strcmp(override->value, "true") == 0) {
+      unparse_flag(out, arg);
+    } else if (override->value) {
+      unparse_option(out, arg);
+      token_append(out, override->value, strlen(override->value));
+      token_end(out);
+    }
+  }
+  return true;
+}
+
+size_t clapc_unparse_size(const char* program_name, s_clap_arg* args[],
+  const s_clapc_override* overrides, size_t override_count)
+{
+  s_unparse out = { 0 };
+  if (!unparse(&out, program_name, args, overrides, override_count)) {
+    return 0;
+  }
+  // The table follows the text, aligned for its pointers
+  size_t text_size
+    = (out.text_len + sizeof(char*) - 1) / sizeof(char*) * sizeof(char*);
+  return text_size + (out.argc + 1) * sizeof(char*);
+}
+
+char** clapc_unparse(const char* program_name, s_clap_arg* args[],
+  const s_clapc_override* overrides, size_t override_count, void* memory,
+  size_t size)
+{
+  s_unparse out = {
+    .text = memory,
+    .table_end = (char**)((char*)memory + size) - 1,
+  };
+  if (!unparse(&out, program_name, args, overrides, override_count)) {
+    return NULL;
+  }
+
+  // The tokens were added to the table from its end, so they are reversed
+  char** argv = out.table_end - out.argc;
+  assert(out.text + out.text_len <= (char*)argv);
+  for (size_t i = 0, j = out.argc - 1; i < j; i++, j--) {
+    char* token = argv[i];
+    argv[i] = argv[j];
+    argv[j] = token;
+  }
+  argv[out.argc] = NULL;
+  return argv;
+}
+
+// Help ========================================================================
+
+/**
+ * Descriptions are wrapped to at least this many columns, even if that makes
+ * them overflow a narrow terminal.
+ */
+#define CLAPC_HELP_MIN_DESCRIPTION_WIDTH 20
+
 /**
- * Print an error message and exit the program.
- * @param status The exit status.
- * @param fmt The format string.
+ * Options longer than this get their description on the next line, so that one
+ * long name doesn't push every description to the right.
  */
-__attribute__((format(printf, 2, 3), noreturn)) static void die(
-  int status, const char* fmt, ...)
+#define CLAPC_HELP_MAX_OPTION_WIDTH 32
+
+/**
+ * A growable output buffer. Once an allocation fails, `data` is NULL and
+ * appending does nothing.
+ */
+typedef struct {
+  char* data;
+  size_t len;
+  size_t capacity;
+  /**
+   * Where `data` comes from, NULL for malloc.
+   */
+  const s_clapc_allocator* allocator;
+} s_buffer;
+
+static void buffer_reserve(s_buffer* buffer, size_t len)
 {
-  va_list args;
-  va_start(args);
-  vfprintf(stderr, fmt, args);
-  va_end(args);
-  exit(status);
+  if (buffer->data == NULL || buffer->len + len <= buffer->capacity) {
+    return;
+  }
+
+  size_t capacity = buffer->capacity * 2;
+  while (capacity < buffer->len + len) {
+    capacity *= 2;
+  }
+
+  char* data
+    = mem_realloc(buffer->allocator, buffer->data, buffer->capacity, capacity);
+  if (data == NULL) {
+    mem_free(buffer->allocator, buffer->data, buffer->capacity);
+  }
+  buffer->data = data;
+  buffer->capacity = capacity;
 }
 
-bool clapc_parse_safe(s_clap_arg* args[], char*** argv_ptr, char** error)
+static void buffer_append(s_buffer* buffer, const char* str, size_t len)
 {
-  *error = NULL;
+  buffer_reserve(buffer, len);
+  if (buffer->data) {
+    memcpy(buffer->data + buffer->len, str, len);
+    buffer->len += len;
+  }
+}
 
-  char** argv =
-    // Skip first argument (it's always the executable name)
-    (*argv_ptr + 1);
-  char* arg = *argv;
+static void buffer_fill(s_buffer* buffer, char c, size_t count)
+{
+  buffer_reserve(buffer, count);
+  if (buffer->data) {
+    memset(buffer->data + buffer->len, c, count);
+    buffer->len += count;
+  }
+}
 
-  while (arg && *arg) {
-    // NOTE: right now we don't support out of order arguments. This means that
-    // no flags can be parsed after the first positional agurment. In the future
-    // we may want to put all positional arguments in a separate array and keep
-    // parsing flags.
-    //
-    // Left-over positional argument.
-    if (*arg != '-') {
-      break;
+static const char* value_placeholder(e_clap_arg_type type)
+{
+  switch (type) {
+  case CLAP_ARG_TYPE_INT:
+    return " <int>";
+  case CLAP_ARG_TYPE_FLOAT:
+    return " <float>";
+  case CLAP_ARG_TYPE_STRING:
+    return " <string>";
+  case CLAP_ARG_TYPE_INT_LIST:
+    return " <int,...>";
+  case CLAP_ARG_TYPE_FLOAT_LIST:
+    return " <float,...>";
+  case CLAP_ARG_TYPE_STRING_LIST:
+    return " <string,...>";
+  case CLAP_ARG_TYPE_INT64:
+    return " <int64>";
+  case CLAP_ARG_TYPE_UINT64:
+    return " <uint64>";
+  case CLAP_ARG_TYPE_DOUBLE:
+    return " <double>";
+  case CLAP_ARG_TYPE_SIZE:
+    return " <size>";
+  case CLAP_ARG_TYPE_DURATION:
+    return " <duration>";
+  case CLAP_ARG_TYPE_CUSTOM:
+    return " <value>";
+  default:
+    return "";
+  }
+}
+
+/**
+ * The width of the placeholder of the value of `arg`. Enums list their
+ * choices, as in " <fast|small>".
+ */
+static size_t placeholder_width(const s_clap_arg* arg)
+{
+  if (arg->type != CLAP_ARG_TYPE_ENUM || arg->choices == NULL
+    || arg->choices[0] == NULL) {
+    return strlen(value_placeholder(arg->type));
+  }
+  size_t width = 2;
+  for (size_t i = 0; arg->choices[i]; i++) {
+    width += strlen(arg->choices[i]) + 1;
+  }
+  return width;
+}
+
+static void append_placeholder(s_buffer* buffer, const s_clap_arg* arg)
+{
+  if (arg->type != CLAP_ARG_TYPE_ENUM || arg->choices == NULL
+    || arg->choices[0] == NULL) {
+    const char* placeholder = value_placeholder(arg->type);
+    buffer_append(buffer, placeholder, strlen(placeholder));
+    return;
+  }
+  for (size_t i = 0; arg->choices[i]; i++) {
+    buffer_append(buffer, i == 0 ? " <" : "|", i == 0 ? 2 : 1);
+    buffer_append(buffer, arg->choices[i], strlen(arg->choices[i]));
+  }
+  buffer_append(buffer, ">", 1);
+}
+
+/**
+ * How many arguments are measured on the stack while formatting help. The
+ * measurements of programs with more arguments than this are allocated.
+ */
+#define CLAPC_HELP_LOCAL_ROWS 64
+
+/**
+ * The measurements of the row of an argument in the help, which are taken once
+ * and then used to both size the options column and lay the row out.
+ */
+typedef struct {
+  size_t name_len;
+  size_t option_width;
+} s_help_row;
+
+/**
+ * The width of the options column for `arg`, e.g. "--jobs, -j <int>", given
+ * the length of its long name.
+ */
+static size_t option_width(const s_clap_arg* arg, size_t name_len)
+{
+  size_t width = placeholder_width(arg);
+  if (arg->name) {
+    width += 2 + name_len;
+  }
+  if (arg->short_name != 0) {
+    // If both a short and long name are present, add ", " between them
+    width += arg->name ? 4 : 2;
+  }
+  return width;
+}
+
+static void append_option(
+  s_buffer* buffer, const s_clap_arg* arg, size_t name_len)
+{
+  if (arg->name) {
+    buffer_append(buffer, "--", 2);
+    buffer_append(buffer, arg->name, name_len);
+  }
+  if (arg->short_name != 0) {
+    if (arg->name) {
+      buffer_append(buffer, ", ", 2);
     }
+    char short_name[2] = { '-', arg->short_name };
+    buffer_append(buffer, short_name, 2);
+  }
+  append_placeholder(buffer, arg);
+}
 
-    bool is_long = false;
+/**
+ * Append `text`, wrapped at word boundaries so that no line is longer than
+ * `width` columns (unless a single word is). Every line but the first one is
+ * indented by `indent` columns, and the text ends with a newline.
+ */
+static void append_wrapped(
+  s_buffer* buffer, const char* text, size_t indent, size_t width)
+{
+  size_t column = 0;
+  const char* p = text;
 
-    if (arg[1] == '-') {
-      // Found "--", skip parsing
-      if (arg[2] == '\0') {
-        argv++;
-        break;
-      }
-      is_long = true;
+  while (*p) {
+    if (*p == '\n') {
+      buffer_append(buffer, "\n", 1);
+      buffer_fill(buffer, ' ', indent);
+      column = 0;
+      p++;
+      continue;
+    }
+    if (*p == ' ') {
+      p++;
+      continue;
     }
 
-    // This is the name of the arg
-    arg = arg + (is_long ? 2 : 1);
+    size_t len = strcspn(p, " \n");
+    if (column > 0 && column + 1 + len > width) {
+      buffer_append(buffer, "\n", 1);
+      buffer_fill(buffer, ' ', indent);
+      column = 0;
+    } else if (column > 0) {
+      buffer_append(buffer, " ", 1);
+      column++;
+    }
 
-    auto clap_arg = ({
-      s_clap_arg* clap_arg = NULL;
-      if (is_long) {
-        for (int i = 0; args[i] != NULL; i++) {
-          if (args[i]->name && strcmp(args[i]->name, arg) == 0) {
-            clap_arg = args[i];
-            break;
-          }
-        }
-      } else {
-        for (int i = 0; args[i] != NULL; i++) {
-          if (args[i]->short_name == *arg) {
-            clap_arg = args[i];
-            break;
-          }
-        }
-      }
-      clap_arg;
-    });
+    buffer_append(buffer, p, len);
+    column += len;
+    p += len;
+  }
 
-    if (clap_arg == NULL) {
-      asprintf(error, "Invalid argument '%s'\n", arg);
+  buffer_append(buffer, "\n", 1);
+}
+
+/**
+ * Write all of `data`, which takes a single write() unless it is interrupted or
+ * `fd` is a pipe or socket that is full.
+ */
+static bool write_all(int fd, const char* data, size_t len)
+{
+  for (size_t written = 0; written < len;) {
+    ssize_t n = write(fd, data + written, len - written);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
       return false;
     }
+    written += (size_t)n;
+  }
+  return true;
+}
 
-    if (clap_arg->type != CLAP_ARG_TYPE_BOOL) {
-      // We need to consume the next arg
-      if (!argv[1]) {
-        asprintf(error, "Missing positional argument for '%s'\n", *argv);
-        return false;
-      }
+/**
+ * The width of the terminal `fd` refers to, or of $COLUMNS, or 80.
+ */
+static size_t terminal_width(int fd)
+{
+  struct winsize size;
+  if (ioctl(fd, TIOCGWINSZ, &size) == 0 && size.ws_col > 0) {
+    return size.ws_col;
+  }
 
-      // TODO: real implementation (parse value according to type)
+  const char* columns = getenv("COLUMNS");
+  int32_t width;
+  if (columns
+    && clapc_parse_number(columns, strlen(columns), CLAPC_NUMBER_INT32, &width)
+      == CLAPC_NUMBER_OK
+    && width > 0) {
+    return (size_t)width;
+  }
 
-      switch (clap_arg->type) {
-      case CLAP_ARG_TYPE_INT: {
-        clap_arg->value = malloc(sizeof(int));
-        long int value = strtol(argv[1], NULL, 10);
-        if (value > INT_MAX || value < INT_MIN) {
-          die(1, "Value out of range for argument '%s'\n", *argv);
-        }
-        *(int*)clap_arg->value = value;
-        break;
-      }
-      case CLAP_ARG_TYPE_FLOAT: {
-        clap_arg->value = malloc(sizeof(float));
-        float fvalue = strtof(argv[1], NULL);
-        *(float*)clap_arg->value = fvalue;
-        break;
-      }
-      case CLAP_ARG_TYPE_STRING: {
-        clap_arg->value = strdup(argv[1]);
-        break;
-      }
-      default: {
-        asprintf(error, "Invalid argument type\n");
-        return false;
-      }
-      }
+  return 80;
+}
+
+static char* format_help(const char* program_name, const char* description,
+  s_clap_arg* args[], size_t width, const s_clapc_allocator* allocator,
+  size_t* len_ptr)
+{
+  size_t count = 0;
+  while (args[count] != NULL) {
+    count++;
+  }
+
+  s_help_row local_rows[CLAPC_HELP_LOCAL_ROWS];
+  s_help_row* rows = local_rows;
+  if (count > CLAPC_HELP_LOCAL_ROWS) {
+    rows = malloc(count * sizeof(*rows));
+    if (rows == NULL) {
+      return NULL;
+    }
+  }
+
+  size_t largest_option = 2;
+  size_t text_len = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    s_clap_arg* arg = args[i];
+    rows[i].name_len = arg->name ? strlen(arg->name) : 0;
+    rows[i].option_width = option_width(arg, rows[i].name_len);
 
-      argv++;
+    size_t option = rows[i].option_width;
+    if (option > largest_option && option <= CLAPC_HELP_MAX_OPTION_WIDTH) {
+      largest_option = option;
+    }
+    text_len += option;
+    if (arg->description) {
+      text_len += strlen(arg->description);
+    }
+  }
+
+  size_t indent = 2 + largest_option + 2;
+  size_t description_width = width > indent ? width - indent : 0;
+  if (description_width < CLAPC_HELP_MIN_DESCRIPTION_WIDTH) {
+    description_width = CLAPC_HELP_MIN_DESCRIPTION_WIDTH;
+  }
+
+  if (description) {
+    text_len += strlen(description);
+  }
+
+  // Guess the size of the output well enough to almost never grow the buffer
+  size_t capacity = 64 + strlen(program_name) + text_len * 2;
+  s_buffer buffer = {
+    .data = mem_alloc(allocator, capacity),
+    .capacity = capacity,
+    .allocator = allocator,
+  };
+
+  buffer_append(&buffer, program_name, strlen(program_name));
+  buffer_append(&buffer, "\n\n", 2);
+  if (description) {
+    append_wrapped(&buffer, description, 0, width);
+    buffer_append(&buffer, "\n", 1);
+  }
+  buffer_append(&buffer, "Options:\n", 9);
+
+  for (size_t i = 0; i < count; i++) {
+    s_clap_arg* arg = args[i];
+    size_t option = rows[i].option_width;
+
+    buffer_fill(&buffer, ' ', 2);
+    append_option(&buffer, arg, rows[i].name_len);
+
+    if (arg->description == NULL || *arg->description == '\0') {
+      buffer_append(&buffer, "\n", 1);
+      continue;
+    }
+
+    if (option > largest_option) {
+      buffer_append(&buffer, "\n", 1);
+      buffer_fill(&buffer, ' ', indent);
     } else {
-      clap_arg->value = malloc(sizeof(bool));
-      // If we are parsing a boolean argument, consume the next arg if it is
-      // either "true" or "false"
-      bool is_true = argv[1] && strcmp(argv[1], "true") == 0;
-      bool is_false = !is_true && argv[1] && strcmp(argv[1], "false") == 0;
-
-      if (is_true || is_false) {
-        *(bool*)clap_arg->value = is_true;
-        argv++;
-      } else {
-        *(bool*)clap_arg->value = true;
-      }
+      buffer_fill(&buffer, ' ', indent - 2 - option);
     }
+    append_wrapped(&buffer, arg->description, indent, description_width);
+  }
 
-    // TODO: go through all args and check if required args are present
+  buffer_append(&buffer, "\n", 1);
 
-    arg = *++argv;
+  if (rows != local_rows) {
+    free(rows);
   }
 
-  *argv_ptr = argv;
-  return true;
+  buffer_append(&buffer, "", 1);
+  if (buffer.data && allocator) {
+    // Give back what the guess left over, so that the message is as large as
+    // the caller thinks it is when freeing it
+    char* data
+      = mem_realloc(allocator, buffer.data, buffer.capacity, buffer.len);
+    if (data == NULL) {
+      mem_free(allocator, buffer.data, buffer.capacity);
+    }
+    buffer.data = data;
+  }
+  if (buffer.data) {
+    *len_ptr = buffer.len - 1;
+  }
+  return buffer.data;
 }
 
-void clapc_parse(s_clap_arg* args[], char*** argv_ptr)
+char* clapc_format_help(const char* program_name, const char* description,
+  s_clap_arg* args[], size_t width, size_t* len_ptr)
 {
-  char* error = NULL;
-  if (!clapc_parse_safe(args, argv_ptr, &error)) {
-    die(1, "%s", error);
+  return clapc_format_help_with_allocator(
+    program_name, description, args, width, NULL, len_ptr);
+}
+
+char* clapc_format_help_with_allocator(const char* program_name,
+  const char* description, s_clap_arg* args[], size_t width,
+  const s_clapc_allocator* allocator, size_t* len_ptr)
+{
+  if (width == 0) {
+    width = terminal_width(STDOUT_FILENO);
   }
+  return format_help(
+    program_name, description, args, width, allocator, len_ptr);
+}
+
+void clapc_fprint_help(FILE* stream, const char* program_name,
+  const char* description, s_clap_arg* args[])
+{
+  int fd = fileno(stream);
+  size_t len;
+  char* help = format_help(program_name, description, args,
+    terminal_width(fd >= 0 ? fd : STDOUT_FILENO), NULL, &len);
+  if (help == NULL) {
+    return;
+  }
+
+  // Whatever was printed before must come out first
+  fflush(stream);
+
+  if (fd < 0) {
+    fwrite(help, 1, len, stream);
+  } else {
+    write_all(fd, help, len);
+  }
+
+  free(help);
 }
 
 void clapc_print_help(
   const char* program_name, const char* description, s_clap_arg* args[])
 {
-  int largest_name = 2;
+  clapc_fprint_help(stdout, program_name, description, args);
+}
+
+// Completion ==================================================================
+
+static void buffer_append_str(s_buffer* buffer, const char* str)
+{
+  buffer_append(buffer, str, strlen(str));
+}
+
+/**
+ * Append `str` as a single-quoted shell word. Fish escapes quotes inside of
+ * single quotes, while bash and zsh have to close the quotes first.
+ */
+static void append_quoted(s_buffer* buffer, const char* str, bool fish)
+{
+  buffer_append(buffer, "'", 1);
+  for (const char* p = str; *p; p++) {
+    if (*p == '\'') {
+      buffer_append_str(buffer, fish ? "\\'" : "'\\''");
+    } else if (*p == '\\' && fish) {
+      buffer_append(buffer, "\\\\", 2);
+    } else {
+      buffer_append(buffer, p, 1);
+    }
+  }
+  buffer_append(buffer, "'", 1);
+}
+
+/**
+ * Append `str` with a backslash before every character in `specials`.
+ */
+static void append_escaped(
+  s_buffer* buffer, const char* str, const char* specials)
+{
+  for (const char* p = str; *p; p++) {
+    if (strchr(specials, *p)) {
+      buffer_append(buffer, "\\", 1);
+    }
+    buffer_append(buffer, p, 1);
+  }
+}
+
+/**
+ * Append `program_name` as a shell function name.
+ */
+static void append_identifier(s_buffer* buffer, const char* program_name)
+{
+  for (const char* p = program_name; *p; p++) {
+    char c = *p;
+    bool alnum
+      = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || is_digit(c);
+    buffer_append(buffer, alnum ? p : "_", 1);
+  }
+}
+
+static void bash_script(
+  s_buffer* buffer, const char* program_name, s_clap_arg* args[])
+{
+  buffer_append_str(buffer, "_");
+  append_identifier(buffer, program_name);
+  buffer_append_str(buffer, "_complete() {\n"
+                            "  local cur=\"${COMP_WORDS[COMP_CWORD]}\"\n"
+                            "  [[ $cur == -* ]] || return\n"
+                            "  COMPREPLY=($(compgen -W ");
+
+  s_buffer words = { .data = malloc(256), .capacity = 256 };
+  for (int i = 0; args[i] != NULL; i++) {
+    if (args[i]->name) {
+      buffer_append_str(&words, "--");
+      buffer_append_str(&words, args[i]->name);
+      buffer_append(&words, " ", 1);
+    }
+    if (args[i]->short_name != 0) {
+      char short_name[3] = { '-', args[i]->short_name, ' ' };
+      buffer_append(&words, short_name, 3);
+    }
+  }
+  buffer_append(&words, "", 1);
+  append_quoted(buffer, words.data ? words.data : "", false);
+  free(words.data);
+
+  buffer_append_str(buffer, " -- \"$cur\"))\n"
+                            "}\n"
+                            "complete -o default -F _");
+  append_identifier(buffer, program_name);
+  buffer_append_str(buffer, "_complete ");
+  append_quoted(buffer, program_name, false);
+  buffer_append(buffer, "\n", 1);
+}
+
+static void zsh_script(
+  s_buffer* buffer, const char* program_name, s_clap_arg* args[])
+{
+  buffer_append_str(buffer, "#compdef ");
+  buffer_append_str(buffer, program_name);
+  buffer_append_str(buffer, "\n\n_arguments -s");
+
+  s_buffer spec = { .data = malloc(256), .capacity = 256 };
 
   for (int i = 0; args[i] != NULL; i++) {
     s_clap_arg* arg = args[i];
-    if (arg->name == NULL) {
-      continue;
+    const char* forms[2] = { NULL, NULL };
+    char short_name[3] = { '-', arg->short_name, '\0' };
+    char* long_name = NULL;
+
+    if (arg->name && asprintf(&long_name, "--%s", arg->name) >= 0) {
+      forms[0] = long_name;
+    }
+    if (arg->short_name != 0) {
+      forms[1] = short_name;
+    }
+
+    for (int j = 0; j < 2; j++) {
+      if (forms[j] == NULL) {
+        continue;
+      }
+
+      spec.len = 0;
+      append_escaped(&spec, forms[j], "[]:\\");
+      if (arg->type != CLAP_ARG_TYPE_BOOL && j == 0) {
+        buffer_append(&spec, "=", 1);
+      }
+      buffer_append(&spec, "[", 1);
+      append_escaped(&spec, arg->description ? arg->description : "", "[]:\\");
+      buffer_append(&spec, "]", 1);
+      if (arg->type != CLAP_ARG_TYPE_BOOL) {
+        // Values are completed as files, since that's the most common kind
+        buffer_append_str(&spec, ":value:_files");
+      }
+      buffer_append(&spec, "", 1);
+
+      buffer_append_str(buffer, " \\\n  ");
+      append_quoted(buffer, spec.data ? spec.data : "", false);
     }
-    int name_len = strlen(arg->name) + 2;
-    int short_name_len = arg->short_name == 0 ? 0 : 2;
 
-    int total_length = name_len + short_name_len +
-      // If both a short and long name are present, add ", " between them
-      (short_name_len > 0 ? 2 : 0);
+    free(long_name);
+  }
+
+  free(spec.data);
+  buffer_append(buffer, "\n", 1);
+}
 
-    // TODO: in the future we may want to include <value> for non-bool args
+static void fish_script(
+  s_buffer* buffer, const char* program_name, s_clap_arg* args[])
+{
+  for (int i = 0; args[i] != NULL; i++) {
+    s_clap_arg* arg = args[i];
 
-    if (total_length > largest_name) {
-      largest_name = total_length;
+    buffer_append_str(buffer, "complete -c ");
+    append_quoted(buffer, program_name, true);
+    if (arg->name) {
+      buffer_append_str(buffer, " -l ");
+      append_quoted(buffer, arg->name, true);
+    }
+    if (arg->short_name != 0) {
+      char short_name[2] = { arg->short_name, '\0' };
+      buffer_append_str(buffer, " -s ");
+      append_quoted(buffer, short_name, true);
     }
+    if (arg->type != CLAP_ARG_TYPE_BOOL) {
+      buffer_append_str(buffer, " -r");
+    }
+    if (arg->description) {
+      buffer_append_str(buffer, " -d ");
+      append_quoted(buffer, arg->description, true);
+    }
+    buffer_append(buffer, "\n", 1);
+  }
+}
+
+char* clapc_completion_script(e_clapc_shell shell, const char* program_name,
+  s_clap_arg* args[], size_t* len_ptr)
+{
+  s_buffer buffer = { .data = malloc(4096), .capacity = 4096 };
+
+  switch (shell) {
+  case CLAPC_SHELL_BASH:
+    bash_script(&buffer, program_name, args);
+    break;
+  case CLAPC_SHELL_ZSH:
+    zsh_script(&buffer, program_name, args);
+    break;
+  case CLAPC_SHELL_FISH:
+    fish_script(&buffer, program_name, args);
+    break;
   }
 
-  printf("%s\n\n%s\n\n", program_name, description);
+  if (buffer.data) {
+    buffer_append(&buffer, "", 1);
+    *len_ptr = buffer.len - 1;
+  }
+  return buffer.data;
+}
 
-  printf("Options:\n");
+char* clapc_completions(
+  s_clap_arg* args[], const char* prefix, size_t* len_ptr)
+{
+  size_t prefix_len = strlen(prefix);
+  s_buffer buffer = { .data = malloc(1024), .capacity = 1024 };
 
-  char buffer[1024];
+  // Only options are completed. "-" completes both long and short names.
+  bool is_long = prefix_len >= 2 && prefix[0] == '-' && prefix[1] == '-';
+  bool is_short = !is_long && prefix_len <= 2 && prefix[0] == '-';
+  const char* name_prefix = prefix + 2;
+  size_t name_prefix_len = is_long ? prefix_len - 2 : 0;
 
   for (int i = 0; args[i] != NULL; i++) {
     s_clap_arg* arg = args[i];
-    bool has_long_name = arg->name != NULL;
-    bool has_short_name = arg->short_name != 0;
 
-    sprintf(buffer, "%s%s%s%c", has_long_name ? "--" : "",
-      has_long_name ? arg->name : "",
-      has_long_name && has_short_name ? ", -" : "",
-      has_short_name ? arg->short_name : 0);
+    if ((is_long || (is_short && prefix_len == 1)) && arg->name
+      && strncmp(arg->name, name_prefix, name_prefix_len) == 0) {
+      buffer_append(&buffer, "--", 2);
+      buffer_append_str(&buffer, arg->name);
+      buffer_append(&buffer, "\n", 1);
+    }
+
+    if (is_short && arg->short_name != 0
+      && (prefix_len == 1 || prefix[1] == arg->short_name)) {
+      char short_name[3] = { '-', arg->short_name, '\n' };
+      buffer_append(&buffer, short_name, 3);
+    }
+  }
+
+  if (buffer.data) {
+    buffer_append(&buffer, "", 1);
+    *len_ptr = buffer.len - 1;
+  }
+  return buffer.data;
+}
+
+void clapc_complete(s_clap_arg* args[], char** argv)
+{
+  if (argv[0] == NULL || argv[1] == NULL
+    || strcmp(argv[1], "--__complete") != 0) {
+    return;
+  }
 
-    printf("  %-*s  %s\n", largest_name, buffer, arg->description);
+  size_t len;
+  char* completions = clapc_completions(args, argv[2] ? argv[2] : "", &len);
+  if (completions == NULL) {
+    exit(1);
   }
 
-  printf("\n");
+  exit(write_all(STDOUT_FILENO, completions, len) ? 0 : 1);
+}
+
+/**
+ * The size of the memory of a value allocated by the parser.
+ */
+static size_t owned_size(const s_clap_arg* arg)
+{
+  if (is_list_type(arg->type)) {
+    return sizeof(s_clap_list);
+  }
+  if (arg->type == CLAP_ARG_TYPE_STRING) {
+    return arg->value_len + 1;
+  }
+  return value_size(arg->type);
 }
 
 void clapc_arg_free(s_clap_arg* arg)
 {
-  if (arg->value) {
-    free(arg->value);
-    arg->value = NULL;
+  // List items are always ours, even if the list itself is caller-owned. A
+  // list from an arena may already be gone with it, so it isn't even read.
+  if (is_list_type(arg->type) && arg->value) {
+    if (!is_arena(arg->allocator)) {
+      s_clap_list* list = arg->value;
+      mem_free(arg->allocator, list->items,
+        list->capacity * list_item_size(arg->type));
+    }
+    if (arg->dest) {
+      *(s_clap_list*)arg->dest = (s_clap_list) { 0 };
+    }
+  }
+
+  // Values written to caller-owned storage or borrowed from argv were never
+  // allocated by us
+  if (owns_value(arg) && arg->value) {
+    mem_free(arg->allocator, arg->value, owned_size(arg));
   }
+  arg->value = NULL;
+  arg->value_len = 0;
+  arg->allocator = NULL;
+
+  free_response_files(arg->files);
+  arg->files = NULL;
 }
 
 void clapc_args_free(s_clap_arg* args[])
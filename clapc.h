@@ -1,6 +1,18 @@
 #pragma once
-#if defined _WIN32 || defined __CYGWIN__
-#ifdef BUILDING_CLAPC
+// When the implementation is part of the includer (see clapc_amalgamate.py),
+// it needs the GNU extensions of the headers included below
+#if defined CLAPC_IMPLEMENTATION && !defined _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+// Define CLAPC_STATIC when linking to a static build of clapc. Nothing is
+// exported nor imported when the implementation is part of the includer
+#if defined CLAPC_IMPLEMENTATION
+#define CLAPC_PUBLIC
+#elif defined _WIN32 || defined __CYGWIN__
+#if defined CLAPC_STATIC
+#define CLAPC_PUBLIC
+#elif defined BUILDING_CLAPC
 #define CLAPC_PUBLIC __declspec(dllexport)
 #else
 #define CLAPC_PUBLIC __declspec(dllimport)
@@ -15,14 +27,187 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
 typedef enum {
   CLAP_ARG_TYPE_BOOL = 0,
   CLAP_ARG_TYPE_INT,
   CLAP_ARG_TYPE_FLOAT,
   CLAP_ARG_TYPE_STRING,
+  CLAP_ARG_TYPE_INT_LIST,
+  CLAP_ARG_TYPE_FLOAT_LIST,
+  CLAP_ARG_TYPE_STRING_LIST,
+  CLAP_ARG_TYPE_INT64,
+  CLAP_ARG_TYPE_UINT64,
+  CLAP_ARG_TYPE_DOUBLE,
+  CLAP_ARG_TYPE_SIZE,
+  CLAP_ARG_TYPE_DURATION,
+  CLAP_ARG_TYPE_ENUM,
+  CLAP_ARG_TYPE_CUSTOM,
 } CLAPC_PUBLIC e_clap_arg_type;
 
+/**
+ * A view of a string that is not necessarily owned by whoever holds the view.
+ */
+typedef struct {
+  /**
+   * The first character of the string.
+   */
+  const char* data;
+  /**
+   * The length of the string in bytes, not including any null-terminator.
+   */
+  size_t len;
+} CLAPC_PUBLIC s_clap_str;
+
+/**
+ * The values of a list argument. Every occurrence of the argument (and every
+ * comma-separated item in each occurrence) is appended to a single contiguous
+ * buffer.
+ */
+typedef struct {
+  /**
+   * The items of the list. This is an array of int for CLAP_ARG_TYPE_INT_LIST,
+   * float for CLAP_ARG_TYPE_FLOAT_LIST, and {@link s_clap_str} for
+   * CLAP_ARG_TYPE_STRING_LIST.
+   */
+  void* items;
+  /**
+   * The number of items in the list.
+   */
+  size_t count;
+  /**
+   * The number of items the buffer has room for.
+   */
+  size_t capacity;
+} CLAPC_PUBLIC s_clap_list;
+
+/**
+ * A response file or config file loaded while parsing, see {@link
+ * s_clap_arg.files}.
+ */
+typedef struct clapc_response_file s_clapc_response_file;
+
+/**
+ * Parses the value of a CLAP_ARG_TYPE_CUSTOM argument, see {@link
+ * s_clap_arg.parse}.
+ *
+ * @param value The value as it was given. It is borrowed from argv (or from
+ * the environment or a config file), and `value.data[value.len]` is always a
+ * null-terminator
+ * @param dest The {@link s_clap_arg.dest} of the argument, where the parsed
+ * value should be written. This is NULL when the value should only be
+ * validated, e.g. when parsing into a {@link s_clapc_result}
+ * @param data The {@link s_clap_arg.parse_data} of the argument
+ * @param reason A pointer to a string that may be set to why the value is
+ * invalid, e.g. "port out of range", without a trailing newline. It is
+ * included in the error message, and must outlive it (a string literal is
+ * best)
+ * @return true if the value is valid, false otherwise
+ */
+typedef bool (*f_clap_parse_value)(
+  s_clap_str value, void* dest, void* data, const char** reason);
+
+/**
+ * Where the memory of parsed values (and of help messages) comes from, for the
+ * functions that take one. Wherever an allocator may be given, NULL means
+ * malloc, realloc and free. Every call is told the size of the memory, so that
+ * allocators don't have to keep track of it.
+ */
+typedef struct {
+  /**
+   * Allocates `size` bytes, aligned for any type.
+   *
+   * @return The memory, or NULL if it couldn't be allocated
+   */
+  void* (*alloc)(void* context, size_t size);
+  /**
+   * Resizes memory from this allocator from `old_size` to `size` bytes,
+   * keeping its contents. `ptr` may be NULL, in which case `old_size` is 0.
+   *
+   * @return The memory, or NULL if it couldn't be resized (`ptr` is then left
+   * untouched)
+   */
+  void* (*realloc)(void* context, void* ptr, size_t old_size, size_t size);
+  /**
+   * Frees `size` bytes of memory from this allocator. This may be NULL if the
+   * memory is only ever released all at once, like that of an {@link
+   * s_clapc_arena}.
+   */
+  void (*free)(void* context, void* ptr, size_t size);
+  /**
+   * Passed as is to every function of the allocator.
+   */
+  void* context;
+} CLAPC_PUBLIC s_clapc_allocator;
+
+typedef struct clapc_arena_block s_clapc_arena_block;
+
+/**
+ * A bump allocator: memory is handed out from large blocks in order, and is
+ * all released at once by {@link clapc_arena_reset}. Parsing into an arena
+ * costs about one pointer increment per value, and nothing has to be freed
+ * value by value.
+ *
+ * Blocks are kept by resets and reused, so parsing over and over into the
+ * same arena stops allocating once it has grown enough. An arena must not be
+ * moved once it has been initialized, since its allocator points to it.
+ */
+typedef struct {
+  /**
+   * The allocator to pass to the functions that take one.
+   */
+  s_clapc_allocator allocator;
+  /**
+   * The size of each block, unless a single allocation needs more.
+   */
+  size_t block_size;
+  /**
+   * Every block of the arena, in the order they are used.
+   */
+  s_clapc_arena_block* blocks;
+  /**
+   * The block memory is currently handed out from.
+   */
+  s_clapc_arena_block* current;
+  /**
+   * The free memory left in the current block.
+   */
+  char* pos;
+  char* end;
+} CLAPC_PUBLIC s_clapc_arena;
+
+/**
+ * The block size of arenas initialized with a block size of 0.
+ */
+#define CLAPC_ARENA_BLOCK_SIZE 4096
+
+/**
+ * Initializes an empty arena. Nothing is allocated until it is first used.
+ *
+ * @param arena The arena to initialize
+ * @param block_size The size of each block, or 0 for {@link
+ * CLAPC_ARENA_BLOCK_SIZE}
+ */
+CLAPC_PUBLIC void clapc_arena_init(s_clapc_arena* arena, size_t block_size);
+
+/**
+ * Releases everything allocated from an arena at once, but keeps its blocks
+ * for reuse. Values parsed into the arena must not be used anymore.
+ *
+ * @param arena The arena to reset
+ */
+CLAPC_PUBLIC void clapc_arena_reset(s_clapc_arena* arena);
+
+/**
+ * Frees the blocks of an arena. It is left empty, and may be used again.
+ *
+ * @param arena The arena to free
+ */
+CLAPC_PUBLIC void clapc_arena_free(s_clapc_arena* arena);
+
 /**
  * Represents a command-line argument. This is used to define the arguments that
  * the user can provide to the program.
@@ -45,6 +230,22 @@ typedef struct {
    * - CLAP_ARG_TYPE_INT
    * - CLAP_ARG_TYPE_FLOAT
    * - CLAP_ARG_TYPE_STRING
+   * - CLAP_ARG_TYPE_INT_LIST
+   * - CLAP_ARG_TYPE_FLOAT_LIST
+   * - CLAP_ARG_TYPE_STRING_LIST
+   * - CLAP_ARG_TYPE_INT64
+   * - CLAP_ARG_TYPE_UINT64
+   * - CLAP_ARG_TYPE_DOUBLE
+   * - CLAP_ARG_TYPE_SIZE, a number of bytes (see {@link clapc_parse_size})
+   * - CLAP_ARG_TYPE_DURATION, in nanoseconds (see {@link
+   *   clapc_parse_duration})
+   * - CLAP_ARG_TYPE_ENUM, one of {@link choices}, stored as its index
+   * - CLAP_ARG_TYPE_CUSTOM, parsed by {@link parse} into {@link dest}
+   *
+   * List arguments may be given more than once, and each value may hold
+   * several comma-separated items (e.g. "-I a,b -I c" is the list a, b, c).
+   * The items of string lists are views of the original argument, so they are
+   * never copied.
    */
   const e_clap_arg_type type;
   /**
@@ -52,6 +253,42 @@ typedef struct {
    * The type of the value is determined by the {@link type} field.
    */
   void* value;
+  /**
+   * The length in bytes of a string value. This is set by the parser for
+   * CLAP_ARG_TYPE_STRING arguments.
+   */
+  size_t value_len;
+  /**
+   * Optional caller-owned storage for the value of the argument. If this is
+   * set, the parser writes the value directly into it instead of allocating
+   * memory, and {@link value} is never freed by {@link clapc_arg_free}.
+   *
+   * The storage must match the {@link type} field:
+   *
+   * - CLAP_ARG_TYPE_BOOL: bool*
+   * - CLAP_ARG_TYPE_INT: int*
+   * - CLAP_ARG_TYPE_FLOAT: float*
+   * - CLAP_ARG_TYPE_STRING: const char**, which will point into argv (the
+   *   string is not copied)
+   * - CLAP_ARG_TYPE_INT64: int64_t*
+   * - CLAP_ARG_TYPE_UINT64, CLAP_ARG_TYPE_SIZE and CLAP_ARG_TYPE_DURATION:
+   *   uint64_t*
+   * - CLAP_ARG_TYPE_DOUBLE: double*
+   * - CLAP_ARG_TYPE_ENUM: int*
+   * - CLAP_ARG_TYPE_CUSTOM: whatever {@link parse} writes to, which custom
+   *   arguments must have. {@link value} is set to this pointer
+   * - List types: s_clap_list*. The items buffer is still allocated by the
+   *   parser, and is freed by {@link clapc_arg_free}
+   */
+  void* dest;
+  /**
+   * Whether string values should be borrowed from argv instead of copied. If
+   * this is true, {@link value} points into the original argv (for
+   * "--name=value", right after the "="), and nothing is allocated for it.
+   * Since argv lives for the whole process, this is safe as long as argv is not
+   * modified.
+   */
+  bool borrow;
   /**
    * The description of the argument. This is a human-readable description of
    * the argument. This is used to generate the help message for the argument.
@@ -59,9 +296,70 @@ typedef struct {
   const char* description;
   /**
    * Whether the argument is required. If this is true, the argument must be
-   * provided by the user. If this is false, the argument is optional.
+   * provided by the user. If this is false, the argument is optional. When
+   * parsing into the arguments, required arguments with an {@link env} variable
+   * may be given in either place, and are checked by {@link clapc_parse_env}
+   * instead. Parsing into a result has no environment to fall back on, so it
+   * checks every required argument. Config files are read last and can't
+   * provide a required argument.
    */
   bool required;
+  /**
+   * The name of an environment variable to read the value from if the argument
+   * is not given on the command line, e.g. "APP_THREADS". See {@link
+   * clapc_parse_env}.
+   */
+  const char* env;
+  /**
+   * The long names of the arguments that can't be given along with this one,
+   * followed by NULL, e.g. `(const char*[]) { "json", NULL }`.
+   */
+  const char* const* conflicts_with;
+  /**
+   * The long names of the arguments that must be given if this one is,
+   * followed by NULL.
+   */
+  const char* const* depends_on;
+  /**
+   * The name of a group of mutually exclusive arguments. At most one argument
+   * of each group may be given.
+   */
+  const char* group;
+  /**
+   * Whether giving the argument more than once is an error. Otherwise the last
+   * value wins (or, for list arguments, every value is appended).
+   */
+  bool unique;
+  /**
+   * The values a CLAP_ARG_TYPE_ENUM argument may have, followed by NULL, e.g.
+   * `(const char*[]) { "fast", "small", NULL }`. The value of the argument is
+   * the index of the choice that was given.
+   */
+  const char* const* choices;
+  /**
+   * The function that parses the values of a CLAP_ARG_TYPE_CUSTOM argument
+   * straight into {@link dest}, e.g. an address and port, or a CPU mask. If it
+   * rejects a value, parsing fails with "Invalid value 'x' for argument
+   * '--name': reason".
+   */
+  f_clap_parse_value parse;
+  /**
+   * Passed as is to {@link parse}, for any state it needs.
+   */
+  void* parse_data;
+  /**
+   * The allocator the memory of {@link value} (and of the items of a list)
+   * came from, which {@link clapc_arg_free} gives it back to. This is set by
+   * the parser.
+   */
+  const s_clapc_allocator* allocator;
+  /**
+   * The response files and config files loaded while parsing, which borrowed
+   * values and the arguments left after parsing may point into. They belong to
+   * the whole array, so the parser keeps them on its first argument, and they
+   * are released by {@link clapc_arg_free} of that argument.
+   */
+  s_clapc_response_file* files;
 } CLAPC_PUBLIC s_clap_arg;
 
 /**
@@ -100,6 +398,57 @@ typedef struct {
     *(float*)(arg)->value;                                                     \
   })
 
+/**
+ * Gets the value of a 64-bit integer argument.
+ * @param arg The argument to get the value of
+ * @return The value of the argument
+ */
+#define clap_arg_get_int64(arg)                                                \
+  ({                                                                           \
+    assert((arg)->type == CLAP_ARG_TYPE_INT64);                                \
+    assert((arg)->value != NULL);                                              \
+    *(int64_t*)(arg)->value;                                                   \
+  })
+
+/**
+ * Gets the value of an unsigned 64-bit integer, size or duration argument.
+ * @param arg The argument to get the value of
+ * @return The value of the argument. Sizes are in bytes and durations in
+ * nanoseconds.
+ */
+#define clap_arg_get_uint64(arg)                                               \
+  ({                                                                           \
+    assert((arg)->type == CLAP_ARG_TYPE_UINT64                                 \
+      || (arg)->type == CLAP_ARG_TYPE_SIZE                                     \
+      || (arg)->type == CLAP_ARG_TYPE_DURATION);                               \
+    assert((arg)->value != NULL);                                              \
+    *(uint64_t*)(arg)->value;                                                  \
+  })
+
+/**
+ * Gets the value of a double argument.
+ * @param arg The argument to get the value of
+ * @return The value of the argument
+ */
+#define clap_arg_get_double(arg)                                               \
+  ({                                                                           \
+    assert((arg)->type == CLAP_ARG_TYPE_DOUBLE);                               \
+    assert((arg)->value != NULL);                                              \
+    *(double*)(arg)->value;                                                    \
+  })
+
+/**
+ * Gets the value of an enum argument.
+ * @param arg The argument to get the value of
+ * @return The index of the choice that was given
+ */
+#define clap_arg_get_enum(arg)                                                 \
+  ({                                                                           \
+    assert((arg)->type == CLAP_ARG_TYPE_ENUM);                                 \
+    assert((arg)->value != NULL);                                              \
+    *(int*)(arg)->value;                                                       \
+  })
+
 /**
  * Gets the value of a string argument.
  * @param arg The argument to get the value of
@@ -112,55 +461,1170 @@ typedef struct {
   })
 
 /**
- * Parses the command-line arguments and populates the values of the arguments
- * in the {@link args} array.
- *
- * @param args The array of arguments to parse. This array should be
- * null-terminated
- * @param argv_ptr A pointer to the command-line arguments. This pointer will be
- * updated to point to the next argument after the parsed arguments.
+ * Gets the value of a string argument as a view. Unlike {@link
+ * clap_arg_get_string}, this doesn't require measuring the string.
+ * @param arg The argument to get the value of
+ * @return The value of the argument as a {@link s_clap_str}. If the argument
+ * was not given, the view is empty and its data is NULL.
  */
-CLAPC_PUBLIC void clapc_parse(s_clap_arg* args[], char*** argv_ptr);
+#define clap_arg_get_string_view(arg)                                          \
+  ({                                                                           \
+    assert((arg)->type == CLAP_ARG_TYPE_STRING);                               \
+    (s_clap_str) { .data = (arg)->value, .len = (arg)->value_len };            \
+  })
 
 /**
- * Parses the command-line arguments and populates the values of the arguments
- * in the {@link args} array. This function is similar to {@link clapc_parse},
- * but it returns a boolean indicating whether the parsing was successful, and
- * an error message if the parsing failed.
- *
- * @param args The array of arguments to parse. This array should be
- * null-terminated
- * @param argv_ptr A pointer to the command-line arguments. This pointer will be
- * updated to point to the next argument after the parsed arguments.
- * @param error A pointer to a string that will be updated with an error message
- * if the parsing fails. This string should be freed by the caller.
- * @return true if the parsing was successful, false otherwise
+ * Gets the items of a list argument.
+ * @param arg The argument to get the value of
+ * @param type The type of the items
+ * @param count_ptr A pointer to a size_t that will be set to the number of
+ * items
+ * @return A pointer to the first item, or NULL if the list is empty
  */
-CLAPC_PUBLIC
-bool clapc_parse_safe(s_clap_arg* args[], char*** argv_ptr, char** error);
+#define clap_arg_get_list(arg, type, count_ptr)                                \
+  ({                                                                           \
+    const s_clap_list* _list = (arg)->value;                                   \
+    *(count_ptr) = _list ? _list->count : 0;                                   \
+    _list ? (const type*)_list->items : NULL;                                  \
+  })
+
+/**
+ * Gets the items of an integer list argument.
+ * @param arg The argument to get the value of
+ * @param count_ptr A pointer to a size_t that will be set to the number of
+ * items
+ * @return A pointer to the first item, or NULL if the list is empty
+ */
+#define clap_arg_get_int_list(arg, count_ptr)                                  \
+  ({                                                                           \
+    assert((arg)->type == CLAP_ARG_TYPE_INT_LIST);                             \
+    clap_arg_get_list(arg, int, count_ptr);                                    \
+  })
+
+/**
+ * Gets the items of a float list argument.
+ * @param arg The argument to get the value of
+ * @param count_ptr A pointer to a size_t that will be set to the number of
+ * items
+ * @return A pointer to the first item, or NULL if the list is empty
+ */
+#define clap_arg_get_float_list(arg, count_ptr)                                \
+  ({                                                                           \
+    assert((arg)->type == CLAP_ARG_TYPE_FLOAT_LIST);                           \
+    clap_arg_get_list(arg, float, count_ptr);                                  \
+  })
+
+/**
+ * Gets the items of a string list argument.
+ * @param arg The argument to get the value of
+ * @param count_ptr A pointer to a size_t that will be set to the number of
+ * items
+ * @return A pointer to the first item, or NULL if the list is empty
+ */
+#define clap_arg_get_string_list(arg, count_ptr)                               \
+  ({                                                                           \
+    assert((arg)->type == CLAP_ARG_TYPE_STRING_LIST);                          \
+    clap_arg_get_list(arg, s_clap_str, count_ptr);                             \
+  })
+
+/**
+ * The numeric types understood by {@link clapc_parse_number}.
+ */
+typedef enum {
+  /**
+   * int32_t
+   */
+  CLAPC_NUMBER_INT32 = 0,
+  /**
+   * int64_t
+   */
+  CLAPC_NUMBER_INT64,
+  /**
+   * uint64_t
+   */
+  CLAPC_NUMBER_UINT64,
+  /**
+   * float
+   */
+  CLAPC_NUMBER_FLOAT,
+  /**
+   * double
+   */
+  CLAPC_NUMBER_DOUBLE,
+} CLAPC_PUBLIC e_clapc_number_type;
+
+typedef enum {
+  /**
+   * The number was parsed successfully.
+   */
+  CLAPC_NUMBER_OK = 0,
+  /**
+   * The string is not a number of the requested type.
+   */
+  CLAPC_NUMBER_INVALID,
+  /**
+   * The string is a number, but it doesn't fit in the requested type.
+   */
+  CLAPC_NUMBER_OUT_OF_RANGE,
+} CLAPC_PUBLIC e_clapc_number_status;
 
 /**
- * Frees the memory allocated for an argument.
+ * Parses a decimal number. This is what {@link clapc_parse_safe} uses for
+ * numeric arguments. Unlike strtol and strtod, the whole string must be a
+ * number (no whitespace or trailing characters are accepted), overflow is
+ * always reported, and the current locale is never consulted.
  *
- * @param arg The argument to free
+ * Integers are an optional sign followed by decimal digits. Floating-point
+ * numbers may also have a fractional part and an exponent, or be "inf",
+ * "infinity" or "nan" (in any case), and are rounded correctly to the nearest
+ * representable value.
+ *
+ * @param str The string to parse. It doesn't have to be null-terminated
+ * @param len The length of the string in bytes
+ * @param type The type of number to parse
+ * @param out A pointer to where the value will be stored. It must point to a
+ * variable of the type described by {@link type}. It is only written to if the
+ * parsing succeeds
+ * @return CLAPC_NUMBER_OK if the number was parsed successfully, or the reason
+ * it wasn't
  */
-CLAPC_PUBLIC __attribute__((nonnull)) void clapc_arg_free(s_clap_arg* arg);
+CLAPC_PUBLIC e_clapc_number_status clapc_parse_number(
+  const char* str, size_t len, e_clapc_number_type type, void* out);
 
 /**
- * Frees the memory allocated for an array of arguments.
+ * Parses a number of bytes, like "4096", "512M" or "1.5GiB". The number may be
+ * followed by K, M, G, T, P or E (powers of 1024, "k" is also accepted), each
+ * optionally followed by "B" or "iB", or by just "B".
  *
- * @param args The array of arguments to free
+ * @param str The string to parse. It doesn't have to be null-terminated
+ * @param len The length of the string in bytes
+ * @param out A pointer to where the number of bytes will be stored, rounded
+ * down. It is only written to if the parsing succeeds
+ * @return CLAPC_NUMBER_OK if the size was parsed successfully, or the reason
+ * it wasn't
  */
-CLAPC_PUBLIC void clapc_args_free(s_clap_arg* args[]);
+CLAPC_PUBLIC e_clapc_number_status clapc_parse_size(
+  const char* str, size_t len, uint64_t* out);
 
 /**
- * Prints the help message for the program. This function takes the program name
- * and description, as well as an array of arguments, and prints a help message
- * that describes the program and the arguments that it accepts.
+ * Parses a duration, like "250ms", "2h" or "1h30m". A duration is a sequence of
+ * numbers (which may have a fractional part), each followed by a unit: "ns",
+ * "us" (or "µs"), "ms", "s", "m", "h" or "d". "0" is accepted on its own.
  *
- * @param program_name The name of the program
- * @param description A description of the program
- * @param args An array of arguments that the program accepts
+ * @param str The string to parse. It doesn't have to be null-terminated
+ * @param len The length of the string in bytes
+ * @param out A pointer to where the duration will be stored, in nanoseconds. It
+ * is only written to if the parsing succeeds
+ * @return CLAPC_NUMBER_OK if the duration was parsed successfully, or the
+ * reason it wasn't
  */
-CLAPC_PUBLIC void clapc_print_help(
-  const char* program_name, const char* description, s_clap_arg* args[]);
+CLAPC_PUBLIC e_clapc_number_status clapc_parse_duration(
+  const char* str, size_t len, uint64_t* out);
+
+/**
+ * What went wrong while parsing, see {@link s_clapc_error}.
+ */
+typedef enum {
+  CLAPC_ERROR_NONE = 0,
+  /**
+   * Memory for a value couldn't be allocated.
+   */
+  CLAPC_ERROR_OUT_OF_MEMORY,
+  /**
+   * No argument has the name that was given. {@link s_clapc_error.other} is
+   * the argument that was probably meant, if any.
+   */
+  CLAPC_ERROR_UNKNOWN_ARGUMENT,
+  /**
+   * A {@link s_clap_arg.unique} argument was given more than once.
+   */
+  CLAPC_ERROR_REPEATED_ARGUMENT,
+  /**
+   * The last argument needs a value, but argv ended.
+   */
+  CLAPC_ERROR_MISSING_VALUE,
+  /**
+   * The value can't be parsed as the type of the argument.
+   */
+  CLAPC_ERROR_INVALID_VALUE,
+  /**
+   * The value is a number that doesn't fit the type of the argument.
+   */
+  CLAPC_ERROR_OUT_OF_RANGE,
+  /**
+   * A {@link s_clap_arg.required} argument wasn't given.
+   */
+  CLAPC_ERROR_MISSING_REQUIRED,
+  /**
+   * Two arguments that conflict (or share a {@link s_clap_arg.group}) were
+   * both given.
+   */
+  CLAPC_ERROR_CONFLICT,
+  /**
+   * An argument was given without one that it {@link s_clap_arg.depends_on}.
+   */
+  CLAPC_ERROR_MISSING_DEPENDENCY,
+  /**
+   * The constraints of an argument name an argument that doesn't exist. Specs
+   * report this when they are compiled instead.
+   */
+  CLAPC_ERROR_UNKNOWN_CONSTRAINT,
+  /**
+   * A CLAP_ARG_TYPE_CUSTOM argument has no {@link s_clap_arg.parse}. Specs
+   * report this when they are compiled instead.
+   */
+  CLAPC_ERROR_NO_PARSE_FUNCTION,
+  /**
+   * A CLAP_ARG_TYPE_CUSTOM argument has no {@link s_clap_arg.dest}. Specs
+   * report this when they are compiled instead.
+   */
+  CLAPC_ERROR_NO_DESTINATION,
+  /**
+   * The argument has a type that doesn't exist.
+   */
+  CLAPC_ERROR_INVALID_TYPE,
+  /**
+   * A response file was opened but couldn't be mapped.
+   */
+  CLAPC_ERROR_RESPONSE_FILE,
+  /**
+   * A response file has a quote that isn't terminated.
+   */
+  CLAPC_ERROR_RESPONSE_FILE_QUOTE,
+  /**
+   * Response files include each other too deeply (more than 16 levels).
+   */
+  CLAPC_ERROR_RESPONSE_FILE_DEPTH,
+} CLAPC_PUBLIC e_clapc_error_code;
+
+/**
+ * Why parsing failed, as reported by {@link clapc_parse_checked}. Everything
+ * points into argv, the arguments, or response files, so nothing is allocated
+ * to report an error, and nothing needs to be freed. Use {@link
+ * clapc_error_format} to turn it into a message.
+ */
+typedef struct {
+  /**
+   * What went wrong.
+   */
+  e_clapc_error_code code;
+  /**
+   * The index in argv of the token at fault, or 0 if the error isn't about a
+   * single token (e.g. a missing required argument). Tokens that came from a
+   * response file are blamed on the "@path" token of argv that included it.
+   */
+  size_t index;
+  /**
+   * The byte offset of the part at fault in the token at {@link index}, e.g.
+   * of the value in "--jobs=4x", or of the name in "--jbos".
+   */
+  size_t offset;
+  /**
+   * The token that named the argument at fault, as it was given, e.g. "--jobs"
+   * or "--jobs=4x". For response file errors, this is the "@path" token. NULL
+   * if no token is at fault.
+   */
+  const char* option;
+  /**
+   * The part at fault: the value, the unknown name (without dashes), the path
+   * of a response file or the unknown name in a constraint. NULL if there is
+   * none.
+   */
+  const char* value;
+  /**
+   * The length of {@link value} in bytes. It isn't necessarily
+   * null-terminated.
+   */
+  size_t value_len;
+  /**
+   * The argument at fault, if there is one.
+   */
+  const s_clap_arg* arg;
+  /**
+   * The other argument of a conflict or a missing dependency, or the
+   * suggestion for an unknown argument.
+   */
+  const s_clap_arg* other;
+  /**
+   * Why a custom argument rejected its value, as set by its {@link
+   * s_clap_arg.parse}, or NULL.
+   */
+  const char* reason;
+} CLAPC_PUBLIC s_clapc_error;
+
+/**
+ * Formats the message of an error, the same one the parsing functions that
+ * return strings would have returned, e.g. "Invalid value '4x' for argument
+ * '--jobs'\n". Like snprintf, this writes at most `size` bytes (including the
+ * null-terminator) and never allocates.
+ *
+ * @param error The error to format
+ * @param buffer Where to write the message. It may be NULL if `size` is 0
+ * @param size The size of `buffer` in bytes
+ * @return The length of the whole message, even if it didn't fit
+ */
+CLAPC_PUBLIC size_t clapc_error_format(
+  const s_clapc_error* error, char* buffer, size_t size);
+
+/**
+ * Parses the command-line arguments and populates the values of the arguments
+ * in the {@link args} array.
+ *
+ * Arguments of the form "@path" are response files: the file is split into
+ * arguments (separated by whitespace, with shell-like single quotes, double
+ * quotes and backslash escapes) which are parsed as if they had been given in
+ * place of "@path". Response files may include other response files. If the
+ * file can't be read, "@path" is a regular argument. Arguments following "--"
+ * are never expanded. The files stay mapped until the arguments are freed,
+ * since borrowed values and the arguments left after parsing point into them.
+ *
+ * @param args The array of arguments to parse. This array should be
+ * null-terminated
+ * @param argv_ptr A pointer to the command-line arguments. This pointer will be
+ * updated to point to the next argument after the parsed arguments.
+ */
+CLAPC_PUBLIC void clapc_parse(s_clap_arg* args[], char*** argv_ptr);
+
+/**
+ * Parses the command-line arguments and populates the values of the arguments
+ * in the {@link args} array. This function is similar to {@link clapc_parse},
+ * but it returns a boolean indicating whether the parsing was successful, and
+ * an error message if the parsing failed.
+ *
+ * @param args The array of arguments to parse. This array should be
+ * null-terminated
+ * @param argv_ptr A pointer to the command-line arguments. This pointer will be
+ * updated to point to the next argument after the parsed arguments.
+ * @param error A pointer to a string that will be updated with an error message
+ * if the parsing fails. This string should be freed by the caller.
+ * @return true if the parsing was successful, false otherwise
+ */
+CLAPC_PUBLIC
+bool clapc_parse_safe(s_clap_arg* args[], char*** argv_ptr, char** error);
+
+/**
+ * Parses the command-line arguments like {@link clapc_parse_safe}, but reports
+ * why parsing failed as an {@link s_clapc_error} instead of a string. Nothing
+ * is allocated to report the error, so rejecting bad input is as cheap as
+ * accepting it.
+ *
+ * @param args The array of arguments to parse. This array should be
+ * null-terminated
+ * @param argv_ptr A pointer to the command-line arguments. This pointer will be
+ * updated to point to the next argument after the parsed arguments.
+ * @param error Set to why the parsing failed, if it fails
+ * @return true if the parsing was successful, false otherwise
+ */
+CLAPC_PUBLIC bool clapc_parse_checked(
+  s_clap_arg* args[], char*** argv_ptr, s_clapc_error* error);
+
+/**
+ * Parses the command-line arguments like {@link clapc_parse_checked}, but
+ * allocates the values that aren't given a {@link s_clap_arg.dest} (and the
+ * items of lists) from `allocator`. Each argument remembers where its memory
+ * came from, so {@link clapc_args_free} gives it back to the right allocator.
+ *
+ * With the allocator of an {@link s_clapc_arena}, calling {@link
+ * clapc_args_free} isn't needed: resetting the arena releases every value at
+ * once. Values from an arena are dropped (not reused) the next time the
+ * arguments are parsed, with any allocator, so the arena may be reset between
+ * parses.
+ *
+ * @param args The array of arguments to parse. This array should be
+ * null-terminated
+ * @param argv_ptr A pointer to the command-line arguments. This pointer will be
+ * updated to point to the next argument after the parsed arguments.
+ * @param allocator The allocator of the values, or NULL for malloc. It must
+ * outlive them
+ * @param error Set to why the parsing failed, if it fails
+ * @return true if the parsing was successful, false otherwise
+ */
+CLAPC_PUBLIC bool clapc_parse_with_allocator(s_clap_arg* args[],
+  char*** argv_ptr, const s_clapc_allocator* allocator, s_clapc_error* error);
+
+/**
+ * Sets the arguments that have an {@link s_clap_arg.env} name and no value yet
+ * from the environment. This is meant to be called after the command-line
+ * arguments have been parsed, so that they take precedence.
+ *
+ * The environment is scanned only once, no matter how many arguments declare
+ * an environment variable. Values are parsed like they are on the command line,
+ * except that boolean variables must be "true" or "false". String values
+ * borrowed from the environment are only valid until it is modified.
+ *
+ * @param args The array of arguments to set. This array should be
+ * null-terminated
+ * @param envp The environment, as a null-terminated array of "NAME=value"
+ * strings, or NULL to use `environ`
+ * @param error A pointer to a string that will be updated with an error message
+ * if a value is invalid. This string should be freed by the caller.
+ * @return true if every value was valid, false otherwise
+ */
+CLAPC_PUBLIC bool clapc_parse_env(
+  s_clap_arg* args[], char** envp, char** error);
+
+/**
+ * Sets the arguments that have no value yet from a config file. Each line of
+ * the file is either "key = value", a "[section]" header, a comment starting
+ * with "#" or ";", or blank. Keys are the long names of the arguments, and keys
+ * that follow a section header are prefixed by the name of the section and a
+ * dot (e.g. "port" under "[server]" is the argument "server.port"). Values may
+ * be surrounded by double quotes, and are parsed like they are on the command
+ * line, except that boolean values must be "true" or "false". If a key is
+ * repeated, the last value wins (or, for list arguments, every value is
+ * appended).
+ *
+ * This is meant to be called after the command-line arguments and the
+ * environment have been parsed, so that they take precedence over the file.
+ * Since required arguments have been checked by then, the file can't provide
+ * them.
+ * The file is mapped into memory and read in a single pass, and string values
+ * borrowed from it stay valid until the arguments are freed (see {@link
+ * s_clap_arg.files}).
+ *
+ * @param args The array of arguments to set. This array should be
+ * null-terminated
+ * @param path The path of the config file
+ * @param error A pointer to a string that will be updated with an error message
+ * if the file can't be read, has an unknown key or an invalid value. This
+ * string should be freed by the caller.
+ * @return true if the file was parsed successfully, false otherwise
+ */
+CLAPC_PUBLIC bool clapc_parse_config(
+  s_clap_arg* args[], const char* path, char** error);
+
+/**
+ * A compiled, immutable view of an array of arguments. Compiling a spec builds
+ * lookup tables for the long and short names of the arguments, so parsing does
+ * not have to scan the whole array for every token.
+ */
+typedef struct clapc_spec s_clapc_spec;
+
+/**
+ * Compiles an array of arguments into a spec. The array and the arguments in it
+ * must outlive the spec.
+ *
+ * @param args The array of arguments to compile. This array should be
+ * null-terminated
+ * @param error A pointer to a string that will be updated with an error message
+ * if the compilation fails (e.g. two arguments share a name). This string
+ * should be freed by the caller.
+ * @return The compiled spec, or NULL if the compilation failed. The spec should
+ * be freed with {@link clapc_spec_free}
+ */
+CLAPC_PUBLIC s_clapc_spec* clapc_spec_compile(s_clap_arg* args[], char** error);
+
+/**
+ * Parses the command-line arguments using a compiled spec. This function
+ * behaves exactly like {@link clapc_parse_safe} for the arguments the spec was
+ * compiled from.
+ *
+ * @param spec The compiled spec
+ * @param argv_ptr A pointer to the command-line arguments. This pointer will be
+ * updated to point to the next argument after the parsed arguments.
+ * @param error A pointer to a string that will be updated with an error message
+ * if the parsing fails. This string should be freed by the caller.
+ * @return true if the parsing was successful, false otherwise
+ */
+CLAPC_PUBLIC bool clapc_spec_parse(
+  const s_clapc_spec* spec, char*** argv_ptr, char** error);
+
+/**
+ * Parses the command-line arguments using a compiled spec, like {@link
+ * clapc_parse_checked}.
+ *
+ * @param spec The compiled spec
+ * @param argv_ptr A pointer to the command-line arguments. This pointer will be
+ * updated to point to the next argument after the parsed arguments.
+ * @param error Set to why the parsing failed, if it fails
+ * @return true if the parsing was successful, false otherwise
+ */
+CLAPC_PUBLIC bool clapc_spec_parse_checked(
+  const s_clapc_spec* spec, char*** argv_ptr, s_clapc_error* error);
+
+/**
+ * Parses the command-line arguments using a compiled spec, like {@link
+ * clapc_parse_with_allocator}.
+ *
+ * @param spec The compiled spec
+ * @param argv_ptr A pointer to the command-line arguments. This pointer will be
+ * updated to point to the next argument after the parsed arguments.
+ * @param allocator The allocator of the values, or NULL for malloc. It must
+ * outlive them
+ * @param error Set to why the parsing failed, if it fails
+ * @return true if the parsing was successful, false otherwise
+ */
+CLAPC_PUBLIC bool clapc_spec_parse_with_allocator(const s_clapc_spec* spec,
+  char*** argv_ptr, const s_clapc_allocator* allocator, s_clapc_error* error);
+
+/**
+ * The size of a cache line. Results are sized in whole cache lines, so that the
+ * results of different threads never share one.
+ */
+#define CLAPC_CACHE_LINE 64
+
+/**
+ * The value of an argument in a {@link s_clapc_result}. Which member is set
+ * depends on the type of the argument.
+ */
+typedef union {
+  /**
+   * CLAP_ARG_TYPE_BOOL
+   */
+  bool boolean;
+  /**
+   * CLAP_ARG_TYPE_INT and CLAP_ARG_TYPE_ENUM (the index of the choice)
+   */
+  int integer;
+  /**
+   * CLAP_ARG_TYPE_INT64
+   */
+  int64_t integer64;
+  /**
+   * CLAP_ARG_TYPE_UINT64, CLAP_ARG_TYPE_SIZE (in bytes) and
+   * CLAP_ARG_TYPE_DURATION (in nanoseconds)
+   */
+  uint64_t unsigned64;
+  /**
+   * CLAP_ARG_TYPE_DOUBLE
+   */
+  double real;
+  /**
+   * CLAP_ARG_TYPE_FLOAT
+   */
+  float number;
+  /**
+   * CLAP_ARG_TYPE_STRING. The string is always borrowed from argv.
+   * CLAP_ARG_TYPE_CUSTOM values are also kept as they were given (a result has
+   * nowhere to parse them into), after {@link s_clap_arg.parse} validated them.
+   */
+  s_clap_str string;
+  /**
+   * List types.
+   */
+  s_clap_list list;
+} CLAPC_PUBLIC s_clap_value;
+
+/**
+ * The values parsed by {@link clapc_spec_parse_result}. Unlike the other
+ * parsing functions, which store values in the arguments themselves, this
+ * keeps a spec (and its arguments) untouched, so that a single spec can be
+ * used to parse on many threads at once, each with its own result.
+ *
+ * The memory of a result is provided by the caller (see {@link
+ * clapc_result_init}), so it can live on the stack or in an arena.
+ */
+typedef struct {
+  /**
+   * The spec the result was initialized for.
+   */
+  const s_clapc_spec* spec;
+  /**
+   * The number of arguments in the spec.
+   */
+  size_t count;
+  /**
+   * The value of each argument, in the order of the arguments in the spec.
+   */
+  s_clap_value* values;
+  /**
+   * A bitset of the arguments that were given, see {@link clapc_result_has}.
+   */
+  uint64_t* present;
+  /**
+   * The allocator of the buffers of list values. This is NULL (malloc) after
+   * {@link clapc_result_init}, and may be set right after it. With an allocator
+   * that can't free, like that of an {@link s_clapc_arena}, the buffers are
+   * dropped instead of reused by the next parse, so the arena may be reset
+   * between parses and {@link clapc_result_free} isn't needed.
+   */
+  const s_clapc_allocator* allocator;
+  /**
+   * The response files loaded by the last parse into the result, which its
+   * string values and the arguments left after parsing may point into. They
+   * are released by the next parse into the result or by {@link
+   * clapc_result_free}.
+   */
+  s_clapc_response_file* files;
+} CLAPC_PUBLIC s_clapc_result;
+
+/**
+ * Whether the argument at `index` in the spec of a result was given.
+ *
+ * @param result The result
+ * @param index The index of the argument in the array the spec was compiled
+ * from
+ */
+#define clapc_result_has(result, index)                                        \
+  (((result)->present[(index) / 64] >> ((index) % 64)) & 1)
+
+/**
+ * Gets how many bytes of memory a result for `spec` needs. This is always a
+ * multiple of {@link CLAPC_CACHE_LINE}.
+ *
+ * @param spec The compiled spec
+ * @return The size of the memory, in bytes
+ */
+CLAPC_PUBLIC size_t clapc_result_size(const s_clapc_spec* spec);
+
+/**
+ * Initializes a result for `spec`.
+ *
+ * @param result The result to initialize
+ * @param spec The compiled spec
+ * @param memory At least {@link clapc_result_size} bytes of memory, aligned to
+ * {@link CLAPC_CACHE_LINE} bytes, which must outlive the result
+ */
+CLAPC_PUBLIC void clapc_result_init(
+  s_clapc_result* result, const s_clapc_spec* spec, void* memory);
+
+/**
+ * Parses the command-line arguments using a compiled spec, like {@link
+ * clapc_spec_parse}, but stores the values in `result` instead of the
+ * arguments. Nothing shared is written to, so any number of threads may parse
+ * with the same spec at once. Whatever `result` held before is discarded, but
+ * the buffers of its lists are reused. Response files loaded while parsing
+ * are kept on the result, see {@link s_clapc_result.files}.
+ *
+ * @param spec The compiled spec
+ * @param result A result initialized for `spec`
+ * @param argv_ptr A pointer to the command-line arguments. This pointer will be
+ * updated to point to the next argument after the parsed arguments.
+ * @param error A pointer to a string that will be updated with an error message
+ * if the parsing fails. This string should be freed by the caller.
+ * @return true if the parsing was successful, false otherwise
+ */
+CLAPC_PUBLIC bool clapc_spec_parse_result(const s_clapc_spec* spec,
+  s_clapc_result* result, char*** argv_ptr, char** error);
+
+/**
+ * Parses the command-line arguments into a result, like {@link
+ * clapc_spec_parse_result}, but reports why parsing failed like {@link
+ * clapc_parse_checked}. Together, any number of threads may parse untrusted
+ * command lines with one spec, and reject them without allocating.
+ *
+ * @param spec The compiled spec
+ * @param result A result initialized for `spec`
+ * @param argv_ptr A pointer to the command-line arguments. This pointer will be
+ * updated to point to the next argument after the parsed arguments.
+ * @param error Set to why the parsing failed, if it fails
+ * @return true if the parsing was successful, false otherwise
+ */
+CLAPC_PUBLIC bool clapc_spec_parse_result_checked(const s_clapc_spec* spec,
+  s_clapc_result* result, char*** argv_ptr, s_clapc_error* error);
+
+/**
+ * Parses a single command string using a compiled spec, like {@link
+ * clapc_spec_parse_result}. The string is split into tokens in place by {@link
+ * clapc_tokenize}, into a table provided by the caller, so nothing is allocated
+ * (except for list values). Unlike with argv, "@path" tokens are not expanded,
+ * since the string may not come from the user running the program.
+ *
+ * @param spec The compiled spec
+ * @param result A result initialized for `spec`
+ * @param buffer The command string, without a program name. `buffer[len]` must
+ * be writable.
+ * @param len The length of `buffer`
+ * @param argv_ptr A pointer to a table of `capacity` tokens. The first one is
+ * used for the program name. This pointer will be updated to point to the next
+ * token after the parsed arguments.
+ * @param capacity The number of entries in the table. One more than {@link
+ * CLAPC_TOKENIZE_CAPACITY} of `len` is always enough.
+ * @param error A pointer to a string that will be updated with an error message
+ * if the parsing fails. This string should be freed by the caller.
+ * @return true if the parsing was successful, false otherwise
+ */
+CLAPC_PUBLIC bool clapc_spec_parse_string(const s_clapc_spec* spec,
+  s_clapc_result* result, char* buffer, size_t len, char*** argv_ptr,
+  size_t capacity, char** error);
+
+/**
+ * Frees the buffers of the list values of a result, through {@link
+ * s_clapc_result.allocator}, and its response files. This does not free the
+ * memory of the result itself.
+ *
+ * @param result The result to free
+ */
+CLAPC_PUBLIC void clapc_result_free(s_clapc_result* result);
+
+/**
+ * The values parsed by {@link clapc_parse_batch} from many command lines, laid
+ * out in columns: one array of values (and one presence bitset) per argument,
+ * indexed by line. Lines that failed to parse have an error message and no
+ * values.
+ */
+typedef struct {
+  /**
+   * The spec the lines were parsed with.
+   */
+  const s_clapc_spec* spec;
+  /**
+   * The number of lines.
+   */
+  size_t count;
+  /**
+   * The values of each argument, in the order of the arguments in the spec:
+   * `columns[index][line]`.
+   */
+  s_clap_value** columns;
+  /**
+   * A bitset over the lines for each argument, see {@link clapc_batch_has}.
+   */
+  uint64_t** present;
+  /**
+   * The tokens left after parsing each line (its positional arguments), or
+   * NULL if the line failed to parse.
+   */
+  char*** rest;
+  /**
+   * The error message of each line, or NULL if it parsed.
+   */
+  char** errors;
+  /**
+   * The number of lines that failed to parse.
+   */
+  size_t error_count;
+  /**
+   * The token table of lines parsed by {@link clapc_parse_batch_lines}.
+   */
+  char** tokens;
+} CLAPC_PUBLIC s_clapc_batch;
+
+/**
+ * Whether the argument at `index` in the spec of a batch was given on `line`.
+ *
+ * @param batch The batch
+ * @param index The index of the argument in the array the spec was compiled
+ * from
+ * @param line The index of the line
+ */
+#define clapc_batch_has(batch, index, line)                                    \
+  (((batch)->present[index][(line) / 64] >> ((line) % 64)) & 1)
+
+/**
+ * Parses many command lines with the same spec, on `threads` threads at once.
+ * Lines are handed out in blocks of 64, and threads that run out of blocks
+ * steal half of what another thread has left. Only list values and error
+ * messages are allocated per line. The threads are started for each call and
+ * joined before it returns. Unlike argv, "@path" tokens are not expanded in
+ * batches.
+ *
+ * @param spec The compiled spec
+ * @param argvs The command lines. Like argv, each starts with the name of the
+ * program and ends with NULL.
+ * @param count The number of command lines
+ * @param threads How many threads to parse on, or 0 for one per online core
+ * @param batch The batch to store the values in. It must be freed with {@link
+ * clapc_batch_free}.
+ * @param error A pointer to a string that will be updated with an error message
+ * if the batch couldn't be set up. Errors in lines are stored in the batch.
+ * @return true if every line was parsed (successfully or not), false otherwise
+ */
+CLAPC_PUBLIC bool clapc_parse_batch(const s_clapc_spec* spec, char** argvs[],
+  size_t count, size_t threads, s_clapc_batch* batch, char** error);
+
+/**
+ * Like {@link clapc_parse_batch}, but the command lines are the lines of
+ * `buffer`, without program names. Each line is split into tokens in place,
+ * like a response file, so string values and the rest of each line point into
+ * `buffer`.
+ *
+ * @param spec The compiled spec
+ * @param buffer The newline-delimited command lines. `buffer[len]` must be
+ * writable.
+ * @param len The length of `buffer`
+ * @param threads How many threads to parse on, or 0 for one per online core
+ * @param batch The batch to store the values in. It must be freed with {@link
+ * clapc_batch_free}.
+ * @param error A pointer to a string that will be updated with an error message
+ * if the batch couldn't be set up. Errors in lines are stored in the batch.
+ * @return true if every line was parsed (successfully or not), false otherwise
+ */
+CLAPC_PUBLIC bool clapc_parse_batch_lines(const s_clapc_spec* spec,
+  char* buffer, size_t len, size_t threads, s_clapc_batch* batch,
+  char** error);
+
+/**
+ * Frees everything a batch allocated.
+ *
+ * @param batch The batch to free
+ */
+CLAPC_PUBLIC void clapc_batch_free(s_clapc_batch* batch);
+
+/**
+ * Frees a compiled spec. This does not free the arguments it was compiled from.
+ *
+ * @param spec The spec to free
+ */
+CLAPC_PUBLIC void clapc_spec_free(s_clapc_spec* spec);
+
+/**
+ * A command of a program with subcommands, e.g. "status" in "git status".
+ * Commands form a tree: the root is the program itself, and every command may
+ * have subcommands of its own.
+ */
+typedef struct clap_command {
+  /**
+   * The name of the command, e.g. "status". The name of the root command is
+   * not used.
+   */
+  const char* name;
+  /**
+   * A human-readable description of the command.
+   */
+  const char* description;
+  /**
+   * The arguments of the command. This array should be null-terminated, or
+   * NULL if the command takes no arguments.
+   */
+  s_clap_arg** args;
+  /**
+   * The subcommands of the command. This array should be null-terminated, or
+   * NULL if the command has no subcommands.
+   */
+  struct clap_command** commands;
+  /**
+   * The compiled spec of {@link args}. This is built the first time the
+   * command is chosen, so the arguments of commands that are never chosen are
+   * never compiled nor validated. It must be NULL initially.
+   */
+  s_clapc_spec* spec;
+  /**
+   * The lookup table for the names of {@link commands}. This is built the
+   * first time a subcommand of this command is looked up. It must be NULL
+   * initially.
+   */
+  struct clapc_command_index* index;
+} s_clap_command;
+
+/**
+ * Parses the command-line arguments of a program with subcommands. The
+ * arguments of the root command are parsed first, as in {@link
+ * clapc_spec_parse}. If the root command has subcommands, the next argument
+ * (if any) must be the name of one of them, whose own arguments are parsed
+ * next, and so on. Arguments that follow "--" are never commands.
+ *
+ * Only the commands that are chosen have their arguments compiled, so the cost
+ * of parsing doesn't depend on how many other commands there are.
+ *
+ * @param root The root command
+ * @param argv_ptr A pointer to the command-line arguments. This pointer will be
+ * updated to point to the next argument after the parsed arguments.
+ * @param command_ptr A pointer that will be set to the last command that was
+ * chosen. This is the root command if no subcommand was given
+ * @param error A pointer to a string that will be updated with an error message
+ * if the parsing fails. This string should be freed by the caller.
+ * @return true if the parsing was successful, false otherwise
+ */
+CLAPC_PUBLIC bool clapc_parse_command(s_clap_command* root, char*** argv_ptr,
+  s_clap_command** command_ptr, char** error);
+
+/**
+ * Frees the lookup tables built for a command and all of its subcommands. This
+ * does not free the values of their arguments, see {@link clapc_args_free}.
+ *
+ * @param command The command to free
+ */
+CLAPC_PUBLIC void clapc_command_free(s_clap_command* command);
+
+/**
+ * A change to the value of an argument, applied by {@link clapc_unparse}.
+ */
+typedef struct {
+  /**
+   * The argument to change, one of those being unparsed.
+   */
+  const s_clap_arg* arg;
+  /**
+   * The new value, as it would be given on the command line (e.g. "8", "a,b"
+   * for a list, or "true" for a boolean), or NULL to leave the argument out.
+   */
+  const char* value;
+} CLAPC_PUBLIC s_clapc_override;
+
+/**
+ * Gets how many bytes of memory {@link clapc_unparse} needs to turn `args`
+ * back into a command line.
+ *
+ * @param program_name The first token of the command line
+ * @param args The parsed arguments. This array should be null-terminated
+ * @param overrides The changes to make to the values of `args`, or NULL
+ * @param override_count The number of overrides
+ * @return The size of the memory in bytes, or 0 if the value of an argument
+ * can't be turned back into text. This is only the case for
+ * CLAP_ARG_TYPE_CUSTOM arguments that have a value and no override.
+ */
+CLAPC_PUBLIC size_t clapc_unparse_size(const char* program_name,
+  s_clap_arg* args[], const s_clapc_override* overrides,
+  size_t override_count);
+
+/**
+ * Turns parsed arguments (with some of their values changed, if needed) back
+ * into a canonical command line, e.g. to spawn a worker process with the
+ * options of its parent. The table of tokens and the tokens themselves are
+ * written to a single block of memory in a single pass, so that it can be
+ * allocated (and freed) at once.
+ *
+ * Arguments are written in the order of `args`, and only if they have a
+ * value. A value is written in the same token as the long name of its
+ * argument ("--jobs=4"), or in the token after its short name if it has no
+ * long name. Lists are written as a single comma-separated value, true
+ * booleans as a flag, and numbers as precisely as they are stored. Parsing
+ * the command line with {@link clapc_parse_safe} gives back the same values,
+ * unless a value of an option without a long name starts with "@" and names
+ * a readable response file.
+ *
+ * @param program_name The first token of the command line
+ * @param args The parsed arguments. This array should be null-terminated
+ * @param overrides The changes to make to the values of `args`, or NULL
+ * @param override_count The number of overrides
+ * @param memory The memory to write the command line to, aligned for a pointer
+ * @param size The size of `memory`, as returned by {@link clapc_unparse_size}
+ * for the same arguments and overrides
+ * @return The null-terminated command line, which points into `memory`, or
+ * NULL if {@link clapc_unparse_size} returns 0. Only `memory` itself is to be
+ * freed.
+ */
+CLAPC_PUBLIC char** clapc_unparse(const char* program_name, s_clap_arg* args[],
+  const s_clapc_override* overrides, size_t override_count, void* memory,
+  size_t size);
+
+/**
+ * The number of entries a token table needs for any string of `len` bytes, null
+ * terminator included.
+ */
+#define CLAPC_TOKENIZE_CAPACITY(len) ((len) / 2 + 2)
+
+/**
+ * Splits `buffer` in place into tokens, the way a shell would: tokens are
+ * separated by whitespace, a backslash escapes the next character, single
+ * quotes keep everything up to the next single quote, and double quotes do the
+ * same but still let a backslash escape a double quote or a backslash. Quotes
+ * and escapes are removed and every token is null-terminated in the buffer, so
+ * the tokens are a view of it and nothing is allocated.
+ *
+ * @param buffer The string to split. `buffer[len]` must be writable.
+ * @param len The length of `buffer`
+ * @param argv The table to store the tokens in, followed by NULL
+ * @param capacity The number of entries in `argv`, see {@link
+ * CLAPC_TOKENIZE_CAPACITY}
+ * @param count_ptr A pointer that will be updated with the number of tokens
+ * @param error A pointer to a string that will be updated with an error message
+ * if a quote is not terminated or the tokens don't fit in `argv`. This string
+ * should be freed by the caller.
+ * @return true if the string was split, false otherwise
+ */
+CLAPC_PUBLIC bool clapc_tokenize(char* buffer, size_t len, char** argv,
+  size_t capacity, size_t* count_ptr, char** error);
+
+/**
+ * The shells {@link clapc_completion_script} can write completion scripts for.
+ */
+typedef enum {
+  CLAPC_SHELL_BASH = 0,
+  CLAPC_SHELL_ZSH,
+  CLAPC_SHELL_FISH,
+} CLAPC_PUBLIC e_clapc_shell;
+
+/**
+ * Writes a completion script for the options of a program. The options are
+ * listed in the script itself, so completing them doesn't run the program.
+ *
+ * @param shell The shell to write the script for
+ * @param program_name The name of the program, as it is run
+ * @param args The array of arguments of the program. This array should be
+ * null-terminated
+ * @param len_ptr A pointer to a size_t that will be set to the length of the
+ * script
+ * @return The null-terminated script, or NULL if it couldn't be allocated. It
+ * should be freed by the caller.
+ */
+CLAPC_PUBLIC char* clapc_completion_script(e_clapc_shell shell,
+  const char* program_name, s_clap_arg* args[], size_t* len_ptr);
+
+/**
+ * Lists the options that complete `prefix`, one per line. A prefix starting
+ * with "--" completes long names, "-" followed by a character completes that
+ * short name, and "-" alone completes every option.
+ *
+ * @param args The array of arguments to complete. This array should be
+ * null-terminated
+ * @param prefix What has been typed so far
+ * @param len_ptr A pointer to a size_t that will be set to the length of the
+ * list
+ * @return The null-terminated list, or NULL if it couldn't be allocated. It
+ * should be freed by the caller.
+ */
+CLAPC_PUBLIC char* clapc_completions(
+  s_clap_arg* args[], const char* prefix, size_t* len_ptr);
+
+/**
+ * Answers completion requests. If the first argument in `argv` is the hidden
+ * option "--__complete", the options that complete the second argument (see
+ * {@link clapc_completions}) are written to stdout and the program exits.
+ * Otherwise, this does nothing.
+ *
+ * Call this first thing in main, so that completing doesn't wait for the rest
+ * of the program to start up.
+ *
+ * @param args The array of arguments to complete. This array should be
+ * null-terminated
+ * @param argv The command-line arguments, as given to main
+ */
+CLAPC_PUBLIC void clapc_complete(s_clap_arg* args[], char** argv);
+
+/**
+ * Counters and timings of the work done by clapc, e.g. to export to a metrics
+ * pipeline. Statistics are only collected if clapc was built with CLAPC_STATS
+ * defined (the "stats" meson option). Otherwise, they cost nothing and are
+ * always zero.
+ *
+ * Statistics are kept per thread, and accumulate until {@link
+ * clapc_stats_reset} is called.
+ */
+typedef struct {
+  /**
+   * How many times argv was parsed (by {@link clapc_parse_safe} or {@link
+   * clapc_spec_parse}, directly or not).
+   */
+  uint64_t parses;
+  /**
+   * How many of those parses failed.
+   */
+  uint64_t failures;
+  /**
+   * How many tokens of argv (and of response files) were consumed.
+   */
+  uint64_t tokens;
+  /**
+   * How many entries were looked at to find arguments and commands by name.
+   * This is one per argument for uncompiled arguments, and one per hash table
+   * slot otherwise. Looking for a name to suggest instead of an unknown one
+   * isn't counted.
+   */
+  uint64_t lookup_probes;
+  /**
+   * How many bytes of strings were copied, including bytes moved in place to
+   * remove quotes from response files.
+   */
+  uint64_t bytes_copied;
+  /**
+   * How many times memory was allocated while parsing.
+   */
+  uint64_t allocations;
+  /**
+   * Nanoseconds spent loading and tokenizing response files.
+   */
+  uint64_t tokenize_ns;
+  /**
+   * Nanoseconds spent looking up arguments by name in argv.
+   */
+  uint64_t lookup_ns;
+  /**
+   * Nanoseconds spent converting and storing values from argv.
+   */
+  uint64_t convert_ns;
+  /**
+   * Nanoseconds spent compiling specs and checking constraints.
+   */
+  uint64_t validate_ns;
+} CLAPC_PUBLIC s_clapc_stats;
+
+/**
+ * Gets the statistics of the calling thread.
+ *
+ * @param out Where to store the statistics. It is zeroed if statistics are not
+ * collected
+ * @return true if clapc was built with statistics, false otherwise
+ */
+CLAPC_PUBLIC bool clapc_stats_get(s_clapc_stats* out);
+
+/**
+ * Resets the statistics of the calling thread to zero.
+ */
+CLAPC_PUBLIC void clapc_stats_reset(void);
+
+/**
+ * Frees the memory allocated for an argument, through the allocator it came
+ * from. Memory from an allocator that can't free, like that of an {@link
+ * s_clapc_arena}, is only forgotten. If it is the first argument of an array,
+ * this also releases the response files and config files loaded while parsing
+ * the array (see {@link s_clap_arg.files}).
+ *
+ * @param arg The argument to free
+ */
+CLAPC_PUBLIC __attribute__((nonnull)) void clapc_arg_free(s_clap_arg* arg);
+
+/**
+ * Frees the memory allocated for an array of arguments.
+ *
+ * @param args The array of arguments to free
+ */
+CLAPC_PUBLIC void clapc_args_free(s_clap_arg* args[]);
+
+/**
+ * Prints the help message for the program. This function takes the program name
+ * and description, as well as an array of arguments, and prints a help message
+ * that describes the program and the arguments that it accepts.
+ *
+ * The message is wrapped to the width of the terminal and written to stdout at
+ * once, see {@link clapc_format_help}.
+ *
+ * @param program_name The name of the program
+ * @param description A description of the program
+ * @param args An array of arguments that the program accepts
+ */
+CLAPC_PUBLIC void clapc_print_help(
+  const char* program_name, const char* description, s_clap_arg* args[]);
+
+/**
+ * Prints the help message for the program to `stream`, like {@link
+ * clapc_print_help} does to stdout. Anything buffered in `stream` is flushed
+ * first, and the message is then written with as few write() calls as possible.
+ *
+ * @param stream The stream to print to
+ * @param program_name The name of the program
+ * @param description A description of the program
+ * @param args An array of arguments that the program accepts
+ */
+CLAPC_PUBLIC void clapc_fprint_help(FILE* stream, const char* program_name,
+  const char* description, s_clap_arg* args[]);
+
+/**
+ * Formats the help message printed by {@link clapc_print_help} into a single
+ * buffer. Options are followed by a placeholder for their value (e.g. "--jobs
+ * <int>"), and descriptions are wrapped at word boundaries to fit in `width`
+ * columns. Since nothing is measured again, the result can be kept and written
+ * out as many times as needed.
+ *
+ * @param program_name The name of the program
+ * @param description A description of the program
+ * @param args An array of arguments that the program accepts
+ * @param width The width to wrap the message to, or 0 to use the width of the
+ * terminal (or $COLUMNS, or 80)
+ * @param len_ptr A pointer to a size_t that will be set to the length of the
+ * message
+ * @return The null-terminated message, or NULL if it couldn't be allocated. It
+ * should be freed by the caller.
+ */
+CLAPC_PUBLIC char* clapc_format_help(const char* program_name,
+  const char* description, s_clap_arg* args[], size_t width, size_t* len_ptr);
+
+/**
+ * Formats the help message like {@link clapc_format_help}, into memory from
+ * `allocator`.
+ *
+ * @param program_name The name of the program
+ * @param description A description of the program
+ * @param args An array of arguments that the program accepts
+ * @param width The width to wrap the message to, or 0 to use the width of the
+ * terminal (or $COLUMNS, or 80)
+ * @param allocator The allocator of the message, or NULL for malloc
+ * @param len_ptr A pointer to a size_t that will be set to the length of the
+ * message
+ * @return The null-terminated message, or NULL if it couldn't be allocated. It
+ * is exactly `*len_ptr + 1` bytes from `allocator`, which is the size to free.
+ */
+CLAPC_PUBLIC char* clapc_format_help_with_allocator(const char* program_name,
+  const char* description, s_clap_arg* args[], size_t width,
+  const s_clapc_allocator* allocator, size_t* len_ptr);
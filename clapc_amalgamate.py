@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+"""Combine clapc.h and clapc.c into a single header.
+
+The single header declares the API like clapc.h does. In exactly one source
+file of a program, define CLAPC_IMPLEMENTATION before including it (and before
+any other header) to also compile the implementation there:
+
+    #define CLAPC_IMPLEMENTATION
+    #include "clapc_single.h"
+
+Since the implementation is then part of the program itself, nothing is left
+to resolve when it starts, and the compiler may inline the parser into its
+callers.
+
+Usage: clapc_amalgamate.py HEADER SOURCE OUTPUT
+"""
+
+import argparse
+import re
+import sys
+
+# The implementation includes the header, which is already above it
+SELF_INCLUDE = re.compile(r'^#include\s+["<]clapc\.h[">]\s*$')
+
+
+def amalgamate(header, source):
+    source_lines = source.splitlines()
+    kept = [line for line in source_lines if not SELF_INCLUDE.match(line)]
+    if len(kept) == len(source_lines):
+        sys.exit("the source doesn't include clapc.h")
+
+    return "\n".join(
+        [
+            "// This file was generated by clapc_amalgamate.py. Do not edit.",
+            header.rstrip("\n"),
+            "",
+            "#ifdef CLAPC_IMPLEMENTATION",
+            *kept,
+            "#endif // CLAPC_IMPLEMENTATION",
+            "",
+        ]
+    )
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("header", help="clapc.h")
+    parser.add_argument("source", help="clapc.c")
+    parser.add_argument("output", help="the single header to write")
+    args = parser.parse_args()
+
+    with open(args.header, encoding="utf-8") as f:
+        header = f.read()
+    with open(args.source, encoding="utf-8") as f:
+        source = f.read()
+
+    with open(args.output, "w", encoding="utf-8") as f:
+        f.write(amalgamate(header, source))
+
+
+if __name__ == "__main__":
+    main()
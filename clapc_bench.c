@@ -0,0 +1,1302 @@
+#include <clapc.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "clapc_gen_bench.h"
+
+#define CTEST_COUNT_ALLOCATIONS
+#include "ctest.h"
+
+// Helpers =====================================================================
+
+#define NUMBER_COUNT 1000000
+
+/**
+ * A small deterministic PRNG, so that every run benchmarks the same inputs.
+ */
+static uint64_t next_random(uint64_t* state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+/**
+ * Generate `count` null-terminated numbers in a single buffer. Integers are
+ * what you'd pass as counts and sizes; floats are ratios, timeouts and the
+ * occasional number in scientific notation.
+ */
+static char** generate_numbers(size_t count, bool floating)
+{
+  char** numbers = malloc(count * sizeof(char*));
+  char* buffer = malloc(count * 32);
+  uint64_t state = 0x9e3779b97f4a7c15ull;
+
+  for (size_t i = 0; i < count; i++) {
+    numbers[i] = buffer + i * 32;
+    uint64_t r = next_random(&state);
+    if (!floating) {
+      snprintf(numbers[i], 32, "%lld", (long long)(r % 2000000) - 1000000);
+    } else if (r % 4 == 0) {
+      snprintf(numbers[i], 32, "%.3e", (double)(r % 100000) / 7.0);
+    } else {
+      snprintf(numbers[i], 32, "%.*f", (int)(r % 6),
+        (double)(r % 1000000) / 1000.0);
+    }
+  }
+
+  return numbers;
+}
+
+static void free_numbers(char** numbers)
+{
+  free(numbers[0]);
+  free(numbers);
+}
+
+/**
+ * The kinds of options a synthetic spec is made of.
+ */
+typedef enum {
+  MIX_BOOL = 0,
+  MIX_INT,
+  MIX_FLOAT,
+  MIX_STRING,
+  MIX_BORROWED_STRING,
+  MIX_MIXED,
+} e_mix;
+
+static const char* mix_names[] = {
+  [MIX_BOOL] = "bool",
+  [MIX_INT] = "int",
+  [MIX_FLOAT] = "float",
+  [MIX_STRING] = "string",
+  [MIX_BORROWED_STRING] = "borrowed string",
+  [MIX_MIXED] = "mixed",
+};
+
+/**
+ * A generated set of options, along with the "--name" token of each of them.
+ */
+typedef struct {
+  s_clap_arg* args;
+  s_clap_arg** table;
+  char** tokens;
+  char* names;
+  size_t count;
+} s_synthetic_spec;
+
+static s_synthetic_spec generate_spec(size_t count, e_mix mix)
+{
+  s_synthetic_spec spec = {
+    .args = malloc(count * sizeof(s_clap_arg)),
+    .table = malloc((count + 1) * sizeof(s_clap_arg*)),
+    .tokens = malloc(count * sizeof(char*)),
+    .names = malloc(count * 24),
+    .count = count,
+  };
+
+  for (size_t i = 0; i < count; i++) {
+    char* token = spec.names + i * 24;
+    snprintf(token, 24, "--option-%05u", (unsigned)i);
+
+    e_mix kind = mix == MIX_MIXED ? (e_mix)(i % MIX_BORROWED_STRING) : mix;
+    e_clap_arg_type type = kind == MIX_BOOL ? CLAP_ARG_TYPE_BOOL
+      : kind == MIX_INT                     ? CLAP_ARG_TYPE_INT
+      : kind == MIX_FLOAT                   ? CLAP_ARG_TYPE_FLOAT
+                                            : CLAP_ARG_TYPE_STRING;
+
+    // The fields of s_clap_arg are const, so they can only be initialized
+    memcpy(&spec.args[i],
+      &(s_clap_arg) {
+        .name = token + 2,
+        .type = type,
+        .borrow = kind == MIX_BORROWED_STRING,
+      },
+      sizeof(s_clap_arg));
+
+    spec.table[i] = &spec.args[i];
+    spec.tokens[i] = token;
+  }
+  spec.table[count] = NULL;
+
+  return spec;
+}
+
+static void free_spec(s_synthetic_spec* spec)
+{
+  clapc_args_free(spec->table);
+  free(spec->args);
+  free(spec->table);
+  free(spec->tokens);
+  free(spec->names);
+}
+
+/**
+ * Generate an argv of (about) `token_count` tokens using random options of
+ * `spec`. If `positionals` is not zero, the options are followed by "--" (if
+ * `double_dash` is true) and that many positional arguments.
+ */
+static char** generate_argv(const s_synthetic_spec* spec, size_t token_count,
+  size_t positionals, bool double_dash)
+{
+  char** argv = malloc((token_count + positionals + 3) * sizeof(char*));
+  uint64_t state = 0x2545f4914f6cdd1dull;
+  size_t n = 0;
+
+  argv[n++] = "clapc_bench";
+  while (n <= token_count) {
+    size_t i = next_random(&state) % spec->count;
+    argv[n++] = spec->tokens[i];
+    switch (spec->args[i].type) {
+    case CLAP_ARG_TYPE_INT:
+      argv[n++] = "12345";
+      break;
+    case CLAP_ARG_TYPE_FLOAT:
+      argv[n++] = "0.25";
+      break;
+    case CLAP_ARG_TYPE_STRING:
+      argv[n++] = "/usr/local/share/clapc/some/path";
+      break;
+    default:
+      break;
+    }
+  }
+
+  if (positionals > 0 && double_dash) {
+    argv[n++] = "--";
+  }
+  for (size_t i = 0; i < positionals; i++) {
+    argv[n++] = "positional";
+  }
+  argv[n] = NULL;
+
+  return argv;
+}
+
+/**
+ * Benchmark parsing `argv` with and without a compiled spec. The uncompiled
+ * path is skipped when scanning every option for every token would take too
+ * long to be useful.
+ */
+static void bench_parse(const char* label, s_synthetic_spec* spec, char** argv)
+{
+  size_t token_count = 0;
+  while (argv[token_count + 1] != NULL) {
+    token_count++;
+  }
+
+  char name[128];
+  char* error;
+  char** argv_ptr;
+
+  if (spec->count * token_count <= 100000000) {
+    snprintf(name, sizeof(name), "clapc_parse_safe, %s", label);
+    bench(name, token_count, {
+      argv_ptr = argv;
+      if (!clapc_parse_safe(spec->table, &argv_ptr, &error)) {
+        fprintf(stderr, "%s", error);
+        abort();
+      }
+    });
+  }
+
+  s_clapc_spec* compiled = clapc_spec_compile(spec->table, &error);
+  snprintf(name, sizeof(name), "clapc_spec_parse, %s", label);
+  bench(name, token_count, {
+    argv_ptr = argv;
+    if (!clapc_spec_parse(compiled, &argv_ptr, &error)) {
+      fprintf(stderr, "%s", error);
+      abort();
+    }
+  });
+  clapc_spec_free(compiled);
+}
+
+// Benchmarks ==================================================================
+
+static void bench_numbers(void)
+{
+  char** integers = generate_numbers(NUMBER_COUNT, false);
+  char** doubles = generate_numbers(NUMBER_COUNT, true);
+  volatile int64_t integer_sink = 0;
+  volatile double double_sink = 0;
+
+  bench("strtol", NUMBER_COUNT, {
+    for (size_t i = 0; i < NUMBER_COUNT; i++) {
+      integer_sink += strtol(integers[i], NULL, 10);
+    }
+  });
+
+  bench("clapc_parse_number (int64)", NUMBER_COUNT, {
+    for (size_t i = 0; i < NUMBER_COUNT; i++) {
+      int64_t value;
+      clapc_parse_number(
+        integers[i], strlen(integers[i]), CLAPC_NUMBER_INT64, &value);
+      integer_sink += value;
+    }
+  });
+
+  bench("strtod", NUMBER_COUNT, {
+    for (size_t i = 0; i < NUMBER_COUNT; i++) {
+      double_sink += strtod(doubles[i], NULL);
+    }
+  });
+
+  bench("clapc_parse_number (double)", NUMBER_COUNT, {
+    for (size_t i = 0; i < NUMBER_COUNT; i++) {
+      double value;
+      clapc_parse_number(
+        doubles[i], strlen(doubles[i]), CLAPC_NUMBER_DOUBLE, &value);
+      double_sink += value;
+    }
+  });
+
+  free_numbers(integers);
+  free_numbers(doubles);
+}
+
+/**
+ * How parsing scales with the number of options and the number of tokens.
+ */
+static void bench_scaling(void)
+{
+  const size_t option_counts[] = { 10, 100, 1000, 10000 };
+  const size_t token_counts[] = { 10, 1000, 100000, 1000000 };
+
+  for (size_t i = 0; i < sizeof(option_counts) / sizeof(size_t); i++) {
+    s_synthetic_spec spec = generate_spec(option_counts[i], MIX_MIXED);
+
+    for (size_t j = 0; j < sizeof(token_counts) / sizeof(size_t); j++) {
+      char** argv = generate_argv(&spec, token_counts[j], 0, false);
+      char label[96];
+      snprintf(label, sizeof(label), "%zu options, %zu tokens (mixed)",
+        option_counts[i], token_counts[j]);
+      bench_parse(label, &spec, argv);
+      free(argv);
+    }
+
+    free_spec(&spec);
+  }
+}
+
+/**
+ * The cost of each type of value.
+ */
+static void bench_mixes(void)
+{
+  for (e_mix mix = MIX_BOOL; mix <= MIX_MIXED; mix++) {
+    s_synthetic_spec spec = generate_spec(1000, mix);
+    char** argv = generate_argv(&spec, 100000, 0, false);
+
+    char label[96];
+    snprintf(label, sizeof(label), "1000 options, 100000 tokens (%s)",
+      mix_names[mix]);
+    bench_parse(label, &spec, argv);
+
+    free(argv);
+    free_spec(&spec);
+  }
+}
+
+/**
+ * Parsing stops at "--" or the first positional argument.
+ */
+static void bench_positionals(void)
+{
+  s_synthetic_spec spec = generate_spec(1000, MIX_MIXED);
+
+  char** argv = generate_argv(&spec, 100000, 100000, true);
+  bench_parse("1000 options, 100000 tokens, \"--\" and 100000 positionals",
+    &spec, argv);
+  free(argv);
+
+  argv = generate_argv(&spec, 100000, 100000, false);
+  bench_parse(
+    "1000 options, 100000 tokens and 100000 positionals", &spec, argv);
+  free(argv);
+
+  free_spec(&spec);
+}
+
+/**
+ * A parser generated by clapc_gen.py against the interpreted parsers, with the
+ * same options.
+ */
+static void bench_generated(void)
+{
+  enum { TOKENS = 100000 };
+
+  size_t count = 0;
+  while (gen_bench_args[count] != NULL) {
+    count++;
+  }
+
+  char** argv = malloc((TOKENS + 3) * sizeof(char*));
+  char* names = malloc(count * 64);
+  uint64_t state = 0x2545f4914f6cdd1dull;
+  size_t n = 0;
+
+  argv[n++] = "clapc_bench";
+  while (n <= TOKENS) {
+    size_t i = next_random(&state) % count;
+    char* token = names + i * 64;
+    snprintf(token, 64, "--%s", gen_bench_args[i]->name);
+    argv[n++] = token;
+    switch (gen_bench_args[i]->type) {
+    case CLAP_ARG_TYPE_INT:
+      argv[n++] = "12345";
+      break;
+    case CLAP_ARG_TYPE_FLOAT:
+      argv[n++] = "0.25";
+      break;
+    case CLAP_ARG_TYPE_STRING:
+      argv[n++] = "/usr/local/share/clapc/some/path";
+      break;
+    default:
+      break;
+    }
+  }
+  argv[n] = NULL;
+
+  char label[96];
+  snprintf(label, sizeof(label), "%zu options, %zu tokens (mixed)", count,
+    n - 1);
+
+  char* error;
+  char** argv_ptr;
+  s_clapc_spec* spec = clapc_spec_compile(gen_bench_args, &error);
+
+  char name[128];
+  snprintf(name, sizeof(name), "clapc_parse_safe, %s", label);
+  bench(name, n - 1, {
+    argv_ptr = argv;
+    if (!clapc_parse_safe(gen_bench_args, &argv_ptr, &error)) {
+      fprintf(stderr, "%s", error);
+      abort();
+    }
+  });
+
+  snprintf(name, sizeof(name), "clapc_spec_parse, %s", label);
+  bench(name, n - 1, {
+    argv_ptr = argv;
+    if (!clapc_spec_parse(spec, &argv_ptr, &error)) {
+      fprintf(stderr, "%s", error);
+      abort();
+    }
+  });
+
+  s_gen_bench_options options;
+  snprintf(name, sizeof(name), "generated parser, %s", label);
+  bench(name, n - 1, {
+    argv_ptr = argv;
+    if (!gen_bench_parse(&options, &argv_ptr, &error)) {
+      fprintf(stderr, "%s", error);
+      abort();
+    }
+  });
+
+  clapc_spec_free(spec);
+  clapc_args_free(gen_bench_args);
+  free(names);
+  free(argv);
+}
+
+/**
+ * Running one command of a program with many commands, each of them with many
+ * options. Only the chosen command should be compiled.
+ */
+static void bench_subcommands(void)
+{
+  enum { COMMANDS = 40, OPTIONS = 500 };
+
+  s_synthetic_spec specs[COMMANDS];
+  s_clap_command commands[COMMANDS];
+  s_clap_command* table[COMMANDS + 1];
+  char names[COMMANDS][16];
+
+  for (size_t i = 0; i < COMMANDS; i++) {
+    specs[i] = generate_spec(OPTIONS, MIX_MIXED);
+    snprintf(names[i], sizeof(names[i]), "command-%02u", (unsigned)i);
+    commands[i] = (s_clap_command) {
+      .name = names[i],
+      .args = specs[i].table,
+    };
+    table[i] = &commands[i];
+  }
+  table[COMMANDS] = NULL;
+
+  s_clap_command root = { .commands = table };
+  char* argv[] = { "clapc_bench", names[COMMANDS / 2], "--option-00007",
+    "positional", NULL };
+
+  char* error;
+  char** argv_ptr;
+  s_clap_command* command;
+
+  bench("clapc_parse_command, 40 commands of 500 options (cold)", 1, {
+    argv_ptr = argv;
+    if (!clapc_parse_command(&root, &argv_ptr, &command, &error)) {
+      fprintf(stderr, "%s", error);
+      abort();
+    }
+    clapc_command_free(&root);
+  });
+
+  bench("clapc_parse_command, 40 commands of 500 options (warm)", 1, {
+    argv_ptr = argv;
+    if (!clapc_parse_command(&root, &argv_ptr, &command, &error)) {
+      fprintf(stderr, "%s", error);
+      abort();
+    }
+  });
+  clapc_command_free(&root);
+
+  // What it would cost to compile every command up front
+  bench("clapc_spec_compile, 40 commands of 500 options", 1, {
+    for (size_t i = 0; i < COMMANDS; i++) {
+      clapc_spec_free(clapc_spec_compile(specs[i].table, &error));
+    }
+  });
+
+  for (size_t i = 0; i < COMMANDS; i++) {
+    free_spec(&specs[i]);
+  }
+}
+
+/**
+ * Reading many options from the environment in one scan, against calling
+ * getenv for each of them.
+ */
+static void bench_env(void)
+{
+  enum { OPTIONS = 500 };
+
+  s_clap_arg* args = malloc(OPTIONS * sizeof(s_clap_arg));
+  s_clap_arg* table[OPTIONS + 1];
+  char (*names)[24] = malloc(OPTIONS * sizeof(*names));
+  int* values = malloc(OPTIONS * sizeof(int));
+
+  for (size_t i = 0; i < OPTIONS; i++) {
+    snprintf(names[i], sizeof(names[i]), "CLAPC_OPTION_%05u", (unsigned)i);
+    memcpy(&args[i],
+      &(s_clap_arg) {
+        .name = names[i],
+        .type = CLAP_ARG_TYPE_INT,
+        .dest = &values[i],
+        .env = names[i],
+      },
+      sizeof(s_clap_arg));
+    table[i] = &args[i];
+    // Only half of the options are set
+    if (i % 2 == 0) {
+      setenv(names[i], "12345", 1);
+    }
+  }
+  table[OPTIONS] = NULL;
+
+  char* error;
+
+  bench("getenv, 500 options", OPTIONS, {
+    for (size_t i = 0; i < OPTIONS; i++) {
+      const char* value = getenv(names[i]);
+      if (value) {
+        clapc_parse_number(
+          value, strlen(value), CLAPC_NUMBER_INT32, &values[i]);
+      }
+    }
+  });
+
+  bench("clapc_parse_env, 500 options", OPTIONS, {
+    if (!clapc_parse_env(table, NULL, &error)) {
+      fprintf(stderr, "%s", error);
+      abort();
+    }
+    // Values are only set once, so forget them for the next repetition
+    clapc_args_free(table);
+  });
+
+  for (size_t i = 0; i < OPTIONS; i++) {
+    unsetenv(names[i]);
+  }
+  free(args);
+  free(names);
+  free(values);
+}
+
+/**
+ * How reading a config file scales with the number of keys in it.
+ */
+static void bench_config(void)
+{
+  const size_t key_counts[] = { 100, 1000, 10000, 100000 };
+
+  for (size_t i = 0; i < sizeof(key_counts) / sizeof(size_t); i++) {
+    s_synthetic_spec spec = generate_spec(key_counts[i], MIX_INT);
+
+    char path[] = "/tmp/clapc_bench_XXXXXX";
+    FILE* file = fdopen(mkstemp(path), "w");
+    for (size_t j = 0; j < spec.count; j++) {
+      fprintf(file, "%s = %zu\n", spec.tokens[j] + 2, j);
+    }
+    fclose(file);
+
+    char name[96];
+    snprintf(name, sizeof(name), "clapc_parse_config, %zu keys", key_counts[i]);
+
+    char* error;
+    bench(name, spec.count, {
+      if (!clapc_parse_config(spec.table, path, &error)) {
+        fprintf(stderr, "%s", error);
+        abort();
+      }
+      // Values are only set once, so forget them (and the mapping) for the
+      // next repetition
+      clapc_args_free(spec.table);
+    });
+
+    unlink(path);
+    free_spec(&spec);
+  }
+}
+
+/**
+ * Formatting the help message of a program with many options.
+ */
+static void bench_help(void)
+{
+  s_synthetic_spec spec = generate_spec(500, MIX_MIXED);
+
+  bench("clapc_format_help, 500 options", 500, {
+    size_t len;
+    free(clapc_format_help("clapc_bench", "A program with many options.",
+      spec.table, 80, &len));
+  });
+
+  free_spec(&spec);
+}
+
+/**
+ * The latency of answering a completion request for programs with thousands of
+ * options.
+ */
+static void bench_completion(void)
+{
+  const size_t option_counts[] = { 1000, 10000 };
+
+  for (size_t i = 0; i < sizeof(option_counts) / sizeof(size_t); i++) {
+    s_synthetic_spec spec = generate_spec(option_counts[i], MIX_MIXED);
+
+    char name[96];
+    snprintf(name, sizeof(name), "clapc_completions, %zu options",
+      option_counts[i]);
+
+    // This matches 100 options
+    bench(name, 1, {
+      size_t len;
+      free(clapc_completions(spec.table, "--option-001", &len));
+    });
+
+    free_spec(&spec);
+  }
+}
+
+/**
+ * What every thread of bench_results works on.
+ */
+typedef struct {
+  s_clapc_spec* spec;
+  char** argv;
+  size_t iterations;
+} s_result_job;
+
+static void* parse_results(void* data)
+{
+  s_result_job* job = data;
+  s_clapc_result result;
+  char* error;
+
+  clapc_result_init(&result, job->spec,
+    aligned_alloc(CLAPC_CACHE_LINE, clapc_result_size(job->spec)));
+
+  for (size_t i = 0; i < job->iterations; i++) {
+    char** argv_ptr = job->argv;
+    if (!clapc_spec_parse_result(job->spec, &result, &argv_ptr, &error)) {
+      fprintf(stderr, "%s", error);
+      abort();
+    }
+  }
+
+  clapc_result_free(&result);
+  free(result.values);
+  return NULL;
+}
+
+/**
+ * Many threads parsing with one shared spec, each into its own result. The
+ * time per token should stay flat as threads are added, up to the number of
+ * cores.
+ */
+static void bench_results(void)
+{
+  const size_t thread_counts[] = { 1, 2, 4, 8 };
+  const size_t iterations = 1000;
+
+  s_synthetic_spec spec = generate_spec(100, MIX_MIXED);
+  char** argv = generate_argv(&spec, 100, 0, false);
+  char* error;
+  s_clapc_spec* compiled = clapc_spec_compile(spec.table, &error);
+
+  for (size_t i = 0; i < sizeof(thread_counts) / sizeof(size_t); i++) {
+    size_t count = thread_counts[i];
+    pthread_t threads[8];
+    s_result_job job = {
+      .spec = compiled,
+      .argv = argv,
+      .iterations = iterations,
+    };
+
+    char name[96];
+    snprintf(name, sizeof(name), "clapc_spec_parse_result, %zu thread%s",
+      count, count == 1 ? "" : "s");
+
+    bench(name, count * iterations * 100, {
+      for (size_t t = 0; t < count; t++) {
+        pthread_create(&threads[t], NULL, parse_results, &job);
+      }
+      for (size_t t = 0; t < count; t++) {
+        pthread_join(threads[t], NULL);
+      }
+    });
+  }
+
+  clapc_spec_free(compiled);
+  free(argv);
+  free_spec(&spec);
+}
+
+/**
+ * Validating a manifest of many short command lines: a serial loop over
+ * clapc_parse_safe against batches of argv vectors and of text lines.
+ */
+static void bench_batch(void)
+{
+  const size_t line_count = 100000;
+
+  s_synthetic_spec spec = generate_spec(20, MIX_MIXED);
+  char** argv = generate_argv(&spec, 8, 1, false);
+  char* error;
+  s_clapc_spec* compiled = clapc_spec_compile(spec.table, &error);
+
+  size_t token_count = 0;
+  while (argv[token_count + 1] != NULL) {
+    token_count++;
+  }
+
+  // Every line is the same, but that doesn't matter to the parser
+  char*** argvs = malloc(line_count * sizeof(char**));
+  for (size_t i = 0; i < line_count; i++) {
+    argvs[i] = argv;
+  }
+
+  size_t line_len = 0;
+  for (size_t i = 1; argv[i]; i++) {
+    line_len += strlen(argv[i]) + 1;
+  }
+  char* text = malloc(line_count * line_len + 1);
+  char* buffer = malloc(line_count * line_len + 1);
+  char* write = text;
+  for (size_t i = 0; i < line_count; i++) {
+    for (size_t j = 1; argv[j]; j++) {
+      write = stpcpy(write, argv[j]);
+      *write++ = argv[j + 1] ? ' ' : '\n';
+    }
+  }
+  size_t len = (size_t)(write - text);
+
+  bench("clapc_parse_safe, serial loop", line_count * token_count, {
+    for (size_t i = 0; i < line_count; i++) {
+      char** argv_ptr = argvs[i];
+      if (!clapc_parse_safe(spec.table, &argv_ptr, &error)) {
+        fprintf(stderr, "%s", error);
+        abort();
+      }
+    }
+  });
+
+  const size_t thread_counts[] = { 1, 0 };
+  for (size_t i = 0; i < sizeof(thread_counts) / sizeof(size_t); i++) {
+    char name[96];
+    s_clapc_batch batch;
+
+    snprintf(name, sizeof(name), "clapc_parse_batch, %s",
+      thread_counts[i] ? "1 thread" : "all cores");
+    bench(name, line_count * token_count, {
+      if (!clapc_parse_batch(compiled, argvs, line_count, thread_counts[i],
+            &batch, &error)
+        || batch.error_count > 0) {
+        abort();
+      }
+      clapc_batch_free(&batch);
+    });
+
+    // Lines are split in place, so every repetition needs a fresh copy
+    snprintf(name, sizeof(name), "clapc_parse_batch_lines, %s",
+      thread_counts[i] ? "1 thread" : "all cores");
+    bench(name, line_count * token_count, {
+      memcpy(buffer, text, len);
+      if (!clapc_parse_batch_lines(
+            compiled, buffer, len, thread_counts[i], &batch, &error)
+        || batch.error_count > 0) {
+        abort();
+      }
+      clapc_batch_free(&batch);
+    });
+  }
+
+  clapc_spec_free(compiled);
+  free(text);
+  free(buffer);
+  free(argvs);
+  free(argv);
+  free_spec(&spec);
+}
+
+/**
+ * Splitting and parsing command strings, as a REPL or an RPC server would.
+ */
+static void bench_strings(void)
+{
+  s_synthetic_spec spec = generate_spec(100, MIX_MIXED);
+  char** argv = generate_argv(&spec, 10000, 0, false);
+  char* error;
+  s_clapc_spec* compiled = clapc_spec_compile(spec.table, &error);
+
+  // Quote every other value, so that both kinds of tokens are scanned
+  size_t len = 0;
+  size_t token_count = 0;
+  for (size_t i = 1; argv[i]; i++) {
+    len += strlen(argv[i]) + 3;
+    token_count++;
+  }
+  char* text = malloc(len + 1);
+  char* buffer = malloc(len + 1);
+  char* write = text;
+  for (size_t i = 1; argv[i]; i++) {
+    write += sprintf(write, i % 4 == 2 ? "'%s' " : "%s ", argv[i]);
+  }
+  len = (size_t)(write - text);
+
+  size_t capacity = CLAPC_TOKENIZE_CAPACITY(len) + 1;
+  char** table = malloc(capacity * sizeof(char*));
+
+  bench("clapc_tokenize, 10000 tokens", token_count, {
+    size_t count;
+    memcpy(buffer, text, len);
+    if (!clapc_tokenize(buffer, len, table, capacity, &count, &error)) {
+      abort();
+    }
+  });
+
+  s_clapc_result result;
+  clapc_result_init(&result, compiled,
+    aligned_alloc(CLAPC_CACHE_LINE, clapc_result_size(compiled)));
+
+  bench("clapc_spec_parse_string, 10000 tokens", token_count, {
+    char** argv_ptr = table;
+    memcpy(buffer, text, len);
+    if (!clapc_spec_parse_string(
+          compiled, &result, buffer, len, &argv_ptr, capacity, &error)) {
+      fprintf(stderr, "%s", error);
+      abort();
+    }
+  });
+
+  clapc_result_free(&result);
+  free(result.values);
+  clapc_spec_free(compiled);
+  free(table);
+  free(text);
+  free(buffer);
+  free(argv);
+  free_spec(&spec);
+}
+
+/**
+ * The cost of checking constraints after parsing: every option depends on the
+ * next one and conflicts with none of the others that are given.
+ */
+static void bench_constraints(void)
+{
+  const size_t option_counts[] = { 64, 1000 };
+
+  for (size_t i = 0; i < sizeof(option_counts) / sizeof(size_t); i++) {
+    size_t count = option_counts[i];
+    s_synthetic_spec spec = generate_spec(count, MIX_BOOL);
+    char** argv = malloc((count + 2) * sizeof(char*));
+    const char** names = malloc(2 * count * sizeof(char*));
+    char* error;
+
+    argv[0] = "clapc_bench";
+    for (size_t j = 0; j < count; j++) {
+      argv[j + 1] = spec.tokens[j];
+      names[2 * j] = spec.args[(j + 1) % count].name;
+      names[2 * j + 1] = NULL;
+
+      // The fields of s_clap_arg are const, so the whole argument is replaced
+      memcpy(&spec.args[j],
+        &(s_clap_arg) {
+          .name = spec.args[j].name,
+          .type = CLAP_ARG_TYPE_BOOL,
+          .required = j % 2 == 0,
+          .depends_on = &names[2 * j],
+          .unique = true,
+        },
+        sizeof(s_clap_arg));
+    }
+    argv[count + 1] = NULL;
+
+    s_clapc_spec* compiled = clapc_spec_compile(spec.table, &error);
+    char name[96];
+    snprintf(name, sizeof(name), "clapc_spec_parse, %zu constrained options",
+      count);
+    bench(name, count, {
+      char** argv_ptr = argv;
+      if (!clapc_spec_parse(compiled, &argv_ptr, &error)) {
+        fprintf(stderr, "%s", error);
+        abort();
+      }
+    });
+
+    clapc_spec_free(compiled);
+    free(names);
+    free(argv);
+    free_spec(&spec);
+  }
+}
+
+/**
+ * Reporting a mistyped option of a program with thousands of options, along
+ * with the option that was probably meant.
+ */
+static void bench_suggestions(void)
+{
+  s_synthetic_spec spec = generate_spec(10000, MIX_BOOL);
+  char* error;
+  s_clapc_spec* compiled = clapc_spec_compile(spec.table, &error);
+
+  // One character replaced, one missing, and nothing close
+  char* typos[] = { "--option-0o123", "--option-0123", "--unknown-option" };
+  const char* labels[] = { "replaced", "missing", "no match" };
+
+  for (size_t i = 0; i < sizeof(typos) / sizeof(char*); i++) {
+    char* argv[] = { "clapc_bench", typos[i], NULL };
+    char name[96];
+
+    snprintf(name, sizeof(name), "suggestion, 10000 options, %s", labels[i]);
+    bench(name, 1, {
+      char** argv_ptr = argv;
+      if (clapc_spec_parse(compiled, &argv_ptr, &error)) {
+        abort();
+      }
+      free(error);
+    });
+
+    snprintf(name, sizeof(name), "suggestion, 10000 options, %s, no spec",
+      labels[i]);
+    bench(name, 1, {
+      char** argv_ptr = argv;
+      if (clapc_parse_safe(spec.table, &argv_ptr, &error)) {
+        abort();
+      }
+      free(error);
+    });
+  }
+
+  clapc_spec_free(compiled);
+  free_spec(&spec);
+}
+
+static void bench_rich_types(void)
+{
+  const char* sizes[] = { "4096", "512M", "1.5GiB", "64k" };
+  const char* durations[] = { "250ms", "2h", "1h30m", "1.5s" };
+  volatile uint64_t sink = 0;
+
+  bench("clapc_parse_size", NUMBER_COUNT, {
+    for (size_t i = 0; i < NUMBER_COUNT; i++) {
+      uint64_t value;
+      clapc_parse_size(sizes[i % 4], strlen(sizes[i % 4]), &value);
+      sink += value;
+    }
+  });
+
+  bench("clapc_parse_duration", NUMBER_COUNT, {
+    for (size_t i = 0; i < NUMBER_COUNT; i++) {
+      uint64_t value;
+      clapc_parse_duration(
+        durations[i % 4], strlen(durations[i % 4]), &value);
+      sink += value;
+    }
+  });
+
+  // The same enum argument, with more and more choices to look the value up in
+  for (size_t count = 4; count <= 1024; count *= 16) {
+    char** choices = calloc(count + 1, sizeof(char*));
+    for (size_t i = 0; i < count; i++) {
+      choices[i] = malloc(24);
+      snprintf(choices[i], 24, "choice-%zu", i);
+    }
+
+    int mode;
+    s_clap_arg mode_arg = {
+      .name = "mode",
+      .type = CLAP_ARG_TYPE_ENUM,
+      .choices = (const char* const*)choices,
+      .dest = &mode,
+    };
+    s_clap_arg* args[] = { &mode_arg, NULL };
+    char* argv[] = { "clapc_bench", "--mode", choices[count - 1], NULL };
+
+    char* error;
+    s_clapc_spec* spec = clapc_spec_compile(args, &error);
+    char name[64];
+
+    snprintf(name, sizeof(name), "enum, %zu choices", count);
+    bench(name, 1, {
+      char** argv_ptr = argv;
+      if (!clapc_spec_parse(spec, &argv_ptr, &error)) {
+        abort();
+      }
+    });
+
+    snprintf(name, sizeof(name), "enum, %zu choices, no spec", count);
+    bench(name, 1, {
+      char** argv_ptr = argv;
+      if (!clapc_parse_safe(args, &argv_ptr, &error)) {
+        abort();
+      }
+    });
+
+    clapc_spec_free(spec);
+    for (size_t i = 0; i < count; i++) {
+      free(choices[i]);
+    }
+    free(choices);
+  }
+}
+
+/**
+ * Parse "a.b.c.d" into a big-endian IPv4 address.
+ */
+static bool parse_ipv4(const char* str, size_t len, uint32_t* out)
+{
+  uint32_t address = 0;
+  const char* end = str + len;
+
+  for (int i = 0; i < 4; i++) {
+    const char* dot = memchr(str, '.', (size_t)(end - str));
+    const char* part_end = (i < 3) ? dot : end;
+    uint64_t part;
+    if (part_end == NULL
+      || clapc_parse_number(
+           str, (size_t)(part_end - str), CLAPC_NUMBER_UINT64, &part)
+        != CLAPC_NUMBER_OK
+      || part > 255) {
+      return false;
+    }
+    address = (address << 8) | (uint32_t)part;
+    str = part_end + 1;
+  }
+
+  *out = address;
+  return true;
+}
+
+static bool parse_ipv4_value(
+  s_clap_str value, void* dest, void* data, const char** reason)
+{
+  (void)data;
+  (void)reason;
+  uint32_t address;
+  if (!parse_ipv4(value.data, value.len, &address)) {
+    return false;
+  }
+  if (dest) {
+    *(uint32_t*)dest = address;
+  }
+  return true;
+}
+
+static void bench_custom(void)
+{
+  uint32_t address;
+  s_clap_arg custom_arg = {
+    .name = "address",
+    .type = CLAP_ARG_TYPE_CUSTOM,
+    .dest = &address,
+    .parse = parse_ipv4_value,
+  };
+  s_clap_arg string_arg = {
+    .name = "address",
+    .type = CLAP_ARG_TYPE_STRING,
+  };
+  s_clap_arg* custom_args[] = { &custom_arg, NULL };
+  s_clap_arg* string_args[] = { &string_arg, NULL };
+  char* argv[] = { "clapc_bench", "--address", "192.168.100.200", NULL };
+
+  char* error;
+  s_clapc_spec* custom_spec = clapc_spec_compile(custom_args, &error);
+  s_clapc_spec* string_spec = clapc_spec_compile(string_args, &error);
+
+  bench("custom value, parsed into its storage", 1, {
+    char** argv_ptr = argv;
+    if (!clapc_spec_parse(custom_spec, &argv_ptr, &error)) {
+      abort();
+    }
+  });
+
+  bench("string value, copied and parsed afterwards", 1, {
+    char** argv_ptr = argv;
+    if (!clapc_spec_parse(string_spec, &argv_ptr, &error)) {
+      abort();
+    }
+    const char* value = clap_arg_get_string(&string_arg);
+    if (!parse_ipv4(value, strlen(value), &address)) {
+      abort();
+    }
+    clapc_args_free(string_args);
+  });
+
+  clapc_spec_free(custom_spec);
+  clapc_spec_free(string_spec);
+}
+
+extern char** environ;
+
+/**
+ * Run each of the startup programs (see clapc_startup.c) over and over, from
+ * exec until their arguments are parsed and they exit.
+ */
+static void bench_startup(char* paths[], size_t count)
+{
+  const char* labels[] = { "shared library", "static library",
+    "single header" };
+
+  for (size_t i = 0; i < count && i < 3; i++) {
+    char* argv[] = { paths[i], "--json", "--jobs", "8", "-o", "out.txt", "-I",
+      "a,b", "-I", "c", NULL };
+    char name[64];
+
+    snprintf(name, sizeof(name), "startup, %s", labels[i]);
+    bench(name, 100, {
+      for (int j = 0; j < 100; j++) {
+        pid_t pid;
+        int status;
+        if (posix_spawn(&pid, paths[i], NULL, NULL, argv, environ) != 0
+          || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)
+          || WEXITSTATUS(status) != 0) {
+          abort();
+        }
+      }
+    });
+  }
+}
+
+static void bench_errors(void)
+{
+  s_synthetic_spec spec = generate_spec(64, MIX_INT);
+  char* error;
+  s_clapc_spec* compiled = clapc_spec_compile(spec.table, &error);
+  void* memory = aligned_alloc(CLAPC_CACHE_LINE, clapc_result_size(compiled));
+  s_clapc_result result;
+  clapc_result_init(&result, compiled, memory);
+
+  // An option that takes a number, given something that isn't one
+  char* argv[] = { "clapc_bench", spec.tokens[0], "not-a-number", NULL };
+
+  bench("rejected command line, error string", 1, {
+    char** argv_ptr = argv;
+    if (clapc_spec_parse_result(compiled, &result, &argv_ptr, &error)) {
+      abort();
+    }
+    free(error);
+  });
+
+  bench("rejected command line, checked error", 1, {
+    char** argv_ptr = argv;
+    s_clapc_error failure;
+    if (clapc_spec_parse_result_checked(
+          compiled, &result, &argv_ptr, &failure)) {
+      abort();
+    }
+  });
+
+  bench("rejected command line, checked error, formatted", 1, {
+    char** argv_ptr = argv;
+    s_clapc_error failure;
+    char message[128];
+    if (clapc_spec_parse_result_checked(
+          compiled, &result, &argv_ptr, &failure)) {
+      abort();
+    }
+    clapc_error_format(&failure, message, sizeof(message));
+  });
+
+  clapc_result_free(&result);
+  free(memory);
+  clapc_spec_free(compiled);
+  free_spec(&spec);
+}
+
+static void bench_allocators(void)
+{
+  // Every value is a copied string, so each one is an allocation
+  s_synthetic_spec spec = generate_spec(64, MIX_STRING);
+  char** argv = generate_argv(&spec, 128, 0, false);
+  char* error;
+  s_clapc_spec* compiled = clapc_spec_compile(spec.table, &error);
+
+  bench("64 strings, malloc, freed after each parse", 64, {
+    char** argv_ptr = argv;
+    s_clapc_error failure;
+    if (!clapc_spec_parse_checked(compiled, &argv_ptr, &failure)) {
+      abort();
+    }
+    clapc_args_free(spec.table);
+  });
+
+  s_clapc_arena arena;
+  clapc_arena_init(&arena, 0);
+  bench("64 strings, arena, reset after each parse", 64, {
+    char** argv_ptr = argv;
+    s_clapc_error failure;
+    if (!clapc_spec_parse_with_allocator(
+          compiled, &argv_ptr, &arena.allocator, &failure)) {
+      abort();
+    }
+    clapc_arena_reset(&arena);
+  });
+
+  size_t len;
+  bench("help message, malloc", 1, {
+    free(clapc_format_help("clapc_bench", NULL, spec.table, 80, &len));
+  });
+
+  bench("help message, arena", 1, {
+    clapc_format_help_with_allocator(
+      "clapc_bench", NULL, spec.table, 80, &arena.allocator, &len);
+    clapc_arena_reset(&arena);
+  });
+
+  clapc_arena_free(&arena);
+  clapc_spec_free(compiled);
+  free(argv);
+  // The values from the arena are only forgotten
+  free_spec(&spec);
+}
+
+static void bench_unparse(void)
+{
+  // A parent with a typical mix of options, each of which was given
+  s_synthetic_spec spec = generate_spec(16, MIX_MIXED);
+  char** argv = generate_argv(&spec, 64, 0, false);
+  char** argv_ptr = argv;
+  char* error;
+  if (!clapc_parse_safe(spec.table, &argv_ptr, &error)) {
+    abort();
+  }
+
+  // Every worker gets its own value for an int option
+  char worker[16] = "1";
+  s_clapc_override override = { .arg = spec.table[1], .value = worker };
+
+  bench("unparse, 16 options, one allocation per worker", 1, {
+    size_t size = clapc_unparse_size("worker", spec.table, &override, 1);
+    void* memory = malloc(size);
+    char** worker_argv
+      = clapc_unparse("worker", spec.table, &override, 1, memory, size);
+    if (worker_argv[1] == NULL) {
+      abort();
+    }
+    free(memory);
+  });
+
+  // What building the same command line by hand looks like, one string at a
+  // time
+  bench("hand-built argv, 16 options, one allocation per token", 1, {
+    char** tokens = malloc((2 * spec.count + 2) * sizeof(char*));
+    size_t n = 0;
+    tokens[n++] = strdup("worker");
+    for (size_t i = 0; i < spec.count; i++) {
+      s_clap_arg* arg = spec.table[i];
+      if (arg->value == NULL) {
+        continue;
+      }
+      tokens[n++] = strdup(spec.tokens[i]);
+      char value[64];
+      switch (arg->type) {
+      case CLAP_ARG_TYPE_BOOL:
+        continue;
+      case CLAP_ARG_TYPE_INT:
+        snprintf(value, sizeof(value), "%d",
+          i == 1 ? atoi(worker) : clap_arg_get_int(arg));
+        break;
+      case CLAP_ARG_TYPE_FLOAT:
+        snprintf(value, sizeof(value), "%.9g", clap_arg_get_float(arg));
+        break;
+      default:
+        snprintf(value, sizeof(value), "%s", clap_arg_get_string(arg));
+        break;
+      }
+      tokens[n++] = strdup(value);
+    }
+    tokens[n] = NULL;
+    for (size_t i = 0; i < n; i++) {
+      free(tokens[i]);
+    }
+    free(tokens);
+  });
+
+  free(argv);
+  free_spec(&spec);
+}
+
+/**
+ * The startup programs to run may be given as arguments: the one linked to the
+ * shared library, the one linked to the static library, and the one built with
+ * the single header.
+ */
+int main(int argc, char* argv[])
+{
+  bench_numbers();
+  bench_scaling();
+  bench_mixes();
+  bench_positionals();
+  bench_generated();
+  bench_subcommands();
+  bench_env();
+  bench_config();
+  bench_help();
+  bench_completion();
+  bench_results();
+  bench_batch();
+  bench_strings();
+  bench_constraints();
+  bench_suggestions();
+  bench_rich_types();
+  bench_custom();
+  bench_errors();
+  bench_allocators();
+  bench_unparse();
+  bench_startup(argv + 1, (size_t)(argc - 1));
+
+  return 0;
+}
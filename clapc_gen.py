@@ -0,0 +1,459 @@
+#!/usr/bin/env python3
+"""Generate a specialized clapc parser from a declarative spec file.
+
+A spec file has one option per line:
+
+    # name    short  type    description
+    json      j      bool    If true, output will be in JSON format
+    jobs      -      int     How many jobs to run in parallel
+
+`short` is a single character, or "-" if the option has no short name. `type`
+is one of bool, int, float or string. Blank lines and lines starting with "#"
+are ignored.
+
+The generated parser dispatches on option names through a switch-based trie
+(keyed on the length of the name, then on the bytes that best tell the
+remaining names apart) and stores values straight into the typed fields of a
+generated struct. String values are borrowed from argv.
+
+Generated parsers only implement the subset of clapc that the spec format can
+express. They accept the same syntax as clapc_parse_safe (long and short names,
+"--name=value", "--" and booleans followed by "true" or "false") and report the
+same errors for it, but they don't expand response files, and only the types
+above are supported. A spec that uses any other type is rejected.
+
+Usage: clapc_gen.py --prefix PREFIX SPEC HEADER SOURCE
+"""
+
+import argparse
+import os
+import re
+import sys
+
+TYPES = {
+    "bool": ("bool", "CLAP_ARG_TYPE_BOOL"),
+    "int": ("int", "CLAP_ARG_TYPE_INT"),
+    "float": ("float", "CLAP_ARG_TYPE_FLOAT"),
+    "string": ("const char*", "CLAP_ARG_TYPE_STRING"),
+}
+
+
+class Option:
+    def __init__(self, name, short, type, description):
+        self.name = name
+        self.short = short
+        self.type = type
+        self.description = description
+        self.ident = re.sub(r"[^A-Za-z0-9_]", "_", name)
+        self.enum = "OPTION_" + self.ident.upper()
+
+
+def fail(path, line_number, message):
+    sys.exit(f"{path}:{line_number}: {message}")
+
+
+def read_spec(path):
+    options = []
+    names = set()
+    shorts = set()
+    idents = set()
+
+    with open(path, encoding="utf-8") as f:
+        for line_number, line in enumerate(f, 1):
+            line = line.strip()
+            if not line or line.startswith("#"):
+                continue
+
+            fields = line.split(None, 3)
+            if len(fields) < 3:
+                fail(path, line_number, "expected 'name short type description'")
+
+            name, short, type = fields[:3]
+            description = fields[3] if len(fields) > 3 else ""
+
+            if type not in TYPES:
+                fail(
+                    path,
+                    line_number,
+                    f"unsupported type '{type}' (generated parsers only "
+                    f"support {', '.join(TYPES)})",
+                )
+            if short == "-":
+                short = None
+            elif len(short) != 1:
+                fail(path, line_number, f"invalid short name '{short}'")
+            if not re.fullmatch(r"[A-Za-z0-9][A-Za-z0-9_.-]*", name):
+                fail(path, line_number, f"invalid name '{name}'")
+
+            option = Option(name, short, type, description)
+            if name in names or option.ident in idents:
+                fail(path, line_number, f"duplicate argument '--{name}'")
+            if short is not None and short in shorts:
+                fail(path, line_number, f"duplicate argument '-{short}'")
+
+            names.add(name)
+            idents.add(option.ident)
+            if short is not None:
+                shorts.add(short)
+            options.append(option)
+
+    return options
+
+
+def c_string(value):
+    return '"' + value.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def c_char(value):
+    return "'\\''" if value == "'" else "'\\\\'" if value == "\\" else f"'{value}'"
+
+
+def emit_trie(out, options, length, indent):
+    """Emit the trie node that tells apart `options`, whose names are all
+    `length` bytes long. Instead of testing the name one byte at a time, each
+    node switches on the byte that splits the remaining names the most, so most
+    names are found after one or two switches and a single comparison. Every
+    path through the emitted code returns."""
+    pad = "  " * indent
+
+    if len(options) == 1:
+        option = options[0]
+        out.append(
+            f"{pad}if (memcmp(name, {c_string(option.name)}, {length}) != 0) {{"
+        )
+        out.append(f"{pad}  return -1;")
+        out.append(f"{pad}}}")
+        out.append(f"{pad}return {option.enum};")
+        return
+
+    def split(position):
+        groups = {}
+        for option in options:
+            groups.setdefault(option.name[position], []).append(option)
+        return groups
+
+    position = max(
+        range(length),
+        key=lambda i: (len(split(i)), -max(len(g) for g in split(i).values())),
+    )
+    children = split(position)
+
+    out.append(f"{pad}switch (name[{position}]) {{")
+    for char in sorted(children):
+        out.append(f"{pad}case {c_char(char)}: {{")
+        emit_trie(out, children[char], length, indent + 1)
+        out.append(f"{pad}}}")
+    out.append(f"{pad}default:")
+    out.append(f"{pad}  return -1;")
+    out.append(f"{pad}}}")
+
+
+def emit_match_long(out, options):
+    out += [
+        "static int match_long(char* name, char** end)",
+        "{",
+        '  size_t len = strcspn(name, "=");',
+        "  *end = name + len;",
+        "",
+        "  switch (len) {",
+    ]
+    lengths = {}
+    for option in options:
+        lengths.setdefault(len(option.name), []).append(option)
+    for length in sorted(lengths):
+        out.append(f"  case {length}: {{")
+        emit_trie(out, lengths[length], length, 2)
+        out.append("  }")
+    out += [
+        "  default:",
+        "    return -1;",
+        "  }",
+        "}",
+        "",
+    ]
+
+
+def generate_header(prefix, options):
+    out = [
+        "// This file was generated by clapc_gen.py. Do not edit.",
+        "#pragma once",
+        "",
+        "#include <clapc.h>",
+        "#include <stdbool.h>",
+        "#include <stddef.h>",
+        "",
+        "/**",
+        " * The parsed options. Every field is only meaningful if the matching",
+        " * field in `present` is true.",
+        " */",
+        "typedef struct {",
+    ]
+    for option in options:
+        c_type = TYPES[option.type][0]
+        out.append(f"  {c_type} {option.ident};")
+        if option.type == "string":
+            out.append(f"  size_t {option.ident}_len;")
+    out.append("  struct {")
+    for option in options:
+        out.append(f"    bool {option.ident};")
+    out.append("  } present;")
+    out.append(f"}} s_{prefix}_options;")
+    out += [
+        "",
+        "/**",
+        " * The same options as a null-terminated array of arguments, e.g. for",
+        " * clapc_print_help. String arguments borrow their values.",
+        " */",
+        f"extern s_clap_arg* {prefix}_args[];",
+        "",
+        "/**",
+        " * Parses the command-line arguments into `options`. This accepts the",
+        " * same syntax as clapc_parse_safe with the arguments of",
+        f" * {prefix}_args, and reports the same errors, but response files are",
+        " * not expanded. String values point into argv.",
+        " */",
+        f"bool {prefix}_parse(",
+        f"  s_{prefix}_options* options, char*** argv_ptr, char** error);",
+        "",
+    ]
+    return "\n".join(out)
+
+
+def generate_source(prefix, header_name, options):
+    out = [
+        "// This file was generated by clapc_gen.py. Do not edit.",
+        "#define _GNU_SOURCE",
+        f'#include "{header_name}"',
+        "#include <stdint.h>",
+        "#include <stdio.h>",
+        "#include <string.h>",
+        "",
+    ]
+
+    for option in options:
+        short = c_char(option.short) if option.short else "0"
+        out += [
+            f"static s_clap_arg {option.ident}_arg = {{",
+            f"  .name = {c_string(option.name)},",
+            f"  .short_name = {short},",
+            f"  .type = {TYPES[option.type][1]},",
+            f"  .description = {c_string(option.description)},",
+            # Like the generated parser, don't copy strings
+            f"  .borrow = {'true' if option.type == 'string' else 'false'},",
+            "};",
+            "",
+        ]
+    out.append(f"s_clap_arg* {prefix}_args[] = {{")
+    for option in options:
+        out.append(f"  &{option.ident}_arg,")
+    out += ["  NULL,", "};", ""]
+
+    out.append("enum {")
+    for option in options:
+        out.append(f"  {option.enum},")
+    out += ["};", ""]
+
+    emit_match_long(out, options)
+
+    out += [
+        "static int match_short(char name)",
+        "{",
+        "  switch (name) {",
+    ]
+    for option in options:
+        if option.short:
+            out.append(f"  case {c_char(option.short)}:")
+            out.append(f"    return {option.enum};")
+    out += [
+        "  default:",
+        "    return -1;",
+        "  }",
+        "}",
+        "",
+    ]
+
+    out += [
+        "static bool take_bool(char* inline_value, char*** argv, bool* out,",
+        "  const char* option, char** error)",
+        "{",
+        "  if (inline_value) {",
+        '    if (strcmp(inline_value, "true") == 0) {',
+        "      *out = true;",
+        '    } else if (strcmp(inline_value, "false") == 0) {',
+        "      *out = false;",
+        "    } else {",
+        "      asprintf(error, \"Invalid value '%s' for argument '%s'\\n\",",
+        "        inline_value, option);",
+        "      return false;",
+        "    }",
+        "    return true;",
+        "  }",
+        "",
+        "  // Consume the next arg if it is either \"true\" or \"false\"",
+        "  char* next = (*argv)[1];",
+        '  if (next && strcmp(next, "true") == 0) {',
+        "    *out = true;",
+        "    (*argv)++;",
+        '  } else if (next && strcmp(next, "false") == 0) {',
+        "    *out = false;",
+        "    (*argv)++;",
+        "  } else {",
+        "    *out = true;",
+        "  }",
+        "  return true;",
+        "}",
+        "",
+        "static char* take_value(",
+        "  char* inline_value, char*** argv, const char* option, char** error)",
+        "{",
+        "  if (inline_value) {",
+        "    return inline_value;",
+        "  }",
+        "  char* next = (*argv)[1];",
+        "  if (!next) {",
+        "    asprintf(error, \"Missing positional argument for '%s'\\n\", option);",
+        "    return NULL;",
+        "  }",
+        "  (*argv)++;",
+        "  return next;",
+        "}",
+        "",
+        "static bool check_number(e_clapc_number_status status, const char* value,",
+        "  const char* option, char** error)",
+        "{",
+        "  switch (status) {",
+        "  case CLAPC_NUMBER_OK:",
+        "    return true;",
+        "  case CLAPC_NUMBER_OUT_OF_RANGE:",
+        "    asprintf(error, \"Value out of range for argument '%s'\\n\", option);",
+        "    return false;",
+        "  default:",
+        "    asprintf(",
+        "      error, \"Invalid value '%s' for argument '%s'\\n\", value, option);",
+        "    return false;",
+        "  }",
+        "}",
+        "",
+    ]
+
+    out += [
+        f"bool {prefix}_parse(",
+        f"  s_{prefix}_options* options, char*** argv_ptr, char** error)",
+        "{",
+        "  *error = NULL;",
+        "",
+        "  // Skip first argument (it's always the executable name)",
+        "  char** argv = *argv_ptr + 1;",
+        "  char* arg = *argv;",
+        "",
+        "  while (arg && *arg) {",
+        "    if (*arg != '-') {",
+        "      break;",
+        "    }",
+        "",
+        "    bool is_long = false;",
+        "    if (arg[1] == '-') {",
+        "      if (arg[2] == '\\0') {",
+        "        argv++;",
+        "        break;",
+        "      }",
+        "      is_long = true;",
+        "    }",
+        "",
+        "    char* option = arg;",
+        "    arg += is_long ? 2 : 1;",
+        "",
+        "    char* end = arg + 1;",
+        "    int id = is_long ? match_long(arg, &end) : match_short(*arg);",
+        "    char* inline_value = is_long && *end == '=' ? end + 1 : NULL;",
+        "    char* value;",
+        "",
+        "    switch (id) {",
+    ]
+    for option in options:
+        field = f"options->{option.ident}"
+        out.append(f"    case {option.enum}:")
+        if option.type == "bool":
+            out += [
+                f"      if (!take_bool(inline_value, &argv, &{field}, option, error)) {{",
+                "        return false;",
+                "      }",
+            ]
+        else:
+            out += [
+                "      value = take_value(inline_value, &argv, option, error);",
+                "      if (value == NULL) {",
+                "        return false;",
+                "      }",
+            ]
+            if option.type == "string":
+                out += [
+                    f"      {field} = value;",
+                    f"      {field}_len = strlen(value);",
+                ]
+            else:
+                number_type, c_type = (
+                    ("CLAPC_NUMBER_INT32", "int32_t")
+                    if option.type == "int"
+                    else ("CLAPC_NUMBER_FLOAT", "float")
+                )
+                out += [
+                    "      {",
+                    f"        {c_type} number;",
+                    "        if (!check_number(clapc_parse_number(value, strlen(value),",
+                    f"                              {number_type}, &number),",
+                    "              value, option, error)) {",
+                    "          return false;",
+                    "        }",
+                    f"        {field} = number;",
+                    "      }",
+                ]
+        out += [
+            f"      options->present.{option.ident} = true;",
+            "      break;",
+        ]
+    out += [
+        "    default:",
+        "      if (is_long) {",
+        "        asprintf(error, \"Invalid argument '%.*s'\\n\",",
+        "          (int)strcspn(arg, \"=\"), arg);",
+        "      } else {",
+        "        asprintf(error, \"Invalid argument '%s'\\n\", arg);",
+        "      }",
+        "      return false;",
+        "    }",
+        "",
+        "    arg = *++argv;",
+        "  }",
+        "",
+        "  *argv_ptr = argv;",
+        "  return true;",
+        "}",
+        "",
+    ]
+    return "\n".join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--prefix", required=True, help="prefix of every symbol")
+    parser.add_argument("spec", help="the spec file to read")
+    parser.add_argument("header", help="the header to write")
+    parser.add_argument("source", help="the source file to write")
+    args = parser.parse_args()
+
+    if not re.fullmatch(r"[A-Za-z_][A-Za-z0-9_]*", args.prefix):
+        sys.exit(f"invalid prefix '{args.prefix}'")
+
+    options = read_spec(args.spec)
+
+    with open(args.header, "w", encoding="utf-8") as f:
+        f.write(generate_header(args.prefix, options))
+    with open(args.source, "w", encoding="utf-8") as f:
+        f.write(
+            generate_source(args.prefix, os.path.basename(args.header), options)
+        )
+
+
+if __name__ == "__main__":
+    main()
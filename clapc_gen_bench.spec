@@ -0,0 +1,132 @@
+# Options used to benchmark the parsers generated by clapc_gen.py against
+# clapc_spec_parse.
+#
+# name  short  type  description
+name-exclude a int Benchmark option 1
+quiet-config b float Benchmark option 2
+debug-trace c string Benchmark option 3
+depth-port d bool Benchmark option 4
+warn-config e int Benchmark option 5
+threads-keep f float Benchmark option 6
+color-define g string Benchmark option 7
+retry-rate h bool Benchmark option 8
+debug-limit i int Benchmark option 9
+define-user j float Benchmark option 10
+retry-config k string Benchmark option 11
+verbose-dir l bool Benchmark option 12
+level-warn m int Benchmark option 13
+config-verbose n float Benchmark option 14
+warn-quiet o string Benchmark option 15
+config-level p bool Benchmark option 16
+color-user q int Benchmark option 17
+dry-run-min r float Benchmark option 18
+rate-exclude s string Benchmark option 19
+trace-dir t bool Benchmark option 20
+verbose-mode u int Benchmark option 21
+user-format v float Benchmark option 22
+depth-warn w string Benchmark option 23
+verbose-jobs x bool Benchmark option 24
+port-depth y int Benchmark option 25
+user-debug z float Benchmark option 26
+verbose-config A string Benchmark option 27
+width-keep B bool Benchmark option 28
+target-trace C int Benchmark option 29
+retry-name D float Benchmark option 30
+seed-warn E string Benchmark option 31
+seed-port F bool Benchmark option 32
+mode-limit G int Benchmark option 33
+format-limit H float Benchmark option 34
+define-verbose I string Benchmark option 35
+mode-timeout J bool Benchmark option 36
+target-out K int Benchmark option 37
+root-min L float Benchmark option 38
+watch-debug M string Benchmark option 39
+dir-threads N bool Benchmark option 40
+rate-filter O int Benchmark option 41
+out-exclude P float Benchmark option 42
+target-rate Q string Benchmark option 43
+color-debug R bool Benchmark option 44
+user-verbose S int Benchmark option 45
+name-out T float Benchmark option 46
+path-watch U string Benchmark option 47
+target-warn V bool Benchmark option 48
+seed-debug W int Benchmark option 49
+define-max X float Benchmark option 50
+size-debug Y string Benchmark option 51
+config-mode Z bool Benchmark option 52
+verbose-root - int Benchmark option 53
+min-prefix - float Benchmark option 54
+path-cache - string Benchmark option 55
+seed-path - bool Benchmark option 56
+filter-width - int Benchmark option 57
+dir-target - float Benchmark option 58
+config-keep - string Benchmark option 59
+min-dry-run - bool Benchmark option 60
+limit-quiet - int Benchmark option 61
+quiet-target - float Benchmark option 62
+define-filter - string Benchmark option 63
+root-quiet - bool Benchmark option 64
+user-max - int Benchmark option 65
+dry-run-retry - float Benchmark option 66
+rate-path - string Benchmark option 67
+prefix-level - bool Benchmark option 68
+exclude-define - int Benchmark option 69
+format-exclude - float Benchmark option 70
+level-level - string Benchmark option 71
+build-target - bool Benchmark option 72
+warn-format - int Benchmark option 73
+log-min - float Benchmark option 74
+build-exclude - string Benchmark option 75
+rate-trace - bool Benchmark option 76
+port-width - int Benchmark option 77
+verbose-name - float Benchmark option 78
+dry-run-threads - string Benchmark option 79
+width-config - bool Benchmark option 80
+seed-user - int Benchmark option 81
+quiet-quiet - float Benchmark option 82
+depth-size - string Benchmark option 83
+jobs-debug - bool Benchmark option 84
+keep-root - int Benchmark option 85
+filter-dir - float Benchmark option 86
+out-watch - string Benchmark option 87
+config-depth - bool Benchmark option 88
+build-verbose - int Benchmark option 89
+exclude-trace - float Benchmark option 90
+width-cache - string Benchmark option 91
+debug-keep - bool Benchmark option 92
+width-prefix - int Benchmark option 93
+exclude-log - float Benchmark option 94
+port-size - string Benchmark option 95
+dir-dir - bool Benchmark option 96
+target-seed - int Benchmark option 97
+size-size - float Benchmark option 98
+mode-define - string Benchmark option 99
+exclude-depth - bool Benchmark option 100
+out-log - int Benchmark option 101
+size-filter - float Benchmark option 102
+timeout-cache - string Benchmark option 103
+keep-timeout - bool Benchmark option 104
+port-exclude - int Benchmark option 105
+trace-cache - float Benchmark option 106
+timeout-mode - string Benchmark option 107
+define-log - bool Benchmark option 108
+timeout-port - int Benchmark option 109
+filter-path - float Benchmark option 110
+level-trace - string Benchmark option 111
+trace-threads - bool Benchmark option 112
+out-level - int Benchmark option 113
+width-jobs - float Benchmark option 114
+level-jobs - string Benchmark option 115
+timeout-target - bool Benchmark option 116
+cache-max - int Benchmark option 117
+size-log - float Benchmark option 118
+jobs-watch - string Benchmark option 119
+path-root - bool Benchmark option 120
+path-port - int Benchmark option 121
+define-level - float Benchmark option 122
+depth-level - string Benchmark option 123
+size-jobs - bool Benchmark option 124
+out-keep - int Benchmark option 125
+size-width - float Benchmark option 126
+width-build - string Benchmark option 127
+size-path - bool Benchmark option 128
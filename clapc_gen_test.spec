@@ -0,0 +1,8 @@
+# Options used to test the parsers generated by clapc_gen.py
+#
+# name       short  type    description
+json         j      bool    If true, output will be in JSON format
+jobs         -      int     How many jobs to run in parallel
+job-timeout  t      float   How long each job may run for, in seconds
+output       o      string  Where to write the output
+out          -      string  An option that is a prefix of another one
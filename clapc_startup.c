@@ -0,0 +1,47 @@
+// A short-lived program that only parses its arguments, run over and over by
+// clapc_bench to measure the time from exec to parsed arguments. It is built
+// against the shared library, the static library and the single header.
+#ifdef CLAPC_IMPLEMENTATION
+#include "clapc_single.h"
+#else
+#include <clapc.h>
+#endif
+#include <stdlib.h>
+
+int main(int argc, char* argv[])
+{
+  (void)argc;
+
+  s_clap_arg json_arg = {
+    .name = "json",
+    .short_name = 'j',
+    .type = CLAP_ARG_TYPE_BOOL,
+  };
+  s_clap_arg jobs_arg = {
+    .name = "jobs",
+    .type = CLAP_ARG_TYPE_INT,
+  };
+  s_clap_arg output_arg = {
+    .name = "output",
+    .short_name = 'o',
+    .type = CLAP_ARG_TYPE_STRING,
+    .borrow = true,
+  };
+  s_clap_arg include_arg = {
+    .short_name = 'I',
+    .type = CLAP_ARG_TYPE_STRING_LIST,
+  };
+  s_clap_arg* args[] = { &json_arg, &jobs_arg, &output_arg, &include_arg,
+    NULL };
+
+  char* error;
+  char** argv_ptr = argv;
+  if (!clapc_parse_safe(args, &argv_ptr, &error)) {
+    fputs(error, stderr);
+    free(error);
+    return 1;
+  }
+
+  clapc_args_free(args);
+  return 0;
+}
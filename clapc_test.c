@@ -1,8 +1,14 @@
 #include <clapc.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "clapc_gen_test.h"
+
+#define CTEST_COUNT_ALLOCATIONS
 #include "ctest.h"
 
 // Tests =======================================================================
@@ -141,15 +147,2462 @@ void double_dash(void)
   }
 }
 
-int main(void)
+/**
+ * Ensure that a compiled spec finds arguments by both their long and short
+ * names.
+ */
+void compiled_spec(void)
 {
-  begin_suite();
+  s_clap_arg json_arg = {
+    .name = "json",
+    .short_name = 'j',
+    .type = CLAP_ARG_TYPE_BOOL,
+    .description = "If true, output will be in JSON format",
+  };
 
-  test(explicit_long_boolean);
-  test(implicit_boolean);
+  s_clap_arg extensions_arg = {
+    .name = "extensions",
+    .short_name = 'e',
+    .type = CLAP_ARG_TYPE_STRING,
+    .description = "A comma-separated list of file extensions to include",
+  };
 
-  test(string_arguments);
-  test(double_dash);
+  s_clap_arg* args[] = { &json_arg, &extensions_arg, NULL };
+
+  char* error;
+  s_clapc_spec* spec = clapc_spec_compile(args, &error);
+  expect(spec != NULL);
+  expect(error == NULL);
+
+  {
+    char* argv[] = { "clapc_test", "-j", "--extensions", "c,h", "file", NULL };
+    char** argv_ptr = argv;
+    bool result = clapc_spec_parse(spec, &argv_ptr, &error);
+
+    expect(error == NULL);
+    expect(result);
+    expect(clap_arg_get_bool(&json_arg) == true);
+    expect(strcmp(clap_arg_get_string(&extensions_arg), "c,h") == 0);
+    expect(argv_ptr == &argv[4]);
+
+    clapc_args_free(args);
+  }
+
+  {
+    char* argv[] = { "clapc_test", "--extension", "c,h", NULL };
+    char** argv_ptr = argv;
+    bool result = clapc_spec_parse(spec, &argv_ptr, &error);
+
+    expect(!result);
+    expect(error != NULL);
+
+    free(error);
+    clapc_args_free(args);
+  }
+
+  clapc_spec_free(spec);
+}
+
+/**
+ * Ensure that compiling a spec fails if two arguments share a name.
+ */
+void duplicate_names(void)
+{
+  s_clap_arg a = { .name = "output", .short_name = 'o' };
+  s_clap_arg b = { .name = "verbose", .short_name = 'o' };
+  s_clap_arg c = { .name = "output" };
+
+  {
+    char* error;
+    s_clap_arg* args[] = { &a, &b, NULL };
+    s_clapc_spec* spec = clapc_spec_compile(args, &error);
+
+    expect(spec == NULL);
+    expect(error != NULL);
+
+    free(error);
+  }
+
+  {
+    char* error;
+    s_clap_arg* args[] = { &a, &c, NULL };
+    s_clapc_spec* spec = clapc_spec_compile(args, &error);
+
+    expect(spec == NULL);
+    expect(error != NULL);
+
+    free(error);
+  }
+}
+
+/**
+ * Ensure that arguments with caller-owned storage are parsed without any heap
+ * allocations.
+ */
+void caller_owned_storage(void)
+{
+  if (!CTEST_COUNTS_ALLOCATIONS) {
+    test_skip();
+    return;
+  }
+
+  struct {
+    bool json;
+    int jobs;
+    float ratio;
+    const char* output;
+  } options = { 0 };
+
+  s_clap_arg json_arg = {
+    .name = "json",
+    .type = CLAP_ARG_TYPE_BOOL,
+    .dest = &options.json,
+  };
+  s_clap_arg jobs_arg = {
+    .name = "jobs",
+    .short_name = 'j',
+    .type = CLAP_ARG_TYPE_INT,
+    .dest = &options.jobs,
+  };
+  s_clap_arg ratio_arg = {
+    .name = "ratio",
+    .type = CLAP_ARG_TYPE_FLOAT,
+    .dest = &options.ratio,
+  };
+  s_clap_arg output_arg = {
+    .name = "output",
+    .short_name = 'o',
+    .type = CLAP_ARG_TYPE_STRING,
+    .dest = &options.output,
+  };
+
+  s_clap_arg* args[] = { &json_arg, &jobs_arg, &ratio_arg, &output_arg, NULL };
+
+  char* error;
+  s_clapc_spec* spec = clapc_spec_compile(args, &error);
+
+  char* argv[] = { "clapc_test", "--json", "-j", "4", "--ratio", "0.5", "-o",
+    "out.txt", "-j", "8", NULL };
+  char** argv_ptr = argv;
+
+  size_t before = allocation_count();
+  bool result = clapc_spec_parse(spec, &argv_ptr, &error);
+  size_t after = allocation_count();
+
+  expect(result);
+  expect(after == before);
+  expect(options.json == true);
+  expect(options.jobs == 8);
+  expect(options.ratio == 0.5f);
+  expect(options.output == argv[7]);
+  expect(clap_arg_get_int(&jobs_arg) == 8);
+  expect(strcmp(clap_arg_get_string(&output_arg), "out.txt") == 0);
+
+  // Must not free the caller-owned storage
+  clapc_args_free(args);
+  expect(jobs_arg.value == NULL);
+
+  clapc_spec_free(spec);
+}
+
+/**
+ * Ensure that repeating an argument keeps the last value.
+ */
+void repeated_argument(void)
+{
+  s_clap_arg jobs_arg = {
+    .name = "jobs",
+    .type = CLAP_ARG_TYPE_INT,
+  };
+  s_clap_arg output_arg = {
+    .name = "output",
+    .type = CLAP_ARG_TYPE_STRING,
+  };
+
+  s_clap_arg* args[] = { &jobs_arg, &output_arg, NULL };
+
+  char* error;
+  char* argv[] = { "clapc_test", "--jobs", "4", "--output", "a", "--jobs",
+    "8", "--output", "b", NULL };
+  char** argv_ptr = argv;
+  bool result = clapc_parse_safe(args, &argv_ptr, &error);
+
+  expect(result);
+  expect(clap_arg_get_int(&jobs_arg) == 8);
+  expect(strcmp(clap_arg_get_string(&output_arg), "b") == 0);
+
+  clapc_args_free(args);
+}
+
+/**
+ * Ensure that borrowed strings point into argv, including the "--name=value"
+ * form, and are not copied.
+ */
+void borrowed_strings(void)
+{
+  s_clap_arg output_arg = {
+    .name = "output",
+    .type = CLAP_ARG_TYPE_STRING,
+    .borrow = true,
+  };
+  s_clap_arg input_arg = {
+    .name = "input",
+    .short_name = 'i',
+    .type = CLAP_ARG_TYPE_STRING,
+    .borrow = true,
+  };
+
+  s_clap_arg* args[] = { &output_arg, &input_arg, NULL };
+
+  char* error;
+  char* argv[] = { "clapc_test", "--output=out.json", "-i", "in.json", NULL };
+  char** argv_ptr = argv;
+
+  size_t before = allocation_count();
+  bool result = clapc_parse_safe(args, &argv_ptr, &error);
+  size_t after = allocation_count();
+
+  expect(result);
+  expect(after == before);
+
+  s_clap_str output = clap_arg_get_string_view(&output_arg);
+  expect(output.data == argv[1] + strlen("--output="));
+  expect(output.len == strlen("out.json"));
+
+  s_clap_str input = clap_arg_get_string_view(&input_arg);
+  expect(input.data == argv[3]);
+  expect(input.len == strlen("in.json"));
+
+  // Must not free argv
+  clapc_args_free(args);
+  expect(output_arg.value == NULL);
+}
+
+/**
+ * Ensure that values can be given inline for every type.
+ */
+void inline_values(void)
+{
+  s_clap_arg json_arg = {
+    .name = "json",
+    .type = CLAP_ARG_TYPE_BOOL,
+  };
+  s_clap_arg jobs_arg = {
+    .name = "jobs",
+    .type = CLAP_ARG_TYPE_INT,
+  };
+  s_clap_arg output_arg = {
+    .name = "output",
+    .type = CLAP_ARG_TYPE_STRING,
+  };
+
+  s_clap_arg* args[] = { &json_arg, &jobs_arg, &output_arg, NULL };
+
+  {
+    char* error;
+    char* argv[] = { "clapc_test", "--json=false", "--jobs=3", "--output=a=b",
+      "true", NULL };
+    char** argv_ptr = argv;
+    bool result = clapc_parse_safe(args, &argv_ptr, &error);
+
+    expect(result);
+    expect(clap_arg_get_bool(&json_arg) == false);
+    expect(clap_arg_get_int(&jobs_arg) == 3);
+    expect(strcmp(clap_arg_get_string(&output_arg), "a=b") == 0);
+    expect(clap_arg_get_string_view(&output_arg).len == 3);
+    expect(argv_ptr == &argv[4]);
+
+    clapc_args_free(args);
+  }
+
+  {
+    char* error;
+    char* argv[] = { "clapc_test", "--json=yes", NULL };
+    char** argv_ptr = argv;
+    bool result = clapc_parse_safe(args, &argv_ptr, &error);
+
+    expect(!result);
+    expect(error != NULL);
+
+    free(error);
+    clapc_args_free(args);
+  }
+}
+
+#define parse_number(str, type, out)                                           \
+  clapc_parse_number((str), strlen(str), (type), (out))
+
+void integer_numbers(void)
+{
+  int32_t i32;
+  int64_t i64;
+  uint64_t u64;
+  e_clapc_number_status status;
+
+  status = parse_number("42", CLAPC_NUMBER_INT32, &i32);
+  expect(status == CLAPC_NUMBER_OK);
+  expect(i32 == 42);
+  status = parse_number("-2147483648", CLAPC_NUMBER_INT32, &i32);
+  expect(status == CLAPC_NUMBER_OK);
+  expect(i32 == INT32_MIN);
+  status = parse_number("2147483648", CLAPC_NUMBER_INT32, &i32);
+  expect(status == CLAPC_NUMBER_OUT_OF_RANGE);
+
+  status = parse_number("-9223372036854775808", CLAPC_NUMBER_INT64, &i64);
+  expect(status == CLAPC_NUMBER_OK);
+  expect(i64 == INT64_MIN);
+  status = parse_number("9223372036854775808", CLAPC_NUMBER_INT64, &i64);
+  expect(status == CLAPC_NUMBER_OUT_OF_RANGE);
+
+  status = parse_number("18446744073709551615", CLAPC_NUMBER_UINT64, &u64);
+  expect(status == CLAPC_NUMBER_OK);
+  expect(u64 == UINT64_MAX);
+  status = parse_number("18446744073709551616", CLAPC_NUMBER_UINT64, &u64);
+  expect(status == CLAPC_NUMBER_OUT_OF_RANGE);
+  status = parse_number("-1", CLAPC_NUMBER_UINT64, &u64);
+  expect(status == CLAPC_NUMBER_OUT_OF_RANGE);
+
+  // Trailing garbage, whitespace and empty strings are rejected
+  status = parse_number("12abc", CLAPC_NUMBER_INT32, &i32);
+  expect(status == CLAPC_NUMBER_INVALID);
+  status = parse_number(" 12", CLAPC_NUMBER_INT32, &i32);
+  expect(status == CLAPC_NUMBER_INVALID);
+  status = parse_number("", CLAPC_NUMBER_INT64, &i64);
+  expect(status == CLAPC_NUMBER_INVALID);
+  status = parse_number("-", CLAPC_NUMBER_INT64, &i64);
+  expect(status == CLAPC_NUMBER_INVALID);
+
+  // Only the given length is parsed
+  status = clapc_parse_number("123,456", 3, CLAPC_NUMBER_INT32, &i32);
+  expect(status == CLAPC_NUMBER_OK);
+  expect(i32 == 123);
+}
+
+void floating_point_numbers(void)
+{
+  // Compare against the correctly rounded libc conversion
+  const char* inputs[] = { "0", "-0", "0.5", "3.14159", "1e10", "1.5e-7",
+    "123456789012345678901234567890", "2.2250738585072011e-308",
+    "9007199254740993", "0.1", ".25", "7.", "1e-400", NULL };
+
+  e_clapc_number_status status;
+  for (int i = 0; inputs[i] != NULL; i++) {
+    double value = 0;
+    status = parse_number(inputs[i], CLAPC_NUMBER_DOUBLE, &value);
+    expect(status == CLAPC_NUMBER_OK);
+    expect(memcmp(&value, &(double) { strtod(inputs[i], NULL) },
+             sizeof(value))
+      == 0);
+
+    float fvalue = 0;
+    status = parse_number(inputs[i], CLAPC_NUMBER_FLOAT, &fvalue);
+    expect(status == CLAPC_NUMBER_OK);
+    expect(memcmp(&fvalue, &(float) { strtof(inputs[i], NULL) },
+             sizeof(fvalue))
+      == 0);
+  }
+
+  double value;
+  status = parse_number("1e400", CLAPC_NUMBER_DOUBLE, &value);
+  expect(status == CLAPC_NUMBER_OUT_OF_RANGE);
+  status = parse_number("1.5x", CLAPC_NUMBER_DOUBLE, &value);
+  expect(status == CLAPC_NUMBER_INVALID);
+  status = parse_number("1e", CLAPC_NUMBER_DOUBLE, &value);
+  expect(status == CLAPC_NUMBER_INVALID);
+  status = parse_number(".", CLAPC_NUMBER_DOUBLE, &value);
+  expect(status == CLAPC_NUMBER_INVALID);
+  status = parse_number("-Infinity", CLAPC_NUMBER_DOUBLE, &value);
+  expect(status == CLAPC_NUMBER_OK);
+  expect(isinf(value) && value < 0);
+}
+
+/**
+ * Ensure that invalid and out of range numbers are reported as errors instead
+ * of being silently accepted or exiting the program.
+ */
+void invalid_number_arguments(void)
+{
+  s_clap_arg jobs_arg = {
+    .name = "jobs",
+    .type = CLAP_ARG_TYPE_INT,
+  };
+
+  s_clap_arg* args[] = { &jobs_arg, NULL };
+
+  const char* values[] = { "4x", "99999999999", NULL };
+  for (int i = 0; values[i] != NULL; i++) {
+    char* error;
+    char* argv[] = { "clapc_test", "--jobs", (char*)values[i], NULL };
+    char** argv_ptr = argv;
+    bool result = clapc_parse_safe(args, &argv_ptr, &error);
+
+    expect(!result);
+    expect(error != NULL);
+
+    free(error);
+    clapc_args_free(args);
+  }
+}
+
+/**
+ * Write `contents` to a new temporary file and return its path as "@path".
+ */
+static char* write_response_file(const char* contents)
+{
+  char* path = strdup("@/tmp/clapc_test_XXXXXX");
+  int fd = mkstemp(path + 1);
+  write(fd, contents, strlen(contents));
+  close(fd);
+  return path;
+}
+
+/**
+ * Ensure that response files are expanded in place, including nested ones and
+ * quoted arguments.
+ */
+void response_files(void)
+{
+  char* nested = write_response_file("--jobs 3");
+
+  char contents[256];
+  snprintf(contents, sizeof(contents),
+    "--output 'my file.txt'\n--name \"a \\\"b\\\"\"\t%s\nfirst", nested);
+  char* file = write_response_file(contents);
+
+  s_clap_arg output_arg = {
+    .name = "output",
+    .type = CLAP_ARG_TYPE_STRING,
+    .borrow = true,
+  };
+  s_clap_arg name_arg = {
+    .name = "name",
+    .type = CLAP_ARG_TYPE_STRING,
+  };
+  s_clap_arg jobs_arg = {
+    .name = "jobs",
+    .type = CLAP_ARG_TYPE_INT,
+  };
+
+  s_clap_arg* args[] = { &output_arg, &name_arg, &jobs_arg, NULL };
+
+  char* error;
+  char* argv[] = { "clapc_test", file, "second", NULL };
+  char** argv_ptr = argv;
+  bool result = clapc_parse_safe(args, &argv_ptr, &error);
+
+  expect(error == NULL);
+  expect(result);
+  expect(strcmp(clap_arg_get_string(&output_arg), "my file.txt") == 0);
+  expect(strcmp(clap_arg_get_string(&name_arg), "a \"b\"") == 0);
+  expect(clap_arg_get_int(&jobs_arg) == 3);
+
+  // Parsing stopped inside of the response file
+  expect(argv_ptr[0] != NULL && strcmp(argv_ptr[0], "first") == 0);
+  expect(argv_ptr[1] != NULL && strcmp(argv_ptr[1], "second") == 0);
+  expect(argv_ptr[2] == NULL);
+
+  // The files are kept on the first argument, until the arguments are freed
+  expect(output_arg.files != NULL && name_arg.files == NULL);
+  clapc_args_free(args);
+  expect(output_arg.files == NULL);
+
+  unlink(file + 1);
+  unlink(nested + 1);
+  free(file);
+  free(nested);
+}
+
+/**
+ * Ensure that a response file that includes itself is an error.
+ */
+void recursive_response_file(void)
+{
+  char* file = write_response_file("");
+  FILE* stream = fopen(file + 1, "w");
+  fprintf(stream, "--json %s", file);
+  fclose(stream);
+
+  s_clap_arg json_arg = {
+    .name = "json",
+    .type = CLAP_ARG_TYPE_BOOL,
+  };
+
+  s_clap_arg* args[] = { &json_arg, NULL };
+
+  char* error;
+  char* argv[] = { "clapc_test", file, NULL };
+  char** argv_ptr = argv;
+  bool result = clapc_parse_safe(args, &argv_ptr, &error);
+
+  expect(!result);
+  expect(error != NULL);
+
+  free(error);
+  clapc_args_free(args);
+
+  unlink(file + 1);
+  free(file);
+}
+
+/**
+ * Ensure that list arguments collect every occurrence and every comma-separated
+ * item.
+ */
+void list_arguments(void)
+{
+  s_clap_arg include_arg = {
+    .name = "include",
+    .short_name = 'I',
+    .type = CLAP_ARG_TYPE_STRING_LIST,
+  };
+  s_clap_arg shard_arg = {
+    .name = "shard",
+    .type = CLAP_ARG_TYPE_INT_LIST,
+  };
+  s_clap_list weights = { 0 };
+  s_clap_arg weight_arg = {
+    .name = "weight",
+    .type = CLAP_ARG_TYPE_FLOAT_LIST,
+    .dest = &weights,
+  };
+
+  s_clap_arg* args[] = { &include_arg, &shard_arg, &weight_arg, NULL };
+
+  {
+    char* error;
+    char* argv[] = { "clapc_test", "-I", "src,include", "--shard=1,2",
+      "--include", "lib", "--shard", "3", "--weight", "0.5,0.25", NULL };
+    char** argv_ptr = argv;
+    bool result = clapc_parse_safe(args, &argv_ptr, &error);
+
+    expect(result);
+
+    size_t count;
+    const s_clap_str* includes = clap_arg_get_string_list(&include_arg, &count);
+    expect(count == 3);
+    expect(includes[0].len == 3 && strncmp(includes[0].data, "src", 3) == 0);
+    expect(includes[1].len == 7 && includes[1].data == argv[2] + 4);
+    expect(includes[2].len == 3 && includes[2].data == argv[5]);
+
+    const int* shards = clap_arg_get_int_list(&shard_arg, &count);
+    expect(count == 3);
+    expect(shards[0] == 1 && shards[1] == 2 && shards[2] == 3);
+
+    const float* items = clap_arg_get_float_list(&weight_arg, &count);
+    expect(count == 2);
+    expect(items == weights.items);
+    expect(items[0] == 0.5f && items[1] == 0.25f);
+
+    clapc_args_free(args);
+    expect(weights.items == NULL);
+  }
+
+  {
+    char* error;
+    char* argv[] = { "clapc_test", "--shard", "1,x", NULL };
+    char** argv_ptr = argv;
+    bool result = clapc_parse_safe(args, &argv_ptr, &error);
+
+    expect(!result);
+    expect(error != NULL);
+
+    free(error);
+    clapc_args_free(args);
+  }
+}
+
+/**
+ * Ensure that growing a list doesn't allocate for every item.
+ */
+void large_list(void)
+{
+  if (!CTEST_COUNTS_ALLOCATIONS) {
+    test_skip();
+    return;
+  }
+
+  enum { SHARDS = 10000 };
+
+  s_clap_list shards = { 0 };
+  s_clap_arg shard_arg = {
+    .name = "shard",
+    .type = CLAP_ARG_TYPE_INT_LIST,
+    .dest = &shards,
+  };
+
+  s_clap_arg* args[] = { &shard_arg, NULL };
+
+  char** argv = malloc((SHARDS * 2 + 2) * sizeof(char*));
+  char* numbers = malloc(SHARDS * 8);
+  argv[0] = "clapc_test";
+  for (int i = 0; i < SHARDS; i++) {
+    argv[i * 2 + 1] = "--shard";
+    argv[i * 2 + 2] = numbers + i * 8;
+    snprintf(argv[i * 2 + 2], 8, "%d", i);
+  }
+  argv[SHARDS * 2 + 1] = NULL;
+
+  char* error;
+  char** argv_ptr = argv;
+  size_t before = allocation_count();
+  bool result = clapc_parse_safe(args, &argv_ptr, &error);
+  size_t after = allocation_count();
+
+  expect(result);
+  expect(shards.count == SHARDS);
+  expect(((int*)shards.items)[SHARDS - 1] == SHARDS - 1);
+  // One allocation per doubling of the buffer
+  expect(after - before < 16);
+
+  clapc_args_free(args);
+  free(numbers);
+  free(argv);
+}
+
+/**
+ * Ensure that a generated parser behaves like clapc_parse_safe does with the
+ * same options.
+ */
+void generated_parser(void)
+{
+  char* argv[] = { "clapc_test", "-j", "false", "--jobs=4", "-t", "2.5",
+    "--out", "a", "--output", "b", "file", NULL };
+
+  s_gen_test_options options = { 0 };
+  char* error;
+  char** argv_ptr = argv;
+  bool result = gen_test_parse(&options, &argv_ptr, &error);
+
+  expect(result);
+  expect(options.present.json && options.json == false);
+  expect(options.present.jobs && options.jobs == 4);
+  expect(options.present.job_timeout && options.job_timeout == 2.5f);
+  expect(options.present.out && options.out == argv[7]);
+  expect(options.present.output && options.output == argv[9]);
+  expect(options.output_len == 1);
+  expect(argv_ptr == &argv[10]);
+
+  char** interpreted_argv_ptr = argv;
+  result = clapc_parse_safe(gen_test_args, &interpreted_argv_ptr, &error);
+
+  expect(result);
+  expect(interpreted_argv_ptr == argv_ptr);
+  expect(clap_arg_get_bool(gen_test_args[0]) == options.json);
+  expect(clap_arg_get_int(gen_test_args[1]) == options.jobs);
+  expect(clap_arg_get_float(gen_test_args[2]) == options.job_timeout);
+
+  clapc_args_free(gen_test_args);
+
+  // Names that are prefixes of, or extend, known names are rejected
+  const char* invalid[] = { "--ou", "--outputs", "--job", "-x", NULL };
+  for (int i = 0; invalid[i] != NULL; i++) {
+    char* invalid_argv[] = { "clapc_test", (char*)invalid[i], "a", NULL };
+    argv_ptr = invalid_argv;
+    result = gen_test_parse(&options, &argv_ptr, &error);
+
+    expect(!result);
+    expect(error != NULL);
+
+    free(error);
+  }
+}
+
+/**
+ * Ensure that subcommands are chosen by name, and that each command parses its
+ * own arguments.
+ */
+void subcommands(void)
+{
+  s_clap_arg verbose_arg = {
+    .name = "verbose",
+    .short_name = 'v',
+    .type = CLAP_ARG_TYPE_BOOL,
+  };
+  s_clap_arg short_arg = {
+    .name = "short",
+    .short_name = 's',
+    .type = CLAP_ARG_TYPE_BOOL,
+  };
+  s_clap_arg message_arg = {
+    .name = "message",
+    .short_name = 'm',
+    .type = CLAP_ARG_TYPE_STRING,
+    .borrow = true,
+  };
+  s_clap_arg fetch_arg = {
+    .name = "fetch",
+    .short_name = 'f',
+    .type = CLAP_ARG_TYPE_BOOL,
+  };
+
+  s_clap_arg* root_args[] = { &verbose_arg, NULL };
+  s_clap_arg* status_args[] = { &short_arg, NULL };
+  s_clap_arg* commit_args[] = { &message_arg, NULL };
+  s_clap_arg* add_args[] = { &fetch_arg, NULL };
+
+  s_clap_command add = { .name = "add", .args = add_args };
+  s_clap_command remote = {
+    .name = "remote",
+    .commands = (s_clap_command*[]) { &add, NULL },
+  };
+  s_clap_command status = { .name = "status", .args = status_args };
+  s_clap_command commit = { .name = "commit", .args = commit_args };
+  s_clap_command root = {
+    .args = root_args,
+    .commands = (s_clap_command*[]) { &status, &commit, &remote, NULL },
+  };
+
+  char* error;
+  s_clap_command* command;
+
+  {
+    char* argv[] = { "clapc_test", "-v", "status", "--short", "file", NULL };
+    char** argv_ptr = argv;
+    bool result = clapc_parse_command(&root, &argv_ptr, &command, &error);
+
+    expect(result);
+    expect(command == &status);
+    expect(clap_arg_get_bool(&verbose_arg) == true);
+    expect(clap_arg_get_bool(&short_arg) == true);
+    expect(argv_ptr == &argv[4]);
+
+    // Only the commands that were chosen are compiled
+    expect(root.spec != NULL && status.spec != NULL);
+    expect(commit.spec == NULL && remote.spec == NULL);
+  }
+
+  {
+    char* argv[] = { "clapc_test", "remote", "add", "-f", NULL };
+    char** argv_ptr = argv;
+    bool result = clapc_parse_command(&root, &argv_ptr, &command, &error);
+
+    expect(result);
+    expect(command == &add);
+    expect(clap_arg_get_bool(&fetch_arg) == true);
+    expect(*argv_ptr == NULL);
+  }
+
+  {
+    // A command's arguments are not valid for other commands
+    char* argv[] = { "clapc_test", "status", "-m", "message", NULL };
+    char** argv_ptr = argv;
+    bool result = clapc_parse_command(&root, &argv_ptr, &command, &error);
+
+    expect(!result);
+    expect(error != NULL);
+    expect(strcmp(error, "Invalid argument 'm'\n") == 0);
+
+    free(error);
+  }
+
+  {
+    char* argv[] = { "clapc_test", "stash", NULL };
+    char** argv_ptr = argv;
+    bool result = clapc_parse_command(&root, &argv_ptr, &command, &error);
+
+    expect(!result);
+    expect(error != NULL);
+    expect(strcmp(error, "Unknown command 'stash'\n") == 0);
+
+    free(error);
+  }
+
+  {
+    // Whatever follows "--" is a positional argument, even a command's name
+    char* argv[] = { "clapc_test", "-v", "--", "status", NULL };
+    char** argv_ptr = argv;
+    bool result = clapc_parse_command(&root, &argv_ptr, &command, &error);
+
+    expect(result);
+    expect(command == &root);
+    expect(argv_ptr == &argv[3]);
+  }
+
+  {
+    // Without a subcommand, the root command is chosen
+    char* argv[] = { "clapc_test", "-v", NULL };
+    char** argv_ptr = argv;
+    bool result = clapc_parse_command(&root, &argv_ptr, &command, &error);
+
+    expect(result);
+    expect(command == &root);
+  }
+
+  clapc_args_free(root_args);
+  clapc_args_free(status_args);
+  clapc_args_free(commit_args);
+  clapc_args_free(add_args);
+  clapc_command_free(&root);
+
+  expect(root.spec == NULL && status.spec == NULL && remote.index == NULL);
+}
+
+/**
+ * Ensure that the arguments of commands that aren't chosen are not validated.
+ */
+void lazy_subcommands(void)
+{
+  s_clap_arg a = { .name = "same", .type = CLAP_ARG_TYPE_BOOL };
+  s_clap_arg b = { .name = "same", .type = CLAP_ARG_TYPE_BOOL };
+  s_clap_arg* broken_args[] = { &a, &b, NULL };
+
+  s_clap_command broken = { .name = "broken", .args = broken_args };
+  s_clap_command fine = { .name = "fine" };
+  s_clap_command root = {
+    .commands = (s_clap_command*[]) { &broken, &fine, NULL },
+  };
+
+  char* error;
+  s_clap_command* command;
+
+  {
+    char* argv[] = { "clapc_test", "fine", NULL };
+    char** argv_ptr = argv;
+    bool result = clapc_parse_command(&root, &argv_ptr, &command, &error);
+
+    expect(result);
+    expect(command == &fine);
+  }
+
+  {
+    char* argv[] = { "clapc_test", "broken", NULL };
+    char** argv_ptr = argv;
+    bool result = clapc_parse_command(&root, &argv_ptr, &command, &error);
+
+    expect(!result);
+    expect(error != NULL);
+    expect(strcmp(error, "Duplicate argument '--same'\n") == 0);
+
+    free(error);
+  }
+
+  clapc_command_free(&root);
+}
+
+/**
+ * Ensure that arguments not given on the command line are read from the
+ * environment.
+ */
+void environment_fallback(void)
+{
+  int threads = 0;
+  s_clap_arg threads_arg = {
+    .name = "threads",
+    .type = CLAP_ARG_TYPE_INT,
+    .dest = &threads,
+    .env = "APP_THREADS",
+  };
+  s_clap_arg name_arg = {
+    .name = "name",
+    .type = CLAP_ARG_TYPE_STRING,
+    .borrow = true,
+    .env = "APP_NAME",
+  };
+  s_clap_arg verbose_arg = {
+    .name = "verbose",
+    .type = CLAP_ARG_TYPE_BOOL,
+    .env = "APP_VERBOSE",
+  };
+  s_clap_arg ratio_arg = {
+    .name = "ratio",
+    .type = CLAP_ARG_TYPE_FLOAT,
+    .env = "APP_RATIO",
+  };
+  s_clap_arg* args[] = { &threads_arg, &name_arg, &verbose_arg, &ratio_arg,
+    NULL };
+
+  char* envp[] = { "HOME=/root", "APP_THREADS=8", "APP_NAME=first",
+    "APP_NAME=second", "APP_VERBOSE=true", "APP_THREADS_X=1", "APP", NULL };
+
+  char* error;
+  char* argv[] = { "clapc_test", "--threads", "4", NULL };
+  char** argv_ptr = argv;
+  bool result = clapc_parse_safe(args, &argv_ptr, &error);
+  expect(result);
+
+  result = clapc_parse_env(args, envp, &error);
+
+  expect(result);
+  expect(error == NULL);
+  // The command line takes precedence
+  expect(threads == 4);
+  // Like getenv, the first variable with a name wins
+  expect(name_arg.value == envp[2] + strlen("APP_NAME="));
+  expect(name_arg.value_len == strlen("first"));
+  expect(clap_arg_get_bool(&verbose_arg) == true);
+  expect(ratio_arg.value == NULL);
+
+  clapc_args_free(args);
+
+  char* invalid_envp[] = { "APP_THREADS=lots", NULL };
+  result = clapc_parse_env(args, invalid_envp, &error);
+
+  expect(!result);
+  expect(error != NULL);
+  expect(strcmp(error, "Invalid value 'lots' for argument 'APP_THREADS'\n")
+    == 0);
+
+  free(error);
+  clapc_args_free(args);
+}
+
+/**
+ * Ensure that arguments are read from config files, with the command line and
+ * the environment taking precedence.
+ */
+void config_file(void)
+{
+  char* path = write_response_file("# Defaults\n"
+                                    "threads = 2\n"
+                                    "name=\"from file\"\r\n"
+                                    "\n"
+                                    "; repeated keys override earlier ones\n"
+                                    "ratio = 0.5\n"
+                                    "ratio = 0.75\n"
+                                    "[server]\n"
+                                    "  port = 8080  \n"
+                                    "include = a,b\n"
+                                    "include = c");
+
+  s_clap_arg threads_arg = {
+    .name = "threads",
+    .type = CLAP_ARG_TYPE_INT,
+    .env = "APP_THREADS",
+  };
+  s_clap_arg name_arg = {
+    .name = "name",
+    .type = CLAP_ARG_TYPE_STRING,
+    .borrow = true,
+  };
+  s_clap_arg ratio_arg = {
+    .name = "ratio",
+    .type = CLAP_ARG_TYPE_FLOAT,
+  };
+  s_clap_arg port_arg = {
+    .name = "server.port",
+    .type = CLAP_ARG_TYPE_INT,
+    .env = "APP_PORT",
+  };
+  s_clap_arg include_arg = {
+    .name = "server.include",
+    .type = CLAP_ARG_TYPE_STRING_LIST,
+  };
+  s_clap_arg* args[] = { &threads_arg, &name_arg, &ratio_arg, &port_arg,
+    &include_arg, NULL };
+
+  char* error;
+  char* argv[] = { "clapc_test", "--threads", "4", NULL };
+  char** argv_ptr = argv;
+  char* envp[] = { "APP_PORT=9090", NULL };
+
+  expect(clapc_parse_safe(args, &argv_ptr, &error));
+  expect(clapc_parse_env(args, envp, &error));
+  bool result = clapc_parse_config(args, path + 1, &error);
+
+  expect(result);
+  expect(error == NULL);
+  expect(clap_arg_get_int(&threads_arg) == 4);
+  expect(clap_arg_get_int(&port_arg) == 9090);
+  expect(strcmp(clap_arg_get_string(&name_arg), "from file") == 0);
+  expect(name_arg.value_len == strlen("from file"));
+  expect(clap_arg_get_float(&ratio_arg) == 0.75f);
+
+  size_t count;
+  const s_clap_str* items = clap_arg_get_string_list(&include_arg, &count);
+  expect(count == 3);
+  expect(items[0].len == 1 && items[0].data[0] == 'a');
+  expect(items[2].len == 1 && items[2].data[0] == 'c');
+
+  // The file is kept with the response files of the arguments
+  expect(threads_arg.files != NULL);
+  clapc_args_free(args);
+  unlink(path + 1);
+  free(path);
+
+  const char* invalid[] = { "threads = lots", "jobs = 4", "threads", "[server",
+    NULL };
+  const char* errors[] = {
+    "Invalid value 'lots' for argument 'threads'\n",
+    "Unknown key 'jobs' on line 1 of config file '%s'\n",
+    "Invalid line 1 in config file '%s'\n",
+    "Invalid line 1 in config file '%s'\n",
+  };
+  for (int i = 0; invalid[i] != NULL; i++) {
+    path = write_response_file(invalid[i]);
+    result = clapc_parse_config(args, path + 1, &error);
+
+    char expected[128];
+    snprintf(expected, sizeof(expected), errors[i], path + 1);
+
+    expect(!result);
+    expect(error != NULL && strcmp(error, expected) == 0);
+
+    free(error);
+    clapc_args_free(args);
+    unlink(path + 1);
+    free(path);
+  }
+}
+
+/**
+ * Ensure that the help message shows placeholders for values and wraps
+ * descriptions.
+ */
+void help_message(void)
+{
+  s_clap_arg json_arg = {
+    .name = "json",
+    .short_name = 'j',
+    .type = CLAP_ARG_TYPE_BOOL,
+    .description = "If true, output will be in JSON format",
+  };
+  s_clap_arg jobs_arg = {
+    .name = "jobs",
+    .type = CLAP_ARG_TYPE_INT,
+    .description = "How many jobs to run in parallel",
+  };
+  s_clap_arg include_arg = {
+    .short_name = 'I',
+    .type = CLAP_ARG_TYPE_STRING_LIST,
+    .description = "Include",
+  };
+  s_clap_arg long_arg = {
+    .name = "a-really-long-option-name-indeed",
+    .type = CLAP_ARG_TYPE_STRING,
+    .description = "Long one",
+  };
+  s_clap_arg quiet_arg = {
+    .name = "quiet",
+    .type = CLAP_ARG_TYPE_BOOL,
+  };
+  s_clap_arg* args[] = { &json_arg, &jobs_arg, &include_arg, &long_arg,
+    &quiet_arg, NULL };
+
+  size_t len;
+  char* help = clapc_format_help("clapc_test",
+    "A program that does things, described at some length.", args, 40, &len);
+
+  const char* expected = "clapc_test\n"
+                         "\n"
+                         "A program that does things, described at\n"
+                         "some length.\n"
+                         "\n"
+                         "Options:\n"
+                         "  --json, -j       If true, output will\n"
+                         "                   be in JSON format\n"
+                         "  --jobs <int>     How many jobs to run\n"
+                         "                   in parallel\n"
+                         "  -I <string,...>  Include\n"
+                         "  --a-really-long-option-name-indeed <string>\n"
+                         "                   Long one\n"
+                         "  --quiet\n"
+                         "\n";
+
+  expect(help != NULL);
+  expect(strcmp(help, expected) == 0);
+  expect(len == strlen(expected));
+
+  free(help);
+}
+
+/**
+ * Ensure that options are completed from a prefix, and that completion scripts
+ * list every option.
+ */
+void completion(void)
+{
+  s_clap_arg json_arg = {
+    .name = "json",
+    .short_name = 'j',
+    .type = CLAP_ARG_TYPE_BOOL,
+    .description = "Output [JSON]: it's nice",
+  };
+  s_clap_arg jobs_arg = {
+    .name = "jobs",
+    .type = CLAP_ARG_TYPE_INT,
+    .description = "How many jobs to run in parallel",
+  };
+  s_clap_arg include_arg = {
+    .short_name = 'I',
+    .type = CLAP_ARG_TYPE_STRING_LIST,
+  };
+  s_clap_arg* args[] = { &json_arg, &jobs_arg, &include_arg, NULL };
+
+  const char* prefixes[] = { "--j", "--jo", "--x", "-", "-I", "file", NULL };
+  const char* expected[] = {
+    "--json\n--jobs\n",
+    "--jobs\n",
+    "",
+    "--json\n-j\n--jobs\n-I\n",
+    "-I\n",
+    "",
+  };
+  for (int i = 0; prefixes[i] != NULL; i++) {
+    size_t len;
+    char* completions = clapc_completions(args, prefixes[i], &len);
+
+    expect(completions != NULL);
+    expect(strcmp(completions, expected[i]) == 0);
+    expect(len == strlen(expected[i]));
+
+    free(completions);
+  }
+
+  size_t len;
+  char* script
+    = clapc_completion_script(CLAPC_SHELL_BASH, "my-prog", args, &len);
+  expect(strstr(script, "compgen -W '--json -j --jobs -I ' -- \"$cur\"")
+    != NULL);
+  expect(strstr(script, "complete -o default -F _my_prog_complete 'my-prog'")
+    != NULL);
+  free(script);
+
+  script = clapc_completion_script(CLAPC_SHELL_ZSH, "my-prog", args, &len);
+  expect(strstr(script, "'--json[Output \\[JSON\\]\\: it'\\''s nice]'")
+    != NULL);
+  expect(strstr(script, "'--jobs=[How many jobs to run in parallel]"
+                        ":value:_files'")
+    != NULL);
+  free(script);
+
+  script = clapc_completion_script(CLAPC_SHELL_FISH, "my-prog", args, &len);
+  expect(strstr(script, "complete -c 'my-prog' -l 'json' -s 'j' -d "
+                        "'Output [JSON]: it\\'s nice'\n")
+    != NULL);
+  expect(strstr(script, "complete -c 'my-prog' -s 'I' -r\n") != NULL);
+  free(script);
+}
+
+/**
+ * Ensure that statistics are collected if clapc was built with them, and are
+ * zero otherwise.
+ */
+void statistics(void)
+{
+  s_clap_arg output_arg = {
+    .name = "output",
+    .short_name = 'o',
+    .type = CLAP_ARG_TYPE_STRING,
+  };
+  s_clap_arg jobs_arg = {
+    .name = "jobs",
+    .type = CLAP_ARG_TYPE_INT,
+  };
+  s_clap_arg* args[] = { &output_arg, &jobs_arg, NULL };
+
+  clapc_stats_reset();
+
+  char* error;
+  char* argv[] = { "clapc_test", "-o", "file", "--jobs", "4", "x", NULL };
+  char** argv_ptr = argv;
+  expect(clapc_parse_safe(args, &argv_ptr, &error));
+
+  char* invalid_argv[] = { "clapc_test", "--nope", NULL };
+  argv_ptr = invalid_argv;
+  expect(!clapc_parse_safe(args, &argv_ptr, &error));
+  free(error);
+
+  s_clapc_stats stats;
+  if (clapc_stats_get(&stats)) {
+    expect(stats.parses == 2);
+    expect(stats.failures == 1);
+    expect(stats.tokens == 4);
+    // "-o" and "--jobs" are found after 1 and 2 probes, "--nope" after 2
+    expect(stats.lookup_probes == 5);
+    expect(stats.bytes_copied == strlen("file"));
+    // The copy of "file" and the storage of 4
+    expect(stats.allocations == 2);
+  } else {
+    expect(stats.parses == 0 && stats.tokens == 0 && stats.lookup_ns == 0);
+  }
+
+  clapc_args_free(args);
+  clapc_stats_reset();
+}
+
+/**
+ * Ensure that parsing into results leaves the spec and its arguments untouched,
+ * and that results can be reused without allocating.
+ */
+void result_objects(void)
+{
+  s_clap_arg json_arg = {
+    .name = "json",
+    .short_name = 'j',
+    .type = CLAP_ARG_TYPE_BOOL,
+  };
+  s_clap_arg jobs_arg = {
+    .name = "jobs",
+    .type = CLAP_ARG_TYPE_INT,
+  };
+  s_clap_arg output_arg = {
+    .name = "output",
+    .short_name = 'o',
+    .type = CLAP_ARG_TYPE_STRING,
+  };
+  s_clap_arg include_arg = {
+    .short_name = 'I',
+    .type = CLAP_ARG_TYPE_STRING_LIST,
+  };
+  s_clap_arg* args[] = { &json_arg, &jobs_arg, &output_arg, &include_arg,
+    NULL };
+
+  char* error;
+  s_clapc_spec* spec = clapc_spec_compile(args, &error);
+
+  // Computed outside of expect, which pastes the condition into a format
+  size_t remainder = clapc_result_size(spec) % CLAPC_CACHE_LINE;
+  expect(remainder == 0);
+
+  alignas(CLAPC_CACHE_LINE) char first_memory[256];
+  alignas(CLAPC_CACHE_LINE) char second_memory[256];
+  expect(clapc_result_size(spec) <= sizeof(first_memory));
+
+  s_clapc_result first;
+  s_clapc_result second;
+  clapc_result_init(&first, spec, first_memory);
+  clapc_result_init(&second, spec, second_memory);
+
+  char* first_argv[] = { "clapc_test", "-j", "--jobs=4", "-I", "a,b", "x",
+    NULL };
+  char* second_argv[] = { "clapc_test", "-o", "out.txt", "-I", "c", NULL };
+
+  char** argv_ptr = first_argv;
+  expect(clapc_spec_parse_result(spec, &first, &argv_ptr, &error));
+  expect(argv_ptr == &first_argv[5]);
+
+  argv_ptr = second_argv;
+  expect(clapc_spec_parse_result(spec, &second, &argv_ptr, &error));
+  expect(*argv_ptr == NULL);
+
+  expect(clapc_result_has(&first, 0) && first.values[0].boolean == true);
+  expect(clapc_result_has(&first, 1) && first.values[1].integer == 4);
+  expect(!clapc_result_has(&first, 2));
+  expect(first.values[3].list.count == 2);
+
+  expect(!clapc_result_has(&second, 0) && !clapc_result_has(&second, 1));
+  expect(clapc_result_has(&second, 2));
+  expect(second.values[2].string.data == second_argv[2]);
+  expect(second.values[2].string.len == strlen("out.txt"));
+  expect(second.values[3].list.count == 1);
+
+  // The arguments themselves are never written to
+  expect(json_arg.value == NULL && jobs_arg.value == NULL);
+  expect(output_arg.value == NULL && include_arg.value == NULL);
+
+  // Parsing again forgets the previous values but keeps the list buffers
+  argv_ptr = second_argv;
+  size_t before = allocation_count();
+  expect(clapc_spec_parse_result(spec, &first, &argv_ptr, &error));
+  size_t after = allocation_count();
+
+  expect(after == before);
+  expect(!clapc_result_has(&first, 0) && first.values[0].boolean == false);
+  expect(clapc_result_has(&first, 2));
+  expect(first.values[3].list.count == 1);
+
+  // Response files are kept on the result rather than on the arguments
+  char* file = write_response_file("-o from_file.txt");
+  char* file_argv[] = { "clapc_test", file, NULL };
+  argv_ptr = file_argv;
+  expect(clapc_spec_parse_result(spec, &second, &argv_ptr, &error));
+  expect(second.values[2].string.len == strlen("from_file.txt"));
+  expect(second.files != NULL && json_arg.files == NULL);
+  unlink(file + 1);
+  free(file);
+
+  // Errors are reported like everywhere else
+  char* invalid_argv[] = { "clapc_test", "--jobs", "many", NULL };
+  argv_ptr = invalid_argv;
+  expect(!clapc_spec_parse_result(spec, &first, &argv_ptr, &error));
+  expect(strcmp(error, "Invalid value 'many' for argument '--jobs'\n") == 0);
+  free(error);
+
+  clapc_result_free(&first);
+  clapc_result_free(&second);
+  expect(second.files == NULL);
+  clapc_spec_free(spec);
+}
+
+/**
+ * Ensure that batches parse every line into its own row of the columns, no
+ * matter which thread parsed it.
+ */
+void batch_parsing(void)
+{
+  s_clap_arg jobs_arg = {
+    .name = "jobs",
+    .type = CLAP_ARG_TYPE_INT,
+  };
+  s_clap_arg verbose_arg = {
+    .short_name = 'v',
+    .type = CLAP_ARG_TYPE_BOOL,
+  };
+  s_clap_arg include_arg = {
+    .short_name = 'I',
+    .type = CLAP_ARG_TYPE_STRING_LIST,
+  };
+  s_clap_arg* args[] = { &jobs_arg, &verbose_arg, &include_arg, NULL };
+
+  char* error;
+  s_clapc_spec* spec = clapc_spec_compile(args, &error);
+
+  // Enough lines for every thread to get (and steal) a few blocks
+  const size_t count = 1000;
+  char* buffer = malloc(count * 32 + 1);
+  size_t len = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (i % 100 == 99) {
+      len += (size_t)sprintf(buffer + len, "--jobs many\n");
+    } else if (i == 500) {
+      len += (size_t)sprintf(buffer + len, "-I 'unterminated\n");
+    } else {
+      len += (size_t)sprintf(buffer + len, "--jobs %zu%s -I a,b \"x %zu\"\n",
+        i, i % 2 ? " -v" : "", i);
+    }
+  }
+
+  s_clapc_batch batch;
+  expect(clapc_parse_batch_lines(spec, buffer, len, 4, &batch, &error));
+  expect(batch.count == count);
+  expect(batch.error_count == count / 100 + 1);
+
+  bool all_match = true;
+  for (size_t i = 0; i < count; i++) {
+    if (i % 100 == 99 || i == 500) {
+      all_match &= batch.errors[i] != NULL && batch.rest[i] == NULL;
+      all_match &= !clapc_batch_has(&batch, 0, i);
+      continue;
+    }
+
+    char rest[32];
+    snprintf(rest, sizeof(rest), "x %zu", i);
+    all_match &= batch.errors[i] == NULL;
+    all_match &= clapc_batch_has(&batch, 0, i)
+      && batch.columns[0][i].integer == (int)i;
+    all_match &= (bool)clapc_batch_has(&batch, 1, i) == (i % 2 == 1);
+    all_match &= batch.columns[2][i].list.count == 2;
+    all_match &= strcmp(batch.rest[i][0], rest) == 0;
+  }
+  expect(all_match);
+  expect(strcmp(batch.errors[99],
+           "Invalid value 'many' for argument '--jobs'\n")
+    == 0);
+  expect(strcmp(batch.errors[500], "Unterminated quote in line 501\n") == 0);
+
+  // The arguments themselves are never written to
+  expect(jobs_arg.value == NULL && include_arg.value == NULL);
+
+  clapc_batch_free(&batch);
+  free(buffer);
+
+  char* first[] = { "clapc_test", "--jobs", "1", NULL };
+  char* second[] = { "clapc_test", "-v", "file", NULL };
+  char* third[] = { "clapc_test", "-x", NULL };
+  char** argvs[] = { first, second, third };
+
+  expect(clapc_parse_batch(spec, argvs, 3, 2, &batch, &error));
+  expect(batch.error_count == 1);
+  expect(batch.columns[0][0].integer == 1 && !clapc_batch_has(&batch, 1, 0));
+  expect(clapc_batch_has(&batch, 1, 1) && batch.rest[1] == &second[2]);
+  expect(strcmp(batch.errors[2], "Invalid argument 'x'\n") == 0);
+  clapc_batch_free(&batch);
+
+  // Response files are never expanded in batches, neither in argv nor in the
+  // lines of a buffer
+  char* path = write_response_file("--jobs 7");
+  char* unexpanded[] = { "clapc_test", path, NULL };
+  char** response_argvs[] = { unexpanded };
+  expect(clapc_parse_batch(spec, response_argvs, 1, 1, &batch, &error));
+  expect(batch.error_count == 0 && !clapc_batch_has(&batch, 0, 0));
+  expect(batch.rest[0] == &unexpanded[1]);
+  clapc_batch_free(&batch);
+
+  char line[64];
+  len = (size_t)snprintf(line, sizeof(line), "%s\n", path);
+  expect(clapc_parse_batch_lines(spec, line, len, 1, &batch, &error));
+  expect(batch.error_count == 0 && !clapc_batch_has(&batch, 0, 0));
+  expect(strcmp(batch.rest[0][0], path) == 0);
+  clapc_batch_free(&batch);
+
+  unlink(path + 1);
+  free(path);
+  clapc_spec_free(spec);
+}
+
+/**
+ * Ensure that command strings are split like a shell would, and can be parsed
+ * without allocating.
+ */
+void command_strings(void)
+{
+  char buffer[] = "--output  '/a path/with spaces' \t-I\vinclude,"
+                  "some/really/long/directory/name\\ escaped "
+                  "\"say \\\"hi\\\"\" ''\n@response_file";
+  char* argv[CLAPC_TOKENIZE_CAPACITY(sizeof(buffer))];
+  size_t count;
+  char* error;
+
+  size_t capacity = sizeof(argv) / sizeof(char*);
+  size_t len = strlen(buffer);
+  expect(clapc_tokenize(buffer, len, argv, capacity, &count, &error));
+  expect(count == 7);
+  expect(strcmp(argv[0], "--output") == 0);
+  expect(strcmp(argv[1], "/a path/with spaces") == 0);
+  expect(strcmp(argv[2], "-I") == 0);
+  expect(strcmp(argv[3], "include,some/really/long/directory/name escaped")
+    == 0);
+  expect(strcmp(argv[4], "say \"hi\"") == 0);
+  expect(strcmp(argv[5], "") == 0);
+  expect(strcmp(argv[6], "@response_file") == 0);
+  expect(argv[7] == NULL);
+
+  char unterminated[] = "--output 'file";
+  expect(!clapc_tokenize(
+    unterminated, strlen(unterminated), argv, 8, &count, &error));
+  expect(strcmp(error, "Unterminated quote\n") == 0);
+  free(error);
+
+  char too_many[] = "a b c";
+  expect(!clapc_tokenize(too_many, strlen(too_many), argv, 3, &count, &error));
+  expect(strcmp(error, "Too many tokens\n") == 0);
+  free(error);
+
+  s_clap_arg output_arg = {
+    .name = "output",
+    .type = CLAP_ARG_TYPE_STRING,
+  };
+  s_clap_arg verbose_arg = {
+    .short_name = 'v',
+    .type = CLAP_ARG_TYPE_BOOL,
+  };
+  s_clap_arg* args[] = { &output_arg, &verbose_arg, NULL };
+  s_clapc_spec* spec = clapc_spec_compile(args, &error);
+
+  alignas(CLAPC_CACHE_LINE) char memory[128];
+  s_clapc_result result;
+  clapc_result_init(&result, spec, memory);
+
+  // "@path" tokens in strings are never expanded
+  char command[] = "-v --output \"out file\" @/etc/passwd";
+  char* table[CLAPC_TOKENIZE_CAPACITY(sizeof(command)) + 1];
+  char** argv_ptr = table;
+
+  size_t before = allocation_count();
+  expect(clapc_spec_parse_string(spec, &result, command, strlen(command),
+    &argv_ptr, sizeof(table) / sizeof(char*), &error));
+  size_t after = allocation_count();
+
+  expect(after == before);
+  expect(clapc_result_has(&result, 1));
+  expect(strcmp(result.values[0].string.data, "out file") == 0);
+  expect(strcmp(argv_ptr[0], "@/etc/passwd") == 0 && argv_ptr[1] == NULL);
+
+  clapc_result_free(&result);
+  clapc_spec_free(spec);
+}
+
+/**
+ * Parse `argv` with and without compiling `args`, and check that both either
+ * succeed or fail with `expected_error`.
+ */
+static bool parses_with_error(
+  s_clap_arg* args[], char** argv, const char* expected_error)
+{
+  char* error;
+  char** argv_ptr = argv;
+  bool matches = true;
+
+  bool result = clapc_parse_safe(args, &argv_ptr, &error);
+  matches &= expected_error ? !result && strcmp(error, expected_error) == 0
+                            : result;
+  free(error);
+  clapc_args_free(args);
+
+  s_clapc_spec* spec = clapc_spec_compile(args, &error);
+  argv_ptr = argv;
+  result = clapc_spec_parse(spec, &argv_ptr, &error);
+  matches &= expected_error ? !result && strcmp(error, expected_error) == 0
+                            : result;
+  free(error);
+  clapc_args_free(args);
+  clapc_spec_free(spec);
+
+  return matches;
+}
+
+/**
+ * Ensure that required arguments, conflicts, dependencies, groups and unique
+ * arguments are checked, the same way with and without a compiled spec.
+ */
+void constraints(void)
+{
+  s_clap_arg input_arg = {
+    .name = "input",
+    .short_name = 'i',
+    .type = CLAP_ARG_TYPE_STRING,
+    .required = true,
+    .unique = true,
+  };
+  s_clap_arg json_arg = {
+    .name = "json",
+    .type = CLAP_ARG_TYPE_BOOL,
+    .conflicts_with = (const char*[]) { "yaml", NULL },
+  };
+  s_clap_arg yaml_arg = {
+    .name = "yaml",
+    .type = CLAP_ARG_TYPE_BOOL,
+  };
+  s_clap_arg user_arg = {
+    .name = "user",
+    .type = CLAP_ARG_TYPE_STRING,
+    .depends_on = (const char*[]) { "password", NULL },
+  };
+  s_clap_arg password_arg = {
+    .name = "password",
+    .type = CLAP_ARG_TYPE_STRING,
+  };
+  s_clap_arg quiet_arg = {
+    .short_name = 'q',
+    .type = CLAP_ARG_TYPE_BOOL,
+    .group = "verbosity",
+  };
+  s_clap_arg verbose_arg = {
+    .short_name = 'v',
+    .type = CLAP_ARG_TYPE_BOOL,
+    .group = "verbosity",
+  };
+  s_clap_arg* args[] = { &input_arg, &json_arg, &yaml_arg, &user_arg,
+    &password_arg, &quiet_arg, &verbose_arg, NULL };
+
+  expect(parses_with_error(args,
+    (char*[]) { "clapc_test", "-i", "a", "--json", "--user", "me",
+      "--password", "secret", "-v", NULL },
+    NULL));
+  expect(parses_with_error(args, (char*[]) { "clapc_test", "--json", NULL },
+    "Missing required argument '--input'\n"));
+  expect(parses_with_error(args,
+    (char*[]) { "clapc_test", "-i", "a", "--yaml", "--json", NULL },
+    "Arguments '--json' and '--yaml' can't be used together\n"));
+  expect(parses_with_error(args,
+    (char*[]) { "clapc_test", "-i", "a", "--user", "me", NULL },
+    "Argument '--user' requires '--password'\n"));
+  expect(parses_with_error(args,
+    (char*[]) { "clapc_test", "-i", "a", "-v", "-q", NULL },
+    "Arguments '-q' and '-v' can't be used together\n"));
+  expect(parses_with_error(args,
+    (char*[]) { "clapc_test", "-i", "a", "--input=b", NULL },
+    "Argument '--input' given more than once\n"));
+
+  // Names in constraints must exist
+  s_clap_arg broken_arg = {
+    .name = "broken",
+    .type = CLAP_ARG_TYPE_BOOL,
+    .depends_on = (const char*[]) { "missing", NULL },
+  };
+  s_clap_arg* broken_args[] = { &broken_arg, NULL };
+  char* error;
+  expect(clapc_spec_compile(broken_args, &error) == NULL);
+  expect(strcmp(error, "Unknown argument '--missing' in constraints of "
+                       "'--broken'\n")
+    == 0);
+  free(error);
+
+  // Required arguments with a variable may come from the environment instead
+  s_clap_arg token_arg = {
+    .name = "token",
+    .type = CLAP_ARG_TYPE_STRING,
+    .required = true,
+    .env = "CLAPC_TEST_TOKEN",
+  };
+  s_clap_arg* env_args[] = { &token_arg, NULL };
+  char* argv[] = { "clapc_test", NULL };
+  char** argv_ptr = argv;
+  expect(clapc_parse_safe(env_args, &argv_ptr, &error));
+  expect(!clapc_parse_env(env_args, (char*[]) { "OTHER=1", NULL }, &error));
+  expect(strcmp(error,
+           "Missing required argument '--token' (or variable "
+           "'CLAPC_TEST_TOKEN')\n")
+    == 0);
+  free(error);
+  expect(clapc_parse_env(
+    env_args, (char*[]) { "CLAPC_TEST_TOKEN=abc", NULL }, &error));
+  clapc_args_free(env_args);
+
+  // Results have no environment to fall back on, so every required argument is
+  // checked while parsing
+  s_clapc_spec* spec = clapc_spec_compile(env_args, &error);
+  alignas(CLAPC_CACHE_LINE) char memory[CLAPC_CACHE_LINE];
+  expect(clapc_result_size(spec) <= sizeof(memory));
+  s_clapc_result result;
+  clapc_result_init(&result, spec, memory);
+  argv_ptr = argv;
+  expect(!clapc_spec_parse_result(spec, &result, &argv_ptr, &error));
+  expect(strcmp(error, "Missing required argument '--token'\n") == 0);
+  free(error);
+  clapc_result_free(&result);
+  clapc_spec_free(spec);
+}
+
+/**
+ * Ensure that unknown long options one edit away from an argument suggest it,
+ * the same way with and without a compiled spec.
+ */
+void suggestions(void)
+{
+  s_clap_arg jobs_arg = {
+    .name = "jobs",
+    .type = CLAP_ARG_TYPE_INT,
+  };
+  s_clap_arg json_arg = {
+    .name = "json",
+    .short_name = 'j',
+    .type = CLAP_ARG_TYPE_BOOL,
+  };
+  s_clap_arg output_arg = {
+    .name = "output",
+    .type = CLAP_ARG_TYPE_STRING,
+  };
+  s_clap_arg host_arg = {
+    .name = "host",
+    .type = CLAP_ARG_TYPE_STRING,
+  };
+  s_clap_arg post_arg = {
+    .name = "post",
+    .type = CLAP_ARG_TYPE_BOOL,
+  };
+  s_clap_arg* args[]
+    = { &jobs_arg, &json_arg, &output_arg, &host_arg, &post_arg, NULL };
+
+  // Replaced, swapped, missing and extra characters
+  expect(parses_with_error(args, (char*[]) { "clapc_test", "--jobz", NULL },
+    "Invalid argument 'jobz', did you mean '--jobs'?\n"));
+  expect(parses_with_error(args, (char*[]) { "clapc_test", "--jbos", NULL },
+    "Invalid argument 'jbos', did you mean '--jobs'?\n"));
+  expect(parses_with_error(args, (char*[]) { "clapc_test", "--ouput", NULL },
+    "Invalid argument 'ouput', did you mean '--output'?\n"));
+  expect(parses_with_error(args,
+    (char*[]) { "clapc_test", "--outputs=a", NULL },
+    "Invalid argument 'outputs', did you mean '--output'?\n"));
+
+  expect(parses_with_error(args, (char*[]) { "clapc_test", "--jos", NULL },
+    "Invalid argument 'jos', did you mean '--jobs'?\n"));
+  expect(parses_with_error(args, (char*[]) { "clapc_test", "--jsno", NULL },
+    "Invalid argument 'jsno', did you mean '--json'?\n"));
+
+  // "most" is one edit away from both "host" and "post", the first one wins
+  expect(parses_with_error(args, (char*[]) { "clapc_test", "--most", NULL },
+    "Invalid argument 'most', did you mean '--host'?\n"));
+  expect(parses_with_error(args, (char*[]) { "clapc_test", "--input", NULL },
+    "Invalid argument 'input'\n"));
+  expect(parses_with_error(args, (char*[]) { "clapc_test", "-k", NULL },
+    "Invalid argument 'k'\n"));
+
+  // Without long names, there is nothing to suggest
+  s_clap_arg short_arg = {
+    .short_name = 'J',
+    .type = CLAP_ARG_TYPE_INT,
+  };
+  s_clap_arg* short_args[] = { &short_arg, NULL };
+  expect(parses_with_error(short_args,
+    (char*[]) { "clapc_test", "--jobs", NULL }, "Invalid argument 'jobs'\n"));
+}
+
+#define parse_size(str, out) clapc_parse_size((str), strlen(str), (out))
+#define parse_duration(str, out) clapc_parse_duration((str), strlen(str), (out))
+
+void sizes_and_durations(void)
+{
+  uint64_t value;
+
+  expect(parse_size("4096", &value) == CLAPC_NUMBER_OK && value == 4096);
+  expect(parse_size("512M", &value) == CLAPC_NUMBER_OK
+    && value == 512ull << 20);
+  expect(parse_size("1.5GiB", &value) == CLAPC_NUMBER_OK
+    && value == 3ull << 29);
+  expect(parse_size("4k", &value) == CLAPC_NUMBER_OK && value == 4096);
+  expect(parse_size("2KB", &value) == CLAPC_NUMBER_OK && value == 2048);
+  expect(parse_size("10B", &value) == CLAPC_NUMBER_OK && value == 10);
+  expect(parse_size("15E", &value) == CLAPC_NUMBER_OK
+    && value == 15ull << 60);
+  expect(parse_size("16E", &value) == CLAPC_NUMBER_OUT_OF_RANGE);
+  expect(parse_size("12X", &value) == CLAPC_NUMBER_INVALID);
+  expect(parse_size("M", &value) == CLAPC_NUMBER_INVALID);
+  expect(parse_size("-1K", &value) == CLAPC_NUMBER_INVALID);
+
+  expect(parse_duration("250ms", &value) == CLAPC_NUMBER_OK
+    && value == 250000000);
+  expect(parse_duration("2h", &value) == CLAPC_NUMBER_OK
+    && value == 7200000000000);
+  expect(parse_duration("1h30m", &value) == CLAPC_NUMBER_OK
+    && value == 5400000000000);
+  expect(parse_duration("1.5s", &value) == CLAPC_NUMBER_OK
+    && value == 1500000000);
+  expect(parse_duration("3\xc2\xb5s", &value) == CLAPC_NUMBER_OK
+    && value == 3000);
+  expect(parse_duration("0", &value) == CLAPC_NUMBER_OK && value == 0);
+  expect(parse_duration("5", &value) == CLAPC_NUMBER_INVALID);
+  expect(parse_duration("5x", &value) == CLAPC_NUMBER_INVALID);
+  expect(parse_duration("", &value) == CLAPC_NUMBER_INVALID);
+  expect(parse_duration("1000000d", &value) == CLAPC_NUMBER_OUT_OF_RANGE);
+}
+
+/**
+ * Ensure that 64-bit, size, duration and enum arguments are parsed into their
+ * storage and into results, and that their bad values are reported.
+ */
+void rich_types(void)
+{
+  struct {
+    int64_t offset;
+    uint64_t seed;
+    double ratio;
+    uint64_t cache;
+    uint64_t timeout;
+    int mode;
+  } options = { 0 };
+
+  s_clap_arg offset_arg = {
+    .name = "offset",
+    .type = CLAP_ARG_TYPE_INT64,
+    .dest = &options.offset,
+  };
+  s_clap_arg seed_arg = {
+    .name = "seed",
+    .type = CLAP_ARG_TYPE_UINT64,
+    .dest = &options.seed,
+  };
+  s_clap_arg ratio_arg = {
+    .name = "ratio",
+    .type = CLAP_ARG_TYPE_DOUBLE,
+    .dest = &options.ratio,
+  };
+  s_clap_arg cache_arg = {
+    .name = "cache",
+    .type = CLAP_ARG_TYPE_SIZE,
+    .dest = &options.cache,
+  };
+  s_clap_arg timeout_arg = {
+    .name = "timeout",
+    .short_name = 't',
+    .type = CLAP_ARG_TYPE_DURATION,
+    .dest = &options.timeout,
+  };
+  s_clap_arg mode_arg = {
+    .name = "mode",
+    .type = CLAP_ARG_TYPE_ENUM,
+    .choices = (const char*[]) { "fast", "small", "safe", NULL },
+    .dest = &options.mode,
+  };
+  s_clap_arg* args[] = { &offset_arg, &seed_arg, &ratio_arg, &cache_arg,
+    &timeout_arg, &mode_arg, NULL };
+
+  char* argv[] = { "clapc_test", "--offset=-9223372036854775808", "--seed",
+    "18446744073709551615", "--ratio", "0.1", "--cache", "1.5GiB", "-t",
+    "1h30m", "--mode", "small", NULL };
+
+  char* error;
+  char** argv_ptr = argv;
+  expect(clapc_parse_safe(args, &argv_ptr, &error));
+  expect(options.offset == INT64_MIN);
+  expect(options.seed == UINT64_MAX);
+  expect(options.ratio == 0.1);
+  expect(options.cache == 3ull << 29);
+  expect(options.timeout == 5400000000000);
+  expect(options.mode == 1);
+  expect(clap_arg_get_uint64(&timeout_arg) == 5400000000000);
+  expect(clap_arg_get_enum(&mode_arg) == 1);
+  clapc_args_free(args);
+
+  s_clapc_spec* spec = clapc_spec_compile(args, &error);
+  alignas(CLAPC_CACHE_LINE) char memory[256];
+  expect(clapc_result_size(spec) <= sizeof(memory));
+
+  s_clapc_result result;
+  clapc_result_init(&result, spec, memory);
+  argv_ptr = argv;
+  expect(clapc_spec_parse_result(spec, &result, &argv_ptr, &error));
+  expect(result.values[0].integer64 == INT64_MIN);
+  expect(result.values[1].unsigned64 == UINT64_MAX);
+  expect(result.values[2].real == 0.1);
+  expect(result.values[3].unsigned64 == 3ull << 29);
+  expect(result.values[4].unsigned64 == 5400000000000);
+  expect(result.values[5].integer == 1);
+  clapc_result_free(&result);
+  clapc_spec_free(spec);
+
+  expect(parses_with_error(args,
+    (char*[]) { "clapc_test", "--mode", "safe", NULL }, NULL));
+  expect(options.mode == 2);
+  expect(parses_with_error(args,
+    (char*[]) { "clapc_test", "--mode", "slow", NULL },
+    "Invalid value 'slow' for argument '--mode'\n"));
+  expect(parses_with_error(args,
+    (char*[]) { "clapc_test", "--mode", "fas", NULL },
+    "Invalid value 'fas' for argument '--mode'\n"));
+  expect(parses_with_error(args,
+    (char*[]) { "clapc_test", "--cache", "16E", NULL },
+    "Value out of range for argument '--cache'\n"));
+  expect(parses_with_error(args,
+    (char*[]) { "clapc_test", "-t", "5", NULL },
+    "Invalid value '5' for argument '-t'\n"));
+  expect(parses_with_error(args,
+    (char*[]) { "clapc_test", "--offset", "9223372036854775808", NULL },
+    "Value out of range for argument '--offset'\n"));
+
+  size_t len;
+  char* help = clapc_format_help("clapc_test", NULL, args, 80, &len);
+  expect(strstr(help, "--mode <fast|small|safe>") != NULL);
+  expect(strstr(help, "--timeout, -t <duration>") != NULL);
+  free(help);
+
+  // An enum needs choices, and each of them only once
+  s_clap_arg empty_arg = {
+    .name = "empty",
+    .type = CLAP_ARG_TYPE_ENUM,
+  };
+  s_clap_arg* empty_args[] = { &empty_arg, NULL };
+  expect(clapc_spec_compile(empty_args, &error) == NULL);
+  expect(strcmp(error, "Argument '--empty' has no choices\n") == 0);
+  free(error);
+
+  s_clap_arg twice_arg = {
+    .name = "twice",
+    .type = CLAP_ARG_TYPE_ENUM,
+    .choices = (const char*[]) { "a", "b", "a", NULL },
+  };
+  s_clap_arg* twice_args[] = { &twice_arg, NULL };
+  expect(clapc_spec_compile(twice_args, &error) == NULL);
+  expect(strcmp(error, "Duplicate choice 'a' for argument '--twice'\n") == 0);
+  free(error);
+}
+
+typedef struct {
+  char host[32];
+  uint16_t port;
+} s_address;
+
+/**
+ * Parse "host:port" into an s_address, counting the calls in `data`.
+ */
+static bool parse_address(
+  s_clap_str value, void* dest, void* data, const char** reason)
+{
+  (*(int*)data)++;
+
+  const char* colon = memchr(value.data, ':', value.len);
+  if (colon == NULL || colon == value.data) {
+    *reason = "expected host:port";
+    return false;
+  }
+
+  size_t host_len = (size_t)(colon - value.data);
+  size_t port_len = value.len - host_len - 1;
+  uint64_t port;
+  if (host_len >= sizeof(((s_address*)NULL)->host)
+    || clapc_parse_number(colon + 1, port_len, CLAPC_NUMBER_UINT64, &port)
+      != CLAPC_NUMBER_OK) {
+    return false;
+  }
+  if (port > UINT16_MAX) {
+    *reason = "port out of range";
+    return false;
+  }
+
+  if (dest) {
+    s_address* address = dest;
+    memcpy(address->host, value.data, host_len);
+    address->host[host_len] = '\0';
+    address->port = (uint16_t)port;
+  }
+  return true;
+}
+
+/**
+ * Ensure that custom arguments are parsed by their own function straight into
+ * their storage, and that the reasons it gives for bad values are reported.
+ */
+void custom_values(void)
+{
+  s_address address = { 0 };
+  int calls = 0;
+
+  s_clap_arg listen_arg = {
+    .name = "listen",
+    .short_name = 'l',
+    .type = CLAP_ARG_TYPE_CUSTOM,
+    .dest = &address,
+    .parse = parse_address,
+    .parse_data = &calls,
+  };
+  s_clap_arg* args[] = { &listen_arg, NULL };
+
+  char* error;
+  char* argv[] = { "clapc_test", "--listen", "localhost:8080", NULL };
+  char** argv_ptr = argv;
+  expect(clapc_parse_safe(args, &argv_ptr, &error));
+  expect(strcmp(address.host, "localhost") == 0);
+  expect(address.port == 8080);
+  expect(listen_arg.value == &address);
+  expect(calls == 1);
+  clapc_args_free(args);
+
+  expect(parses_with_error(args,
+    (char*[]) { "clapc_test", "-l", "example.com:443", NULL }, NULL));
+  expect(strcmp(address.host, "example.com") == 0 && address.port == 443);
+  expect(parses_with_error(args,
+    (char*[]) { "clapc_test", "--listen", "8080", NULL },
+    "Invalid value '8080' for argument '--listen': expected host:port\n"));
+  expect(parses_with_error(args,
+    (char*[]) { "clapc_test", "-l", "a:70000", NULL },
+    "Invalid value 'a:70000' for argument '-l': port out of range\n"));
+  expect(parses_with_error(args,
+    (char*[]) { "clapc_test", "--listen", "a:b", NULL },
+    "Invalid value 'a:b' for argument '--listen'\n"));
+
+  // Results keep the value as it was given, and only have it validated
+  s_clapc_spec* spec = clapc_spec_compile(args, &error);
+  alignas(CLAPC_CACHE_LINE) char memory[256];
+  s_clapc_result result;
+  clapc_result_init(&result, spec, memory);
+
+  address = (s_address) { 0 };
+  argv_ptr = argv;
+  expect(clapc_spec_parse_result(spec, &result, &argv_ptr, &error));
+  expect(result.values[0].string.len == strlen("localhost:8080"));
+  expect(strcmp(result.values[0].string.data, "localhost:8080") == 0);
+  expect(address.port == 0);
+
+  argv_ptr = (char*[]) { "clapc_test", "-l", "nope", NULL };
+  expect(!clapc_spec_parse_result(spec, &result, &argv_ptr, &error));
+  expect(strcmp(error,
+           "Invalid value 'nope' for argument '-l': expected host:port\n")
+    == 0);
+  free(error);
+  clapc_result_free(&result);
+  clapc_spec_free(spec);
+
+  s_clap_arg unparsed_arg = {
+    .name = "unparsed",
+    .type = CLAP_ARG_TYPE_CUSTOM,
+  };
+  s_clap_arg* unparsed_args[] = { &unparsed_arg, NULL };
+  expect(clapc_spec_compile(unparsed_args, &error) == NULL);
+  expect(strcmp(error, "Argument '--unparsed' has no parse function\n") == 0);
+  free(error);
+
+  // Without a destination, a given value would look like a missing one
+  s_clap_arg nowhere_arg = {
+    .name = "nowhere",
+    .type = CLAP_ARG_TYPE_CUSTOM,
+    .parse = parse_address,
+    .parse_data = &calls,
+  };
+  s_clap_arg* nowhere_args[] = { &nowhere_arg, NULL };
+  argv_ptr = (char*[]) { "clapc_test", "--nowhere", "a:1", NULL };
+  expect(!clapc_parse_safe(nowhere_args, &argv_ptr, &error));
+  expect(strcmp(error, "Argument '--nowhere' has no destination\n") == 0);
+  free(error);
+  expect(clapc_spec_compile(nowhere_args, &error) == NULL);
+  expect(strcmp(error, "Argument '--nowhere' has no destination\n") == 0);
+  free(error);
+}
+
+/**
+ * Ensure that the checked parsing functions tell which token is at fault and
+ * why, and that rejecting a command line doesn't allocate.
+ */
+void checked_errors(void)
+{
+  int jobs = 0;
+  s_clap_arg jobs_arg = {
+    .name = "jobs",
+    .short_name = 'j',
+    .type = CLAP_ARG_TYPE_INT,
+    .dest = &jobs,
+  };
+  s_clap_arg ports_arg = {
+    .short_name = 'p',
+    .type = CLAP_ARG_TYPE_INT_LIST,
+  };
+  s_clap_arg json_arg = {
+    .name = "json",
+    .type = CLAP_ARG_TYPE_BOOL,
+    .conflicts_with = (const char*[]) { "yaml", NULL },
+  };
+  s_clap_arg yaml_arg = {
+    .name = "yaml",
+    .type = CLAP_ARG_TYPE_BOOL,
+  };
+  s_clap_arg* args[] = { &jobs_arg, &ports_arg, &json_arg, &yaml_arg, NULL };
+
+  s_clapc_error error;
+  char** argv_ptr = (char*[]) { "clapc_test", "--json", "--jbos", "3", NULL };
+  expect(!clapc_parse_checked(args, &argv_ptr, &error));
+  expect(error.code == CLAPC_ERROR_UNKNOWN_ARGUMENT);
+  expect(error.index == 2 && error.offset == 2);
+  expect(strcmp(error.option, "--jbos") == 0);
+  expect(error.value_len == 4 && strncmp(error.value, "jbos", 4) == 0);
+  expect(error.other == &jobs_arg);
+
+  // Messages are the same as the string ones, and are cut to fit the buffer
+  const char* message = "Invalid argument 'jbos', did you mean '--jobs'?\n";
+  char buffer[16];
+  expect(clapc_error_format(&error, NULL, 0) == strlen(message));
+  expect(clapc_error_format(&error, buffer, sizeof(buffer)) == strlen(message));
+  expect(strncmp(buffer, message, sizeof(buffer) - 1) == 0);
+  expect(buffer[sizeof(buffer) - 1] == '\0');
+
+  argv_ptr = (char*[]) { "clapc_test", "--jobs=4x", NULL };
+  expect(!clapc_parse_checked(args, &argv_ptr, &error));
+  expect(error.code == CLAPC_ERROR_INVALID_VALUE);
+  expect(error.index == 1 && error.offset == 7);
+  expect(error.arg == &jobs_arg);
+
+  // The item of a list that was rejected is pointed at
+  argv_ptr = (char*[]) { "clapc_test", "-j", "2", "-p", "80,x", NULL };
+  expect(!clapc_parse_checked(args, &argv_ptr, &error));
+  expect(error.code == CLAPC_ERROR_INVALID_VALUE);
+  expect(error.index == 4 && error.offset == 3);
+  expect(error.arg == &ports_arg && strcmp(error.option, "-p") == 0);
+  clapc_args_free(args);
+
+  argv_ptr = (char*[]) { "clapc_test", "-j", "99999999999", NULL };
+  expect(!clapc_parse_checked(args, &argv_ptr, &error));
+  expect(error.code == CLAPC_ERROR_OUT_OF_RANGE && error.index == 2);
+
+  argv_ptr = (char*[]) { "clapc_test", "--json", "-j", NULL };
+  expect(!clapc_parse_checked(args, &argv_ptr, &error));
+  expect(error.code == CLAPC_ERROR_MISSING_VALUE);
+  expect(error.index == 2 && error.offset == 2);
+
+  // Errors about no single token don't point at one
+  argv_ptr = (char*[]) { "clapc_test", "--yaml", "--json", NULL };
+  expect(!clapc_parse_checked(args, &argv_ptr, &error));
+  expect(error.code == CLAPC_ERROR_CONFLICT && error.index == 0);
+  expect(error.arg == &json_arg && error.other == &yaml_arg);
+  expect(error.option == NULL);
+
+  // Tokens from response files are blamed on the "@path" token
+  char* response_file = write_response_file("-j 1 -p 'a'");
+  argv_ptr = (char*[]) { "clapc_test", "--json", response_file, NULL };
+  expect(!clapc_parse_checked(args, &argv_ptr, &error));
+  expect(error.code == CLAPC_ERROR_INVALID_VALUE && error.index == 2);
+  expect(strcmp(error.option, "-p") == 0);
+  unlink(response_file + 1);
+  free(response_file);
+  clapc_args_free(args);
+
+  if (!CTEST_COUNTS_ALLOCATIONS) {
+    return;
+  }
+
+  char* string_error;
+  s_clapc_spec* spec = clapc_spec_compile(args, &string_error);
+  alignas(CLAPC_CACHE_LINE) char memory[256];
+  s_clapc_result result;
+  clapc_result_init(&result, spec, memory);
+
+  // Values are parsed into the result, so only the error could allocate
+  char* argv[] = { "clapc_test", "--json", "-j", "nope", NULL };
+  size_t before = allocation_count();
+  argv_ptr = argv;
+  expect(!clapc_spec_parse_result_checked(spec, &result, &argv_ptr, &error));
+  clapc_error_format(&error, buffer, sizeof(buffer));
+  expect(allocation_count() == before);
+
+  clapc_result_free(&result);
+  clapc_spec_free(spec);
+}
+
+/**
+ * What is still allocated from a counting allocator.
+ */
+typedef struct {
+  size_t blocks;
+  size_t bytes;
+} s_allocated;
+
+static void* counting_alloc(void* context, size_t size)
+{
+  s_allocated* allocated = context;
+  allocated->blocks++;
+  allocated->bytes += size;
+  return malloc(size);
+}
+
+static void* counting_realloc(
+  void* context, void* ptr, size_t old_size, size_t size)
+{
+  s_allocated* allocated = context;
+  allocated->blocks += ptr == NULL;
+  allocated->bytes += size - old_size;
+  return realloc(ptr, size);
+}
+
+static void counting_free(void* context, void* ptr, size_t size)
+{
+  s_allocated* allocated = context;
+  allocated->blocks--;
+  allocated->bytes -= size;
+  free(ptr);
+}
+
+void allocators(void)
+{
+  s_clap_arg jobs_arg = {
+    .name = "jobs",
+    .type = CLAP_ARG_TYPE_INT,
+  };
+  s_clap_arg output_arg = {
+    .name = "output",
+    .type = CLAP_ARG_TYPE_STRING,
+  };
+  s_clap_arg include_arg = {
+    .short_name = 'I',
+    .type = CLAP_ARG_TYPE_STRING_LIST,
+  };
+  s_clap_list ports = { 0 };
+  s_clap_arg ports_arg = {
+    .short_name = 'p',
+    .type = CLAP_ARG_TYPE_INT_LIST,
+    .dest = &ports,
+  };
+  s_clap_arg json_arg = {
+    .name = "json",
+    .type = CLAP_ARG_TYPE_BOOL,
+  };
+  s_clap_arg* args[]
+    = { &jobs_arg, &output_arg, &include_arg, &ports_arg, &json_arg, NULL };
+  char* argv[] = { "clapc_test", "--jobs", "4", "--output", "out.txt",
+    "--output", "a.out", "-I", "a,b", "-p", "1,2", "--json", NULL };
+
+  // Everything is given back to the allocator it came from, at the right size
+  s_allocated allocated = { 0 };
+  s_clapc_allocator counting = {
+    .alloc = counting_alloc,
+    .realloc = counting_realloc,
+    .free = counting_free,
+    .context = &allocated,
+  };
+  s_clapc_error error;
+  char** argv_ptr = argv;
+  expect(clapc_parse_with_allocator(args, &argv_ptr, &counting, &error));
+  expect(clap_arg_get_int(&jobs_arg) == 4);
+  expect(strcmp(clap_arg_get_string(&output_arg), "a.out") == 0);
+  expect(clap_arg_get_bool(&json_arg));
+  expect(jobs_arg.allocator == &counting && ports_arg.allocator == &counting);
+  // jobs, output, the include list and its items, the ports items and json
+  expect(allocated.blocks == 6);
+  clapc_args_free(args);
+  expect(allocated.blocks == 0 && allocated.bytes == 0);
+  expect(ports.items == NULL && jobs_arg.allocator == NULL);
+
+  // With an arena, one reset releases everything. The blocks are small, so
+  // that values are spread over several of them.
+  s_clapc_arena arena;
+  clapc_arena_init(&arena, 32);
+  argv_ptr = argv;
+  expect(clapc_parse_with_allocator(args, &argv_ptr, &arena.allocator, &error));
+  size_t count;
+  const s_clap_str* includes = clap_arg_get_string_list(&include_arg, &count);
+  expect(count == 2 && includes[1].len == 1 && *includes[1].data == 'b');
+  expect(ports.count == 2 && ((int*)ports.items)[1] == 2);
+  expect(strcmp(clap_arg_get_string(&output_arg), "a.out") == 0);
+
+  // Values from before the reset are dropped instead of reused
+  clapc_arena_reset(&arena);
+  argv_ptr = (char*[]) { "clapc_test", "-p", "7", "--output", "b", NULL };
+  expect(clapc_parse_with_allocator(args, &argv_ptr, &arena.allocator, &error));
+  expect(jobs_arg.value == NULL && include_arg.value == NULL);
+  expect(json_arg.value == NULL);
+  expect(ports.count == 1 && ((int*)ports.items)[0] == 7);
+  expect(strcmp(clap_arg_get_string(&output_arg), "b") == 0);
+
+  // Once the arena has grown, parsing into it again doesn't allocate
+  if (CTEST_COUNTS_ALLOCATIONS) {
+    clapc_arena_reset(&arena);
+    size_t before = allocation_count();
+    argv_ptr = (char*[]) { "clapc_test", "-p", "8", "--output", "c", NULL };
+    expect(
+      clapc_parse_with_allocator(args, &argv_ptr, &arena.allocator, &error));
+    expect(allocation_count() == before);
+  }
+
+  // The lists of results come from their allocator too
+  char* string_error;
+  s_clapc_spec* spec = clapc_spec_compile(args, &string_error);
+  alignas(CLAPC_CACHE_LINE) char memory[256];
+  s_clapc_result result;
+  clapc_result_init(&result, spec, memory);
+  result.allocator = &arena.allocator;
+
+  clapc_arena_reset(&arena);
+  argv_ptr = (char*[]) { "clapc_test", "-I", "x,y,z", NULL };
+  expect(clapc_spec_parse_result_checked(spec, &result, &argv_ptr, &error));
+  expect(result.values[2].list.count == 3);
+
+  clapc_arena_reset(&arena);
+  argv_ptr = (char*[]) { "clapc_test", "-I", "w", NULL };
+  expect(clapc_spec_parse_result_checked(spec, &result, &argv_ptr, &error));
+  expect(result.values[2].list.count == 1);
+  expect(*((s_clap_str*)result.values[2].list.items)[0].data == 'w');
+  clapc_spec_free(spec);
+
+  // The help message is the same, and exactly as large as its length says
+  size_t len;
+  char* help = clapc_format_help("clapc_test", "Allocators", args, 80, &len);
+  size_t counted_len;
+  char* counted_help = clapc_format_help_with_allocator(
+    "clapc_test", "Allocators", args, 80, &counting, &counted_len);
+  expect(counted_len == len && memcmp(help, counted_help, len + 1) == 0);
+  expect(allocated.blocks == 1 && allocated.bytes == len + 1);
+  counting_free(&allocated, counted_help, counted_len + 1);
+  free(help);
+
+  // Parsing with malloc after a reset doesn't touch the arena's values either
+  argv_ptr = (char*[]) { "clapc_test", "-p", "9", NULL };
+  expect(clapc_parse_with_allocator(args, &argv_ptr, &arena.allocator, &error));
+  clapc_arena_reset(&arena);
+  argv_ptr = (char*[]) { "clapc_test", "-p", "5", "--output", "d", NULL };
+  expect(clapc_parse_checked(args, &argv_ptr, &error));
+  expect(ports.count == 1 && ((int*)ports.items)[0] == 5);
+  expect(strcmp(clap_arg_get_string(&output_arg), "d") == 0);
+  expect(ports_arg.allocator == NULL && output_arg.allocator == NULL);
+  clapc_args_free(args);
+
+  // The values are gone with the arena, so they are only forgotten
+  argv_ptr = (char*[]) { "clapc_test", "-p", "6", "--output", "e", NULL };
+  expect(clapc_parse_with_allocator(args, &argv_ptr, &arena.allocator, &error));
+  clapc_arena_free(&arena);
+  clapc_args_free(args);
+  expect(output_arg.value == NULL && ports.items == NULL);
+}
+
+/**
+ * The arguments of a program whose command line is turned back into one, see
+ * {@link unparsing}. Each call makes a fresh set, so that a command line can
+ * be parsed twice.
+ */
+typedef struct {
+  s_clap_arg jobs;
+  s_clap_arg ratio;
+  s_clap_arg precise;
+  s_clap_arg limit;
+  s_clap_arg timeout;
+  s_clap_arg mode;
+  s_clap_arg output;
+  s_clap_arg include;
+  s_clap_arg ports;
+  s_clap_arg verbose;
+  s_clap_arg json;
+  s_clap_arg* table[12];
+} s_worker_args;
+
+static const char* worker_modes[] = { "fast", "small", NULL };
+
+static void worker_args_init(s_worker_args* args)
+{
+  // The fields of s_clap_arg are const, so the set is copied in at once
+  memcpy(args,
+    &(s_worker_args) {
+      .jobs = { .name = "jobs", .type = CLAP_ARG_TYPE_INT },
+      .ratio = { .name = "ratio", .type = CLAP_ARG_TYPE_FLOAT },
+      .precise = { .name = "precise", .type = CLAP_ARG_TYPE_DOUBLE },
+      .limit = { .name = "limit", .type = CLAP_ARG_TYPE_SIZE },
+      .timeout = { .name = "timeout", .type = CLAP_ARG_TYPE_DURATION },
+      .mode = {
+        .name = "mode",
+        .type = CLAP_ARG_TYPE_ENUM,
+        .choices = worker_modes,
+      },
+      .output = { .short_name = 'o', .type = CLAP_ARG_TYPE_STRING },
+      .include = { .short_name = 'I', .type = CLAP_ARG_TYPE_STRING_LIST },
+      .ports = { .name = "ports", .type = CLAP_ARG_TYPE_INT_LIST },
+      .verbose = { .short_name = 'v', .type = CLAP_ARG_TYPE_BOOL },
+      .json = { .name = "json", .type = CLAP_ARG_TYPE_BOOL },
+    },
+    sizeof(*args));
+  s_clap_arg* table[] = { &args->jobs, &args->ratio, &args->precise,
+    &args->limit, &args->timeout, &args->mode, &args->output, &args->include,
+    &args->ports, &args->verbose, &args->json, NULL };
+  memcpy(args->table, table, sizeof(table));
+}
+
+/**
+ * Unparse `args` with `overrides` into a single allocation, and check that
+ * every token matches `expected`.
+ *
+ * @return The allocation, which `*argv_ptr` points into.
+ */
+static void* unparse_expecting(s_clap_arg* args[],
+  const s_clapc_override* overrides, size_t override_count,
+  const char* const* expected, char*** argv_ptr)
+{
+  size_t size
+    = clapc_unparse_size("worker", args, overrides, override_count);
+  expect(size > 0);
+  void* memory = malloc(size);
+  char** argv = clapc_unparse(
+    "worker", args, overrides, override_count, memory, size);
+
+  size_t i = 0;
+  for (; expected[i] != NULL; i++) {
+    expect(argv[i] != NULL && strcmp(argv[i], expected[i]) == 0);
+  }
+  expect(argv[i] == NULL);
+  *argv_ptr = argv;
+  return memory;
+}
+
+void unparsing(void)
+{
+  s_worker_args parent;
+  worker_args_init(&parent);
+  char** argv_ptr = (char*[]) { "clapc_test", "--ratio", "0.1", "--precise",
+    "0.1", "--limit", "1.5K", "--timeout", "1m30s", "--mode", "small", "-o",
+    "out dir/a=b", "-I", "a,b", "-I", "c", "--ports", "-80,443", "-v",
+    "--json=false", "--jobs", "-2147483648", NULL };
+  char* error;
+  expect(clapc_parse_safe(parent.table, &argv_ptr, &error));
+
+  // Values are written canonically, in the order of the arguments
+  char** argv;
+  void* memory = unparse_expecting(parent.table, NULL, 0,
+    (const char*[]) { "worker", "--jobs=-2147483648", "--ratio=0.100000001",
+      "--precise=0.10000000000000001", "--limit=1536",
+      "--timeout=90000000000ns", "--mode=small", "-o", "out dir/a=b", "-I",
+      "a,b,c", "--ports=-80,443", "-v", "--json=false", NULL },
+    &argv);
+
+  // Parsing the command line again gives back exactly the same values
+  s_worker_args child;
+  worker_args_init(&child);
+  char** child_argv = argv;
+  expect(clapc_parse_safe(child.table, &child_argv, &error));
+  expect(*child_argv == NULL);
+  expect(clap_arg_get_int(&child.jobs) == INT32_MIN);
+  expect(clap_arg_get_float(&child.ratio) == 0.1f);
+  expect(clap_arg_get_double(&child.precise) == 0.1);
+  expect(clap_arg_get_uint64(&child.limit) == 1536);
+  expect(clap_arg_get_uint64(&child.timeout) == 90000000000);
+  expect(clap_arg_get_enum(&child.mode) == 1);
+  expect(strcmp(clap_arg_get_string(&child.output), "out dir/a=b") == 0);
+  size_t count;
+  const s_clap_str* includes = clap_arg_get_string_list(&child.include, &count);
+  expect(count == 3 && includes[2].len == 1 && *includes[2].data == 'c');
+  const int* ports = clap_arg_get_int_list(&child.ports, &count);
+  expect(count == 2 && ports[0] == -80 && ports[1] == 443);
+  expect(clap_arg_get_bool(&child.verbose));
+  expect(child.json.value && !clap_arg_get_bool(&child.json));
+  clapc_args_free(child.table);
+  free(memory);
+
+  // Overrides change, add and remove values, without touching the parent
+  s_clapc_override overrides[] = {
+    { .arg = &parent.jobs, .value = "8" },
+    { .arg = &parent.output, .value = NULL },
+    { .arg = &parent.json, .value = "true" },
+    { .arg = &parent.include, .value = "/opt/include" },
+  };
+  memory = unparse_expecting(parent.table, overrides, 4,
+    (const char*[]) { "worker", "--jobs=8", "--ratio=0.100000001",
+      "--precise=0.10000000000000001", "--limit=1536",
+      "--timeout=90000000000ns", "--mode=small", "-I", "/opt/include",
+      "--ports=-80,443", "-v", "--json", NULL },
+    &argv);
+  worker_args_init(&child);
+  child_argv = argv;
+  expect(clapc_parse_safe(child.table, &child_argv, &error));
+  expect(clap_arg_get_int(&child.jobs) == 8 && child.output.value == NULL);
+  expect(clap_arg_get_bool(&child.json));
+  clapc_args_free(child.table);
+  free(memory);
+  clapc_args_free(parent.table);
+
+  // Arguments that weren't given are left out
+  memory = unparse_expecting(
+    parent.table, NULL, 0, (const char*[]) { "worker", NULL }, &argv);
+  free(memory);
+
+  // Only the parse function knows what a custom value looked like
+  int calls = 0;
+  s_address address;
+  s_clap_arg listen_arg = {
+    .name = "listen",
+    .type = CLAP_ARG_TYPE_CUSTOM,
+    .parse = parse_address,
+    .parse_data = &calls,
+    .dest = &address,
+  };
+  s_clap_arg* custom_args[] = { &listen_arg, NULL };
+  argv_ptr = (char*[]) { "clapc_test", "--listen", "localhost:80", NULL };
+  expect(clapc_parse_safe(custom_args, &argv_ptr, &error));
+  expect(clapc_unparse_size("worker", custom_args, NULL, 0) == 0);
+  s_clapc_override listen = { .arg = &listen_arg, .value = "localhost:81" };
+  memory = unparse_expecting(custom_args, &listen, 1,
+    (const char*[]) { "worker", "--listen=localhost:81", NULL }, &argv);
+  free(memory);
+}
+
+int main(void)
+{
+  begin_suite();
+
+  test(explicit_long_boolean);
+  test(implicit_boolean);
+
+  test(string_arguments);
+  test(double_dash);
+
+  test(compiled_spec);
+  test(duplicate_names);
+
+  test(caller_owned_storage);
+  test(repeated_argument);
+
+  test(borrowed_strings);
+  test(inline_values);
+
+  test(integer_numbers);
+  test(floating_point_numbers);
+  test(invalid_number_arguments);
+
+  test(response_files);
+  test(recursive_response_file);
+
+  test(list_arguments);
+  test(large_list);
+
+  test(generated_parser);
+
+  test(subcommands);
+  test(lazy_subcommands);
+
+  test(environment_fallback);
+  test(config_file);
+
+  test(help_message);
+  test(completion);
+
+  test(statistics);
+
+  test(result_objects);
+  test(batch_parsing);
+
+  test(command_strings);
+
+  test(constraints);
+  test(suggestions);
+
+  test(sizes_and_durations);
+  test(rich_types);
+  test(custom_values);
+
+  test(checked_errors);
+
+  test(allocators);
+  test(unparsing);
 
   return end_suite();
 }
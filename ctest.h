@@ -2,6 +2,13 @@
 
 // This file defines macros for a simple test framework.
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
 #ifndef CTEST_FAILED_ASSERTION_ABORTS
 #define CTEST_FAILED_ASSERTION_ABORTS false
 #endif
@@ -40,14 +47,15 @@
 
 // Test framework ==============================================================
 
-static int _ctest_result = 0;
-static int assertions = 0;
-static int failed_assertions = 0;
+// Not every file that includes this uses all of these (e.g. benchmarks)
+__attribute__((unused)) static int _ctest_result = 0;
+__attribute__((unused)) static int assertions = 0;
+__attribute__((unused)) static int failed_assertions = 0;
 
-static int function_assertions = 0;
-static int function_skipped_assertions = 0;
-static int function_failed_assertions = 0;
-static bool function_skip = false;
+__attribute__((unused)) static int function_assertions = 0;
+__attribute__((unused)) static int function_skipped_assertions = 0;
+__attribute__((unused)) static int function_failed_assertions = 0;
+__attribute__((unused)) static bool function_skip = false;
 
 #define begin_test(func)                                                       \
   do {                                                                         \
@@ -155,3 +163,118 @@ static bool function_skip = false;
   } while (0)
 
 #define bool_to_str(b) ((b) ? "true" : "false")
+
+// Allocation counting =========================================================
+
+// Define CTEST_COUNT_ALLOCATIONS before including this file in (exactly one
+// file of) an executable to count every heap allocation the process makes,
+// including the ones made by shared libraries. This replaces malloc, calloc
+// and realloc, so it's only available on glibc.
+#if defined CTEST_COUNT_ALLOCATIONS && defined __GLIBC__
+#define CTEST_COUNTS_ALLOCATIONS true
+
+static size_t _ctest_allocations = 0;
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size)
+{
+  __atomic_fetch_add(&_ctest_allocations, 1, __ATOMIC_RELAXED);
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+  __atomic_fetch_add(&_ctest_allocations, 1, __ATOMIC_RELAXED);
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+  __atomic_fetch_add(&_ctest_allocations, 1, __ATOMIC_RELAXED);
+  return __libc_realloc(ptr, size);
+}
+#else
+#define CTEST_COUNTS_ALLOCATIONS false
+
+static size_t _ctest_allocations = 0;
+#endif
+
+/**
+ * @brief The number of heap allocations made so far. This is always 0 unless
+ * CTEST_COUNTS_ALLOCATIONS is true.
+ */
+#define allocation_count()                                                     \
+  (__atomic_load_n(&_ctest_allocations, __ATOMIC_RELAXED))
+
+// Benchmarks ==================================================================
+
+// How many times a benchmark runs before it is measured.
+#ifndef CTEST_BENCH_WARMUP
+#define CTEST_BENCH_WARMUP 2
+#endif
+
+// How many times a benchmark runs while it is measured.
+#ifndef CTEST_BENCH_REPETITIONS
+#define CTEST_BENCH_REPETITIONS 5
+#endif
+
+static inline double _ctest_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static inline long _ctest_peak_rss_kib(void)
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+/**
+ * @brief Benchmark a block of code. The block runs CTEST_BENCH_WARMUP times,
+ * then CTEST_BENCH_REPETITIONS times while being timed. The best and mean time
+ * per operation, the allocations per repetition and the peak RSS of the
+ * process so far are reported.
+ *
+ * @example
+ *
+ * bench("parse", token_count, {
+ *   clapc_parse_safe(args, &argv_ptr, &error);
+ * });
+ */
+#define bench(name, ops, ...)                                                  \
+  do {                                                                         \
+    for (int _ctest_rep = 0; _ctest_rep < CTEST_BENCH_WARMUP; _ctest_rep++) {  \
+      __VA_ARGS__                                                              \
+    }                                                                          \
+    double _ctest_best = 0;                                                    \
+    double _ctest_total = 0;                                                   \
+    size_t _ctest_allocs = allocation_count();                                 \
+    for (int _ctest_rep = 0; _ctest_rep < CTEST_BENCH_REPETITIONS;             \
+      _ctest_rep++) {                                                          \
+      double _ctest_start = _ctest_now_ns();                                   \
+      __VA_ARGS__                                                              \
+      double _ctest_elapsed = _ctest_now_ns() - _ctest_start;                  \
+      _ctest_total += _ctest_elapsed;                                          \
+      if (_ctest_rep == 0 || _ctest_elapsed < _ctest_best) {                   \
+        _ctest_best = _ctest_elapsed;                                          \
+      }                                                                        \
+    }                                                                          \
+    _ctest_allocs = allocation_count() - _ctest_allocs;                        \
+    double _ctest_ops = (double)(ops);                                         \
+    fprintf(stdout,                                                            \
+      "Bench: " BOLD_UNDERLINE "%s" RESET "\n"                                 \
+      "  %10.2f ns/op (best) %10.2f ns/op (mean) %8.2f allocs/rep"             \
+      " %8ld KiB peak RSS\n",                                                  \
+      (name), _ctest_best / _ctest_ops,                                        \
+      _ctest_total / CTEST_BENCH_REPETITIONS / _ctest_ops,                     \
+      CTEST_COUNTS_ALLOCATIONS                                                 \
+        ? (double)_ctest_allocs / CTEST_BENCH_REPETITIONS                      \
+        : -1.0,                                                                \
+      _ctest_peak_rss_kib());                                                  \
+  } while (0)